@@ -0,0 +1,88 @@
+/******************************************************************************
+ *  Copyright (c) 2016, Xilinx, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  1.  Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *  2.  Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *  3.  Neither the name of the copyright holder nor the names of its
+ *      contributors may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ *  OR BUSINESS INTERRUPTION). HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ *  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ *  ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *****************************************************************************/
+// host side throughput benchmark for the offload service.
+// runs a binarized conv layer through offloaded_layer from several workers
+// at once, so that the queue depth seen by the service equals the number of workers.
+
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <cstdlib>
+#include <string>
+#include "tiny_cnn/tiny_cnn.h"
+#include "tiny_cnn/io/shm_offload.h"
+
+using namespace tiny_cnn;
+
+int main(int argc, char** argv) {
+    std::string name = argc > 1 ? argv[1] : "/tiny_cnn_offload";
+    int workers = argc > 2 ? std::atoi(argv[2]) : 4;
+    int calls = argc > 3 ? std::atoi(argv[3]) : 1000;
+
+    if (workers < 1 || workers > CNN_TASK_SIZE) {
+        std::cout << "number of workers must be within 1.." << CNN_TASK_SIZE << std::endl;
+        return 1;
+    }
+
+    try {
+        shm_offload::attach(name);
+
+        // 32x32x3 in, 3x3 kernel, 64 out
+        OffloadConvParams p = { 32, 32, 3, 3, 64 };
+        offloaded_layer l(32 * 32 * 3, 30 * 30 * 64, shm_offload::handler, 0, &p);
+
+        vec_t in(l.in_size());
+        uniform_rand(in.begin(), in.end(), float_t(-1), float_t(1));
+
+        timer t;
+        std::vector<std::thread> threads;
+        for (int w = 0; w < workers; w++) {
+            threads.emplace_back([&, w] {
+                for (int i = 0; i < calls; i++)
+                    l.forward_propagation(in, w);
+            });
+        }
+        for (auto& th : threads) th.join();
+
+        double elapsed = t.elapsed();
+        uint64_t total = shm_offload::default_client()->calls();
+
+        std::cout << "workers:    " << workers << std::endl
+                  << "calls:      " << total << std::endl
+                  << "elapsed:    " << elapsed << "s" << std::endl
+                  << "throughput: " << total / elapsed << " calls/s" << std::endl;
+    } catch (const nn_error& e) {
+        std::cout << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,106 @@
+/******************************************************************************
+ *  Copyright (c) 2016, Xilinx, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  1.  Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *  2.  Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *  3.  Neither the name of the copyright holder nor the names of its
+ *      contributors may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ *  OR BUSINESS INTERRUPTION). HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ *  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ *  ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *****************************************************************************/
+// stand-in for the FPGA accelerator behind offloaded_layer.
+// serves offload requests over shared memory with the CPU kernels of tiny-cnn
+// and emulates the per-call latency and DMA bandwidth of the real device.
+
+#include <iostream>
+#include <csignal>
+#include <cstdlib>
+#include <string>
+#include "tiny_cnn/tiny_cnn.h"
+#include "tiny_cnn/io/shm_offload.h"
+
+using namespace tiny_cnn;
+
+static shm_offload::server* g_server = nullptr;
+
+static void on_signal(int) {
+    if (g_server) g_server->shutdown();
+}
+
+static void usage(const char* argv0) {
+    std::cout << "usage: " << argv0 << " [options]" << std::endl
+              << "  -n <name>      shared memory object name (default /tiny_cnn_offload)" << std::endl
+              << "  -s <slots>     number of ring slots = max. requests in flight (default 16)" << std::endl
+              << "  -c <elements>  max. elements of a layer input/output (default 65536)" << std::endl
+              << "  -l <us>        emulated per-call latency in microseconds (default 0)" << std::endl
+              << "  -b <MB/s>      emulated DMA bandwidth, 0 for unlimited (default 0)" << std::endl
+              << "  -w <dir>       directory holding <offloadID>.bin weight files" << std::endl
+              << "  -f             replace an existing object of the same name" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    std::string name = "/tiny_cnn_offload";
+    std::string weight_dir;
+    uint64_t slots = 16;
+    uint64_t capacity = 65536;
+    bool replace = false;
+    shm_offload::timing_model timing;
+
+    for (int i = 1; i < argc; i++) {
+        std::string opt = argv[i];
+        if (opt == "-f") { replace = true; continue; }
+        if (opt == "-h" || i + 1 >= argc) { usage(argv[0]); return opt == "-h" ? 0 : 1; }
+
+        std::string val = argv[++i];
+        if      (opt == "-n") name = val;
+        else if (opt == "-s") slots = std::strtoull(val.c_str(), nullptr, 10);
+        else if (opt == "-c") capacity = std::strtoull(val.c_str(), nullptr, 10);
+        else if (opt == "-l") timing.latency_us = std::atof(val.c_str());
+        else if (opt == "-b") timing.bandwidth_mbps = std::atof(val.c_str());
+        else if (opt == "-w") weight_dir = val;
+        else { usage(argv[0]); return 1; }
+    }
+
+    try {
+        shm_offload::server srv(name, slots, capacity, timing, shm_offload::bnn_layer_factory(weight_dir), replace);
+        g_server = &srv;
+        std::signal(SIGINT, on_signal);
+        std::signal(SIGTERM, on_signal);
+
+        std::cout << "serving " << name << " (" << slots << " slots, latency " << timing.latency_us
+                  << "us, bandwidth " << timing.bandwidth_mbps << "MB/s)" << std::endl;
+
+        srv.run();
+        g_server = nullptr;
+
+        std::cout << "calls:    " << srv.calls() << std::endl
+                  << "bytes:    " << srv.bytes() << std::endl
+                  << "busy:     " << srv.busy_us() << "us" << std::endl
+                  << "overruns: " << srv.overruns() << std::endl;
+    } catch (const nn_error& e) {
+        std::cout << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
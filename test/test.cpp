@@ -25,8 +25,11 @@
     SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 #define _CRT_SECURE_NO_WARNINGS
+// count heap allocations; training tests fail if the steady state allocates
+#define CNN_ALLOC_CHECK
 #include "picotest/picotest.h"
 #include "tiny_cnn/tiny_cnn.h"
+#include "tiny_cnn/util/alloc_check_new.h"
 
 using namespace tiny_cnn::activation;
 #include "test_network.h"
@@ -36,6 +39,22 @@ using namespace tiny_cnn::activation;
 #include "test_fully_connected_layer.h"
 #include "test_convolutional_layer.h"
 #include "test_lrn_layer.h"
+#include "test_bnn_threshold_layer.h"
+#include "test_offload_partitioner.h"
+#include "test_bnn_dataflow.h"
+#include "test_fixed_point.h"
+#include "test_thread_pool.h"
+#include "test_parallel_scheduler.h"
+#include "test_pipeline.h"
+#include "test_parameter_arena.h"
+#include "test_data_loader.h"
+#include "test_augmentation.h"
+#include "test_random.h"
+#include "test_activation.h"
+#include "test_scratch_arena.h"
+#include "test_memory_policy.h"
+#include "test_binary_model.h"
+#include "test_shm_offload.h"
 
 
 int main(void) {
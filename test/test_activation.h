@@ -0,0 +1,213 @@
+/******************************************************************************
+ *  Copyright (c) 2016, Xilinx, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  1.  Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *  2.  Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *  3.  Neither the name of the copyright holder nor the names of its
+ *      contributors may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ *  OR BUSINESS INTERRUPTION). HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ *  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ *  ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *****************************************************************************/
+#pragma once
+#include "picotest/picotest.h"
+#include "testhelper.h"
+#include "tiny_cnn/tiny_cnn.h"
+
+namespace tiny_cnn {
+
+template <typename Activation>
+void check_whole_vector_activation() {
+    Activation h;
+    vec_t a = { -2.5, -1.0, -0.25, 0.0, 0.3, 0.75, 1.5, 3.0 };
+    vec_t out(a.size()), dy(a.size());
+
+    h.f(a, out);
+    for (cnn_size_t i = 0; i < a.size(); i++)
+        EXPECT_NEAR(h.f(a, i), out[i], 1e-6);
+
+    h.df(out, dy);
+    for (cnn_size_t i = 0; i < a.size(); i++)
+        EXPECT_NEAR(h.df(out[i]), dy[i], 1e-6);
+
+    vec_t delta(a.size(), float_t(0.5));
+    h.mul_df(out, delta);
+    for (cnn_size_t i = 0; i < a.size(); i++)
+        EXPECT_NEAR(float_t(0.5) * h.df(out[i]), delta[i], 1e-6);
+}
+
+TEST(activation, whole_vector) {
+    check_whole_vector_activation<activation::identity>();
+    check_whole_vector_activation<activation::sigmoid>();
+    check_whole_vector_activation<activation::relu>();
+    check_whole_vector_activation<activation::leaky_relu>();
+    check_whole_vector_activation<activation::elu>();
+    check_whole_vector_activation<activation::tan_h>();
+    check_whole_vector_activation<activation::tan_hp1m2>();
+    check_whole_vector_activation<activation::softmax>();
+}
+
+TEST(activation, softmax_stable) {
+    activation::softmax h;
+    vec_t a = { 1000.0, 1001.0, 1002.0 };
+    vec_t out(a.size());
+
+    h.f(a, out);
+
+    float_t sum = 0;
+    for (auto o : out) {
+        EXPECT_TRUE(o > float_t(0));
+        sum += o;
+    }
+    EXPECT_NEAR(1.0, sum, 1e-5);
+    EXPECT_TRUE(out[2] > out[1] && out[1] > out[0]);
+}
+
+template <typename Activation>
+void check_jacobian_product() {
+    Activation h;
+    vec_t a = { -1.5, -0.5, 0.1, 0.4, 1.2, 2.0 };
+    vec_t g = { 0.3, -0.7, 0.25, 1.0, -0.1, 0.6 };
+    vec_t y(a.size());
+    h.f(a, y);
+
+    vec_t delta = g;
+    h.mul_jacobian(y, delta);
+
+    for (cnn_size_t i = 0; i < a.size(); i++) {
+        vec_t dy_da = h.df(y, i);
+        float_t expected = 0;
+        for (cnn_size_t k = 0; k < a.size(); k++) expected += g[k] * dy_da[k];
+        EXPECT_NEAR(expected, delta[i], 1e-6);
+    }
+}
+
+TEST(activation, jacobian_product) {
+    check_jacobian_product<activation::softmax>();
+    check_jacobian_product<activation::sigmoid>();
+    check_jacobian_product<activation::tan_h>();
+    check_jacobian_product<activation::identity>();
+}
+
+template <typename Activation>
+float_t max_approximation_error(math_accuracy accuracy) {
+    Activation exact, approx;
+    approx.set_accuracy(accuracy);
+
+    vec_t a(4001);
+    for (size_t i = 0; i < a.size(); i++) a[i] = float_t(-20.0 + 0.01 * i);
+    vec_t y(a.size()), y_approx(a.size());
+
+    exact.f(a, y);
+    approx.f(a, y_approx);
+
+    float_t err = 0;
+    for (size_t i = 0; i < a.size(); i++)
+        err = std::max(err, std::abs(y[i] - y_approx[i]));
+    return err;
+}
+
+TEST(activation, approximation) {
+    EXPECT_LE(max_approximation_error<activation::tan_h>(math_accuracy::high), 2e-6);
+    EXPECT_LE(max_approximation_error<activation::sigmoid>(math_accuracy::high), 2e-6);
+    EXPECT_LE(max_approximation_error<activation::tan_hp1m2>(math_accuracy::high), 2e-6);
+    EXPECT_LE(max_approximation_error<activation::elu>(math_accuracy::high), 2e-6);
+    EXPECT_LE(max_approximation_error<activation::softmax>(math_accuracy::high), 2e-6);
+
+    EXPECT_LE(max_approximation_error<activation::tan_h>(math_accuracy::low), 2e-3);
+    EXPECT_LE(max_approximation_error<activation::sigmoid>(math_accuracy::low), 2e-3);
+    EXPECT_LE(max_approximation_error<activation::tan_hp1m2>(math_accuracy::low), 2e-3);
+    EXPECT_LE(max_approximation_error<activation::elu>(math_accuracy::low), 2e-3);
+    EXPECT_LE(max_approximation_error<activation::softmax>(math_accuracy::low), 2e-3);
+
+    EXPECT_EQ(float_t(0), max_approximation_error<activation::tan_h>(math_accuracy::exact));
+}
+
+// f(v, v) must give f(v, out), with or without an approximation
+template <typename Activation>
+bool same_in_place(math_accuracy accuracy) {
+    Activation h;
+    h.set_accuracy(accuracy);
+
+    vec_t a(301);
+    for (size_t i = 0; i < a.size(); i++) a[i] = float_t(-3.0 + 0.02 * i);
+    vec_t y(a.size());
+    h.f(a, y);
+    h.f(a, a);
+    return a == y;
+}
+
+TEST(activation, approximation_in_place) {
+    for (auto acc : { math_accuracy::exact, math_accuracy::high, math_accuracy::low }) {
+        EXPECT_TRUE(same_in_place<activation::tan_h>(acc));
+        EXPECT_TRUE(same_in_place<activation::sigmoid>(acc));
+        EXPECT_TRUE(same_in_place<activation::tan_hp1m2>(acc));
+        EXPECT_TRUE(same_in_place<activation::elu>(acc));
+    }
+}
+
+TEST(activation, fast_exp) {
+    float x[13], y[13];
+    for (int i = 0; i < 13; i++) x[i] = -30.0f + 5.0f * i;
+
+    EXPECT_FALSE(fast_math::exp(x, y, 13, math_accuracy::exact));
+
+#if defined(CNN_USE_SSE) || defined(CNN_USE_AVX)
+    EXPECT_TRUE(fast_math::exp(x, y, 13, math_accuracy::high));
+    for (int i = 0; i < 13; i++)
+        EXPECT_NEAR(1.0, y[i] / std::exp(x[i]), 1e-6);
+
+    EXPECT_TRUE(fast_math::exp(x, y, 13, math_accuracy::low));
+    for (int i = 0; i < 13; i++)
+        EXPECT_NEAR(1.0, y[i] / std::exp(x[i]), 1e-3);
+#else
+    EXPECT_FALSE(fast_math::exp(x, y, 13, math_accuracy::high));
+#endif
+}
+
+TEST(activation, fast_exp_fixed_point) {
+    // no approximation for fixed point types, the caller keeps the exact path
+    typedef fixed_point<16, 8> fp;
+    fp x[4], y[4];
+    EXPECT_FALSE(fast_math::exp(x, y, 4, math_accuracy::high));
+}
+
+TEST(activation, network_accuracy) {
+    network<mse, adagrad> nn;
+    nn << fully_connected_layer<activation::tan_h>(10, 5);
+    nn.set_math_accuracy(math_accuracy::low);
+    nn << fully_connected_layer<activation::sigmoid>(5, 2);
+
+    EXPECT_TRUE(nn[0]->activation_function().accuracy() == math_accuracy::low);
+    EXPECT_TRUE(nn[1]->activation_function().accuracy() == math_accuracy::low);
+
+    vec_t in(10, float_t(0.5));
+    vec_t approx = nn.predict(in);
+    nn.set_math_accuracy(math_accuracy::exact);
+    vec_t exact = nn.predict(in);
+
+    for (size_t i = 0; i < exact.size(); i++)
+        EXPECT_NEAR(exact[i], approx[i], 2e-3);
+}
+
+} // namespace tiny_cnn
@@ -0,0 +1,153 @@
+/******************************************************************************
+ *  Copyright (c) 2016, Xilinx, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  1.  Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *  2.  Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *  3.  Neither the name of the copyright holder nor the names of its
+ *      contributors may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ *  OR BUSINESS INTERRUPTION). HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ *  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ *  ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *****************************************************************************/
+#pragma once
+#include "picotest/picotest.h"
+#include "testhelper.h"
+#include "tiny_cnn/tiny_cnn.h"
+
+namespace tiny_cnn {
+
+TEST(augmentation, crop_flip) {
+    // 3x3 image, one channel, pixel (x, y) = 3y + x
+    vec_t img(9);
+    for (int i = 0; i < 9; i++) img[i] = float_t(i);
+    random_stream rng(1, 0);
+    vec_t out;
+
+    augmentation crop(3, 3, 1);
+    crop.crop(2, 2);
+    for (int n = 0; n < 20; n++) {
+        crop(img, out, rng);
+        EXPECT_EQ(4u, out.size());
+        // a window of the image: right and down neighbours differ by 1 and 3
+        EXPECT_EQ(out[0] + 1, out[1]);
+        EXPECT_EQ(out[0] + 3, out[2]);
+        EXPECT_EQ(out[0] + 4, out[3]);
+    }
+
+    augmentation flip(3, 3, 1);
+    flip.flip(1);
+    flip(img, out, rng);
+    for (int y = 0; y < 3; y++)
+        for (int x = 0; x < 3; x++)
+            EXPECT_EQ(img[y * 3 + x], out[y * 3 + 2 - x]);
+
+    // shifted in from outside is background
+    augmentation shift(3, 3, 1, float_t(-1));
+    shift.shift(3);
+    bool background = false;
+    for (int n = 0; n < 20; n++) {
+        shift(img, out, rng);
+        for (auto v : out) background |= v == float_t(-1);
+    }
+    EXPECT_TRUE(background);
+}
+
+TEST(augmentation, shift_both_ways) {
+    // 5x5 image, one channel, pixel (x, y) = 5y + x
+    vec_t img(25);
+    for (int i = 0; i < 25; i++) img[i] = float_t(i);
+    random_stream rng(7, 0);
+    vec_t out;
+
+    // the centre pixel stays inside the image, so it gives the window origin
+    augmentation shift(5, 5, 1, float_t(-1));
+    shift.shift(1);
+    bool seen_x[3] = {}, seen_y[3] = {};
+    for (int n = 0; n < 200; n++) {
+        shift(img, out, rng);
+        const int v = int(out[12]);
+        const int x0 = v % 5 - 2, y0 = v / 5 - 2;
+        EXPECT_TRUE(x0 >= -1 && x0 <= 1 && y0 >= -1 && y0 <= 1);
+        seen_x[x0 + 1] = seen_y[y0 + 1] = true;
+    }
+    for (int d = 0; d < 3; d++) {
+        EXPECT_TRUE(seen_x[d]);
+        EXPECT_TRUE(seen_y[d]);
+    }
+
+    // a window wider than the image always shows all of it
+    augmentation wide(5, 5, 1, float_t(-1));
+    wide.crop(8, 8, 2);
+    for (int n = 0; n < 50; n++) {
+        wide(img, out, rng);
+        EXPECT_EQ(64u, out.size());
+        int seen = 0;
+        for (auto v : out) seen += v != float_t(-1);
+        EXPECT_EQ(25, seen);
+    }
+}
+
+TEST(augmentation, apply) {
+    std::vector<vec_t> in(16, vec_t(2 * 8 * 8));
+    for (auto& v : in) uniform_rand(v.begin(), v.end(), -1, 1);
+
+    augmentation aug(8, 8, 2);
+    aug.shift(2).flip().elastic(float_t(2), float_t(1.5)).noise(float_t(0.01)).corruption(float_t(0.1), float_t(-1));
+
+    std::vector<vec_t> out1, out2;
+    aug.apply(in, out1, 3);
+    aug.apply(in, out2, 3);
+
+    EXPECT_EQ(in.size(), out1.size());
+    for (size_t i = 0; i < in.size(); i++) {
+        EXPECT_EQ(in[i].size(), out1[i].size());
+        EXPECT_TRUE(out1[i] == out2[i]);
+        EXPECT_FALSE(out1[i] == in[i]);
+    }
+
+    // the numbers follow the global seed
+    const uint64_t seed = get_random_seed();
+    set_random_seed(seed + 1);
+    aug.apply(in, out2, 3);
+    EXPECT_FALSE(out1 == out2);
+    set_random_seed(seed);
+    aug.apply(in, out2, 3);
+    EXPECT_TRUE(out1 == out2);
+
+    // as the transform of a data_loader
+    std::vector<label_t> t(in.size(), 0);
+    loader_config cfg;
+    cfg.batch_size = 4;
+    cfg.num_producers = 2;
+    augmentation crop(8, 8, 2);
+    crop.crop(6, 6, 1);
+
+    data_loader<label_t> loader(in, t, cfg);
+    loader.set_transform(crop);
+    loader.start([](const label_t&, vec_t&) {}, 1);
+    while (const minibatch* b = loader.next())
+        for (size_t k = 0; k < b->size; k++)
+            EXPECT_EQ(crop.out_size(), b->in[k].size());
+}
+
+} // namespace tiny_cnn
@@ -0,0 +1,210 @@
+/******************************************************************************
+ *  Copyright (c) 2016, Xilinx, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  1.  Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *  2.  Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *  3.  Neither the name of the copyright holder nor the names of its
+ *      contributors may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ *  OR BUSINESS INTERRUPTION). HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ *  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ *  ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *****************************************************************************/
+#pragma once
+#include "picotest/picotest.h"
+#include "testhelper.h"
+#include "tiny_cnn/tiny_cnn.h"
+
+
+namespace tiny_cnn {
+
+namespace {
+
+template <typename N>
+void make_binary_model_net(N& net, cnn_size_t hidden) {
+    net << convolutional_layer<tan_h>(12, 12, 3, 1, 4)
+        << average_pooling_layer<tan_h>(10, 10, 4, 2)
+        << fully_connected_layer<tan_h>(5 * 5 * 4, hidden)
+        << fully_connected_layer<softmax>(hidden, 10);
+    net.init_weight();
+}
+
+template <typename N>
+void make_bnn_model_net(N& net) {
+    net << bnn_conv_layer(8, 8, 3, 2, 4)
+        << bnn_threshold_layer(4, 36)
+        << binarynet_layer<identity>(144, 10);
+}
+
+} // namespace
+
+TEST(binary_model, round_trip) {
+    network<mse, adagrad> src, dst;
+    make_binary_model_net(src, 30);
+    make_binary_model_net(dst, 30);
+
+    const std::string path = unique_path();
+    src.save_binary(path);
+    dst.load_binary(path);
+
+    vec_t in(144);
+    uniform_rand(in.begin(), in.end(), -1.0, 1.0);
+    const vec_t expected = src.predict(in);
+    const vec_t actual = dst.predict(in);
+    for (size_t i = 0; i < expected.size(); i++)
+        EXPECT_EQ(expected[i], actual[i]);
+    EXPECT_TRUE(src.has_same_weights(dst, 0));
+    std::remove(path.c_str());
+}
+
+TEST(binary_model, bnn_round_trip) {
+    network<mse, adagrad> src, dst;
+    make_bnn_model_net(src);
+    make_bnn_model_net(dst);
+
+    // the binarized weights and thresholds live outside weight()/bias()
+    const std::string weight_path = unique_path();
+    {
+        std::ofstream ofs(weight_path.c_str(), std::ios::binary);
+        for (int i = 0; i < 4 * 2 * 3 * 3; i++) {
+            const unsigned long long e = rand() % 2;
+            ofs.write(reinterpret_cast<const char*>(&e), sizeof(e));
+        }
+    }
+    std::dynamic_pointer_cast<bnn_conv_layer>(src.shared_at(0))->loadFromBinaryFile(weight_path);
+    std::remove(weight_path.c_str());
+
+    auto threshold = std::dynamic_pointer_cast<bnn_threshold_layer>(src.shared_at(1));
+    for (cnn_size_t ch = 0; ch < 4; ch++) {
+        threshold->thresholds()[ch] = float_t(rand() % 19) - float_t(9);
+        threshold->set_invert_output(ch, ch % 2 == 1);
+    }
+
+    std::stringstream ss;
+    for (int i = 0; i < 144 * 10; i++) ss << rand() % 2 << "\n";
+    for (int i = 0; i < 10; i++) ss << rand() % 145 << "\n";
+    src[2]->load(ss);
+
+    const std::string path = unique_path();
+    src.save_binary(path);
+    dst.load_binary(path);
+    std::remove(path.c_str());
+
+    for (size_t i = 0; i < src.depth(); i++)
+        EXPECT_TRUE(src[i]->state() == dst[i]->state());
+
+    for (int n = 0; n < 8; n++) {
+        vec_t in(8 * 8 * 2);
+        uniform_rand(in.begin(), in.end(), -1.0, 1.0);
+        const vec_t expected = src.predict(in);
+        const vec_t actual = dst.predict(in);
+        for (size_t i = 0; i < expected.size(); i++)
+            EXPECT_EQ(expected[i], actual[i]);
+    }
+}
+
+TEST(binary_model, corrupted_file) {
+    network<mse, adagrad> src, dst;
+    make_binary_model_net(src, 30);
+    make_binary_model_net(dst, 30);
+
+    const std::string path = unique_path();
+    src.save_binary(path);
+    {
+        std::fstream f(path.c_str(), std::ios::in | std::ios::out | std::ios::binary);
+        f.seekp(4096);
+        f.put(0x55);
+    }
+
+    bool thrown = false;
+    try {
+        dst.load_binary(path);
+    } catch (const nn_error&) {
+        thrown = true;
+    }
+    EXPECT_TRUE(thrown);
+
+    // loads when verification is skipped
+    dst.load_binary(path, false);
+    std::remove(path.c_str());
+}
+
+TEST(binary_model, architecture_mismatch) {
+    network<mse, adagrad> src, dst;
+    make_binary_model_net(src, 30);
+    make_binary_model_net(dst, 20);
+
+    vec_t in(144);
+    uniform_rand(in.begin(), in.end(), -1.0, 1.0);
+    const vec_t before = dst.predict(in);
+
+    const std::string path = unique_path();
+    src.save_binary(path);
+
+    bool thrown = false;
+    try {
+        dst.load_binary(path);
+    } catch (const nn_error&) {
+        thrown = true;
+    }
+    EXPECT_TRUE(thrown);
+    std::remove(path.c_str());
+
+    // no layer was touched
+    const vec_t after = dst.predict(in);
+    for (size_t i = 0; i < before.size(); i++)
+        EXPECT_EQ(before[i], after[i]);
+}
+
+TEST(binary_model, train_after_load) {
+    network<mse, adagrad> src, dst, reference;
+    make_binary_model_net(src, 30);
+    make_binary_model_net(dst, 30);
+    make_binary_model_net(reference, 30);
+
+    const std::string path = unique_path();
+    src.save_binary(path);
+    dst.load_binary(path);
+
+    std::vector<vec_t> data(8, vec_t(144));
+    std::vector<label_t> labels(8);
+    for (size_t i = 0; i < data.size(); i++) {
+        uniform_rand(data[i].begin(), data[i].end(), -1.0, 1.0);
+        labels[i] = static_cast<label_t>(i % 10);
+    }
+    dst.train(data, labels, 4, 2);
+    EXPECT_FALSE(src.has_same_weights(dst, 1E-5));
+
+    // training the loaded network leaves the file alone
+    reference.load_binary(path);
+    EXPECT_TRUE(src.has_same_weights(reference, 0));
+
+    // the weights do not depend on the file any more
+    const vec_t before = dst.predict(data[0]);
+    dst.reallocate_buffers();
+    std::remove(path.c_str());
+    const vec_t after = dst.predict(data[0]);
+    for (size_t i = 0; i < before.size(); i++)
+        EXPECT_EQ(before[i], after[i]);
+}
+
+} // namespace tiny_cnn
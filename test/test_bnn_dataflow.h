@@ -0,0 +1,86 @@
+/******************************************************************************
+ *  Copyright (c) 2016, Xilinx, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  1.  Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *  2.  Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *  3.  Neither the name of the copyright holder nor the names of its
+ *      contributors may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ *  OR BUSINESS INTERRUPTION). HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ *  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ *  ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *****************************************************************************/
+#pragma once
+#include "picotest/picotest.h"
+#include "testhelper.h"
+#include "tiny_cnn/tiny_cnn.h"
+
+namespace tiny_cnn {
+
+TEST(bnn_dataflow, simulate) {
+    network<mse, adagrad> nn;
+    nn << bnn_conv_layer(8, 8, 3, 2, 4)             // 6x6 pixels, 4x18 matrix
+       << bnn_threshold_layer(4, 36)                 // 144 elements
+       << binarynet_layer<identity>(144, 10);        // 10x144 matrix
+
+    dataflow_config cfg;
+    cfg.clock_mhz = 100;
+
+    std::vector<layer_folding> f(3);
+    auto e = simulate_dataflow(nn, f, cfg);
+
+    EXPECT_EQ(36u * 4 * 18, e.layers[0].cycles);
+    EXPECT_EQ(144u, e.layers[1].cycles);
+    EXPECT_EQ(1440u, e.layers[2].cycles);
+    EXPECT_EQ(0u, e.bottleneck);
+    EXPECT_EQ(2592u, e.ii_cycles);
+    EXPECT_NEAR(1e8 / 2592.0, e.fps, 1e-6);
+
+    f[0] = layer_folding(2, 9);
+    e = simulate_dataflow(nn, f, cfg);
+    EXPECT_EQ(36u * 2 * 2, e.layers[0].cycles);
+    EXPECT_EQ(2u, e.bottleneck);
+}
+
+TEST(bnn_dataflow, balance) {
+    network<mse, adagrad> nn;
+    nn << bnn_conv_layer(8, 8, 3, 2, 4)
+       << bnn_threshold_layer(4, 36)
+       << binarynet_layer<identity>(144, 10);
+
+    dataflow_config cfg;
+    auto base = simulate_dataflow(nn, std::vector<layer_folding>(3), cfg);
+
+    const double budget = 2000;
+    auto f = balance_folding(nn, budget, cfg);
+    auto e = simulate_dataflow(nn, f, cfg);
+
+    EXPECT_LE(e.luts, budget);
+    EXPECT_LT(e.ii_cycles, base.ii_cycles);
+
+    for (size_t i = 0; i < e.layers.size(); i++) {
+        EXPECT_EQ(0u, e.layers[i].rows % f[i].pe);
+        EXPECT_EQ(0u, e.layers[i].cols % f[i].simd);
+    }
+}
+
+} // namespace tiny_cnn
@@ -0,0 +1,85 @@
+/******************************************************************************
+ *  Copyright (c) 2016, Xilinx, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  1.  Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *  2.  Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *  3.  Neither the name of the copyright holder nor the names of its
+ *      contributors may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ *  OR BUSINESS INTERRUPTION). HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ *  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ *  ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *****************************************************************************/
+#pragma once
+#include "picotest/picotest.h"
+#include "testhelper.h"
+#include "tiny_cnn/tiny_cnn.h"
+
+namespace tiny_cnn {
+
+TEST(bnn_threshold, forward) {
+    bnn_threshold_layer l(3, 11);
+    vec_t in(33);
+
+    for (size_t i = 0; i < in.size(); i++)
+        in[i] = float_t(int(i % 7) - 3);
+
+    l.thresholds()[0] = float_t(0);
+    l.thresholds()[1] = float_t(1);
+    l.thresholds()[2] = float_t(-2);
+    l.set_invert_output(1, true);
+
+    vec_t out = l.forward_propagation(in, 0);
+
+    for (cnn_size_t ch = 0; ch < 3; ch++) {
+        for (cnn_size_t j = 0; j < 11; j++) {
+            const size_t pos = ch * 11 + j;
+            float_t expected = in[pos] > l.thresholds()[ch] ? float_t(1) : float_t(-1);
+            if (l.invert_output(ch)) expected = -expected;
+            EXPECT_FLOAT_EQ(expected, out[pos]);
+        }
+    }
+
+    // packed bits match the bipolar output
+    std::vector<uint64_t> bits(1);
+    l.forward_packed(in, &bits[0]);
+    for (size_t i = 0; i < in.size(); i++)
+        EXPECT_EQ(out[i] > float_t(0), ((bits[0] >> i) & 1) != 0);
+}
+
+TEST(bnn_threshold, output_layer) {
+    bnn_output_layer l(2, 5);
+    vec_t in(10, float_t(2));
+
+    l.thresholds()[0] = float_t(0.5);
+    l.thresholds()[1] = float_t(3);
+    l.set_invert_output(0, true);
+
+    vec_t out = l.forward_propagation(in, 0);
+
+    for (size_t j = 0; j < 5; j++) {
+        EXPECT_FLOAT_EQ(float_t(-1.5), out[j]);
+        EXPECT_FLOAT_EQ(float_t(-1), out[5 + j]);
+    }
+}
+
+} // namespace tiny_cnn
@@ -0,0 +1,133 @@
+/******************************************************************************
+ *  Copyright (c) 2016, Xilinx, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  1.  Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *  2.  Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *  3.  Neither the name of the copyright holder nor the names of its
+ *      contributors may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ *  OR BUSINESS INTERRUPTION). HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ *  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ *  ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *****************************************************************************/
+#pragma once
+#include "picotest/picotest.h"
+#include "testhelper.h"
+#include "tiny_cnn/tiny_cnn.h"
+
+namespace tiny_cnn {
+
+// the input of sample i is {i}, its label i % 3
+static std::vector<size_t> load_all(int producers, bool shuffle, std::vector<size_t>* sizes = nullptr) {
+    std::vector<vec_t> in;
+    std::vector<label_t> t;
+    for (int i = 0; i < 10; i++) {
+        in.push_back(vec_t(1, float_t(i)));
+        t.push_back(i % 3);
+    }
+
+    loader_config cfg;
+    cfg.batch_size = 3;
+    cfg.epochs = 2;
+    cfg.shuffle = shuffle;
+    cfg.stream = 7;
+    cfg.num_producers = producers;
+    cfg.prefetch = 2;
+
+    data_loader<label_t> loader(in, t, cfg);
+    loader.start([](const label_t& l, vec_t& dst) {
+        std::fill(dst.begin(), dst.end(), float_t(0));
+        dst[l] = float_t(1);
+    }, 3);
+
+    std::vector<size_t> order;
+    while (const minibatch* b = loader.next()) {
+        if (sizes) sizes->push_back(b->size);
+        for (size_t k = 0; k < b->size; k++) {
+            const size_t i = static_cast<size_t>(b->in[k][0]);
+            EXPECT_EQ(float_t(1), b->t[k][i % 3]);
+            order.push_back(i);
+        }
+    }
+    return order;
+}
+
+TEST(data_loader, epochs) {
+    std::vector<size_t> sizes;
+    std::vector<size_t> order = load_all(1, false, &sizes);
+
+    EXPECT_EQ(20u, order.size());
+    EXPECT_EQ(8u, sizes.size());
+    EXPECT_EQ(1u, sizes[3]);
+    for (size_t i = 0; i < order.size(); i++)
+        EXPECT_EQ(i % 10, order[i]);
+}
+
+TEST(data_loader, shuffle) {
+    std::vector<size_t> order = load_all(1, true);
+
+    // every epoch is a permutation of the data, and the epochs differ
+    for (int e = 0; e < 2; e++) {
+        std::vector<size_t> epoch(order.begin() + e * 10, order.begin() + e * 10 + 10);
+        std::sort(epoch.begin(), epoch.end());
+        for (size_t i = 0; i < 10; i++)
+            EXPECT_EQ(i, epoch[i]);
+    }
+    EXPECT_FALSE(std::equal(order.begin(), order.begin() + 10, order.begin() + 10));
+
+    // the order only depends on the global seed
+    std::vector<size_t> order4 = load_all(4, true);
+    EXPECT_TRUE(order == order4);
+
+    const uint64_t seed = get_random_seed();
+    set_random_seed(seed + 1);
+    EXPECT_FALSE(order == load_all(1, true));
+    set_random_seed(seed);
+    EXPECT_TRUE(order == load_all(1, true));
+}
+
+TEST(data_loader, train) {
+    network<mse, adagrad> nn;
+    nn << fully_connected_layer<tan_h>(2, 2);
+
+    std::vector<vec_t> in;
+    std::vector<label_t> t;
+    for (int i = 0; i < 20; i++) {
+        vec_t x(2);
+        uniform_rand(x.begin(), x.end(), -1, 1);
+        in.push_back(x);
+        t.push_back(x[0] > 0 ? 1 : 0);
+    }
+
+    loader_config cfg;
+    cfg.batch_size = 4;
+    cfg.epochs = 3;
+    cfg.num_producers = 2;
+    data_loader<label_t> loader(in, t, cfg);
+
+    int batches = 0, epochs = 0;
+    EXPECT_TRUE(nn.train(loader, [&]() { batches++; }, [&]() { epochs++; }));
+    EXPECT_EQ(15, batches);
+    EXPECT_EQ(3, epochs);
+}
+
+} // namespace tiny_cnn
@@ -37,15 +37,13 @@ TEST(dropout, randomized) {
     double dropout_rate = 0.1;
     dropout_layer l(num_units, dropout_rate, net_phase::train);
     vec_t v(num_units, 1.0);
-    const bool *pmask;
+    std::deque<bool> mask1, mask2;
 
     l.forward_propagation(v, 0);
-    pmask = l.get_mask();
-    std::deque<bool> mask1(pmask, pmask + num_units);
+    for (int i = 0; i < num_units; i++) mask1.push_back(l.is_dropped(i));
 
     l.forward_propagation(v, 0);
-    pmask = l.get_mask();
-    std::deque<bool> mask2(pmask, pmask + num_units);
+    for (int i = 0; i < num_units; i++) mask2.push_back(l.is_dropped(i));
 
     // mask should change for each fprop
     EXPECT_TRUE(is_different_container(mask1, mask2));
@@ -61,6 +59,27 @@ TEST(dropout, randomized) {
     EXPECT_GE(num_units * dropout_rate / margin_factor, num_true2);
 }
 
+TEST(dropout, apply) {
+    const int num_units = 1003;
+    dropout_layer l(num_units, 0.25, net_phase::train);
+    vec_t in(num_units), delta(num_units);
+    uniform_rand(in.begin(), in.end(), -1, 1);
+    uniform_rand(delta.begin(), delta.end(), -1, 1);
+
+    // workers keep separate masks
+    vec_t out0 = l.forward_propagation(in, 0);
+    vec_t out1 = l.forward_propagation(in, 1);
+    EXPECT_TRUE(out0 != out1);
+
+    for (int i = 0; i < num_units; i++) {
+        const float_t expected = l.is_dropped(i, 0) ? float_t(0) : in[i] / float_t(0.75);
+        EXPECT_NEAR(expected, out0[i], 1e-6);
+    }
+
+    // unused bits of the last word stay clear
+    EXPECT_EQ(0u, l.get_mask(0).back() >> (num_units % 64));
+}
+
 TEST(dropout, read_write) {
     dropout_layer l1(1024, 0.5, net_phase::test);
     dropout_layer l2(1024, 0.5, net_phase::test);
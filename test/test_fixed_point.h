@@ -0,0 +1,118 @@
+/******************************************************************************
+ *  Copyright (c) 2016, Xilinx, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  1.  Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *  2.  Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *  3.  Neither the name of the copyright holder nor the names of its
+ *      contributors may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ *  OR BUSINESS INTERRUPTION). HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ *  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ *  ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *****************************************************************************/
+#pragma once
+#include "picotest/picotest.h"
+#include "testhelper.h"
+#include "tiny_cnn/tiny_cnn.h"
+
+namespace tiny_cnn {
+
+TEST(fixed_point, rounding) {
+    typedef fixed_point<8, 4, fixed_rounding::round> rnd;
+    typedef fixed_point<8, 4, fixed_rounding::truncate> trn;
+    typedef fixed_point<8, 4, fixed_rounding::round_even> cnv;
+
+    // 1/32 is half an lsb
+    EXPECT_EQ(1,  rnd(0.03125).raw());
+    EXPECT_EQ(0,  trn(0.03125).raw());
+    EXPECT_EQ(0,  cnv(0.03125).raw());
+    EXPECT_EQ(2,  cnv(0.09375).raw());
+    EXPECT_EQ(-1, trn(-0.03125).raw());
+
+    // 1.5 * 0.0625 = 0.09375, i.e. 1.5 lsb
+    EXPECT_EQ(2, (rnd(1.5) * rnd(0.0625)).raw());
+    EXPECT_EQ(1, (trn(1.5) * trn(0.0625)).raw());
+    EXPECT_EQ(2, (cnv(1.5) * cnv(0.0625)).raw());
+
+    EXPECT_EQ(-24, (rnd(3) / rnd(-2)).raw());
+}
+
+TEST(fixed_point, overflow) {
+    typedef fixed_point<4, 4, fixed_rounding::round, fixed_overflow::saturate> sat;
+    typedef fixed_point<4, 4, fixed_rounding::round, fixed_overflow::wrap> wrp;
+
+    EXPECT_EQ(127,  (sat(7) + sat(7)).raw());
+    EXPECT_EQ(-128, (sat(-8) - sat(1)).raw());
+    EXPECT_EQ(127,  sat(100.0).raw());
+    EXPECT_EQ(-128, sat(-8).raw());
+
+    // 7 + 7 = 14 = 0b1110.0000 -> -2
+    EXPECT_EQ(-32, (wrp(7) + wrp(7)).raw());
+    EXPECT_EQ(112, (wrp(-8) - wrp(1)).raw());
+
+    EXPECT_EQ(std::numeric_limits<sat>::max().raw(), 127);
+    EXPECT_EQ(std::numeric_limits<sat>::lowest().raw(), -128);
+}
+
+TEST(fixed_point, dot) {
+    typedef fixed_point<8, 8> fx;
+    std::vector<fx> a, b;
+    int64_t wide = 0;
+    vectorize::accumulator<fx> acc;
+
+    for (int i = 0; i < 37; i++) {
+        a.push_back(fx(0.1 * (i % 7) - 0.3));
+        b.push_back(fx(0.05 * (i % 5) + 0.01));
+        wide += int64_t(a.back().raw()) * b.back().raw();
+        acc.mac(a.back(), b.back());
+    }
+    // reference: exact sum of the raw products, rounded once
+    const int32_t expected = fx::requantize(wide, 16);
+    EXPECT_EQ(expected, vectorize::dot(&a[0], &b[0], a.size()).raw());
+    EXPECT_EQ(expected, acc.result().raw());
+}
+
+TEST(fixed_point, wide_accumulation) {
+    typedef fixed_point<4, 4> fx;
+
+    // 1/16 * 1/16 is below half an lsb: rounding every product loses all 16 of them
+    std::vector<fx> lsb(16, fx::from_raw(1));
+    fx per_operation(0);
+    for (size_t i = 0; i < lsb.size(); i++) per_operation += lsb[i] * lsb[i];
+    EXPECT_EQ(0, per_operation.raw());
+    EXPECT_EQ(1, vectorize::dot(&lsb[0], &lsb[0], lsb.size()).raw());
+
+    // intermediate sums beyond the range of the word do not saturate
+    std::vector<fx> x = { fx(7), fx(7), fx(-7) };
+    std::vector<fx> y = { fx(1), fx(1), fx(1) };
+    EXPECT_EQ(fx(7).raw(), vectorize::dot(&x[0], &y[0], x.size()).raw());
+
+    // muladd rounds each element once as well
+    std::vector<fx> dst = { fx(1), fx(-1), fx(7) };
+    std::vector<fx> src = { fx::from_raw(3), fx::from_raw(-3), fx(7) };
+    vectorize::muladd(&src[0], fx(0.5), src.size(), &dst[0]);
+    EXPECT_EQ(16 + 2, dst[0].raw());  // 1 + 1.5 lsb, rounded half up
+    EXPECT_EQ(-16 - 1, dst[1].raw()); // -1 - 1.5 lsb
+    EXPECT_EQ(127, dst[2].raw());     // 7 + 3.5 saturates
+}
+
+} // namespace tiny_cnn
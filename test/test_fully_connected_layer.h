@@ -114,6 +114,46 @@ TEST(fully_connected, gradient_check) {
     EXPECT_TRUE(nn.gradient_check(&a, &t, 1, 1e-4, GRAD_CHECK_ALL));
 }
 
+TEST(fully_connected, batched_gradient) {
+    // wider than one column tile of end_batch
+    const cnn_size_t in_dim = 3, out_dim = 1030, batch = 5;
+    auto fc = std::make_shared<fully_connected_layer<tan_h>>(in_dim, out_dim);
+    layers ls;
+    ls.add(fc);
+    ls.init_weight();
+
+    std::vector<vec_t> in(batch, vec_t(in_dim)), delta(batch, vec_t(out_dim));
+    for (cnn_size_t s = 0; s < batch; s++) {
+        uniform_rand(in[s].begin(), in[s].end(), -1, 1);
+        uniform_rand(delta[s].begin(), delta[s].end(), -1, 1);
+    }
+
+    // per-sample rank-1 updates
+    for (cnn_size_t s = 0; s < batch; s++) {
+        ls.head()->forward_propagation(in[s], 0);
+        fc->back_propagation(delta[s], 0);
+    }
+    vec_t dW = fc->weight_diff(0), db = fc->bias_diff(0);
+    std::fill(fc->weight_diff(0).begin(), fc->weight_diff(0).end(), float_t(0));
+    std::fill(fc->bias_diff(0).begin(), fc->bias_diff(0).end(), float_t(0));
+
+    // one product for the whole batch, samples spread over two workers
+    ls.begin_batch(batch);
+    for (cnn_size_t s = 0; s < batch; s++) {
+        ls.set_batch_row(s % 2, s);
+        ls.head()->forward_propagation(in[s], s % 2);
+        fc->back_propagation(delta[s], s % 2);
+    }
+    ls.end_batch();
+
+    for (size_t i = 0; i < dW.size(); i++)
+        EXPECT_NEAR(dW[i], fc->weight_diff(0)[i], 1e-5);
+    for (size_t i = 0; i < db.size(); i++)
+        EXPECT_NEAR(db[i], fc->bias_diff(0)[i], 1e-5);
+    for (size_t i = 0; i < dW.size(); i++)
+        EXPECT_EQ(float_t(0), fc->weight_diff(1)[i]);
+}
+
 TEST(fully_connected, read_write)
 {
     fully_connected_layer<tan_h> l1(100, 100);
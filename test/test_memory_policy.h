@@ -0,0 +1,131 @@
+/******************************************************************************
+ *  Copyright (c) 2016, Xilinx, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  1.  Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *  2.  Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *  3.  Neither the name of the copyright holder nor the names of its
+ *      contributors may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ *  OR BUSINESS INTERRUPTION). HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ *  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ *  ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *****************************************************************************/
+#pragma once
+#include "picotest/picotest.h"
+#include "testhelper.h"
+#include "tiny_cnn/tiny_cnn.h"
+
+namespace tiny_cnn {
+
+TEST(memory_policy, parse) {
+    EXPECT_TRUE(memory_policy::parse_pages("") == memory_policy::pages::normal);
+    EXPECT_TRUE(memory_policy::parse_pages("transparent") == memory_policy::pages::transparent_huge);
+    EXPECT_TRUE(memory_policy::parse_pages("explicit") == memory_policy::pages::explicit_huge);
+
+    bool thrown = false;
+    try {
+        memory_policy::parse_pages("gigantic");
+    } catch (const nn_error&) {
+        thrown = true;
+    }
+    EXPECT_TRUE(thrown);
+    EXPECT_TRUE(memory_policy().is_default());
+}
+
+TEST(memory_policy, huge_pages) {
+    const memory_policy saved = global_memory_policy();
+
+    for (auto mode : { memory_policy::pages::transparent_huge, memory_policy::pages::explicit_huge }) {
+        memory_policy policy;
+        policy.page_mode = mode;
+        policy.prefault = true;
+        policy.lock = true;
+        policy.min_bytes = 64 * 1024;
+        set_memory_policy(policy);
+
+        vec_t small(100, float_t(1));
+        vec_t large(100000, float_t(2));
+#if defined(__linux__)
+        // explicit huge pages fall back to transparent ones without a reserved pool
+        EXPECT_EQ(0u, reinterpret_cast<size_t>(&large[0]) % (2 * 1024 * 1024));
+#endif
+        EXPECT_EQ(0u, reinterpret_cast<size_t>(&small[0]) % 64);
+        large[99999] = float_t(3);
+        EXPECT_EQ(float_t(2), large[0]);
+        EXPECT_EQ(float_t(3), large[99999]);
+
+        // freed correctly after the policy changed back
+        set_memory_policy(saved);
+    }
+    set_memory_policy(saved);
+}
+
+TEST(memory_policy, default_frees_skip_the_registry) {
+    const memory_policy saved = global_memory_policy();
+    const detail::memory_policy_state& st = detail::policy_state();
+    EXPECT_EQ(0u, st.count.load());
+    EXPECT_FALSE(st.may_hold(400000));
+
+    memory_policy policy;
+    policy.page_mode = memory_policy::pages::transparent_huge;
+    policy.min_bytes = 64 * 1024;
+    set_memory_policy(policy);
+    {
+        vec_t large(100000);
+        set_memory_policy(saved);
+#if defined(__linux__)
+        EXPECT_EQ(1u, st.count.load());
+        EXPECT_TRUE(st.may_hold(large.size() * sizeof(float_t)));
+#endif
+        // frees of smaller buffers still skip the lock
+        EXPECT_FALSE(st.may_hold(100 * sizeof(float_t)));
+    }
+    // and the summary shrinks back once it is gone
+    EXPECT_EQ(0u, st.count.load());
+    EXPECT_FALSE(st.may_hold(400000));
+}
+
+TEST(memory_policy, reallocate_network) {
+    const memory_policy saved = global_memory_policy();
+
+    network<mse, adagrad> net;
+    net << fully_connected_layer<tan_h>(200, 300)
+        << fully_connected_layer<tan_h>(300, 10);
+    net.init_weight();
+
+    vec_t in(200);
+    uniform_rand(in.begin(), in.end(), -1.0, 1.0);
+    const vec_t before = net.predict(in);
+
+    memory_policy policy;
+    policy.page_mode = memory_policy::pages::transparent_huge;
+    policy.min_bytes = 64 * 1024;
+    set_memory_policy(policy);
+    net.reallocate_buffers();
+    set_memory_policy(saved);
+
+    const vec_t after = net.predict(in);
+    for (size_t i = 0; i < before.size(); i++)
+        EXPECT_EQ(before[i], after[i]);
+}
+
+} // namespace tiny_cnn
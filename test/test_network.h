@@ -107,6 +107,78 @@ TEST(network, train_predict) {
     }
 }
 
+TEST(network, train_hogwild) {
+    network<mse, momentum> net;
+
+    std::vector<vec_t> data, target;
+    std::vector<label_t> label;
+
+    for (size_t i = 0; i < 200; i++) {
+        bool in[2] = { bernoulli(0.5), bernoulli(0.5) };
+        bool out = in[0] ^ in[1];
+        data.push_back({ float_t(in[0]), float_t(in[1]) });
+        label.push_back(out ? 1 : 0);
+        target.push_back({ float_t(out ? -0.8 : 0.8), float_t(out ? 0.8 : -0.8) });
+    }
+
+    net << fully_connected_layer<tan_h>(2, 10)
+        << fully_connected_layer<tan_h>(10, 2);
+    net.init_weight();
+    net.set_update_mode(update_mode::hogwild);
+
+    float_t before = net.get_loss(data, target);
+    net.train(data, label, 20, 20, nop, nop, false);
+    float_t after = net.get_loss(data, target);
+
+    EXPECT_TRUE(after < before * 0.5);
+
+    // optimizers with a single merged update cannot run asynchronously
+    network<mse, adagrad> net2;
+    net2 << fully_connected_layer<tan_h>(2, 2);
+    net2.set_update_mode(update_mode::hogwild);
+    bool thrown = false;
+    try {
+        net2.train(data, label, 20, 1);
+    } catch (const nn_error&) {
+        thrown = true;
+    }
+    EXPECT_TRUE(thrown);
+}
+
+TEST(network, steady_state_allocation) {
+    network<cross_entropy_multiclass, adagrad> net;
+    net << convolutional_layer<relu>(8, 8, 3, 1, 4)
+        << max_pooling_layer<tan_h>(6, 6, 4, 2)
+        << fully_connected_layer<softmax>(36, 3);
+
+    std::vector<vec_t> data;
+    std::vector<label_t> label;
+    for (size_t i = 0; i < 30; i++) {
+        data.push_back(vec_t(64));
+        uniform_rand(data.back().begin(), data.back().end(), -1.0, 1.0);
+        label.push_back(i % 3);
+    }
+
+    // with CNN_ALLOC_CHECK, minibatches after the first epoch must not allocate
+    bool ok = true;
+    try {
+        net.train(data, label, 4, 3);
+    } catch (const nn_error&) {
+        ok = false;
+    }
+    EXPECT_TRUE(ok);
+
+    vec_t out;
+    net.predict(data[0], out);
+    const float_t* p = &out[0];
+    const size_t allocs = alloc_check::count();
+    for (size_t i = 0; i < data.size(); i++)
+        net.predict(data[i], out);
+    EXPECT_EQ(allocs, alloc_check::count());
+    EXPECT_TRUE(p == &out[0]);
+    EXPECT_TRUE(net.predict(data.back()) == out);
+}
+
 TEST(network, set_netphase) {
     // TODO: add unit-test for public api
 }
@@ -0,0 +1,199 @@
+/******************************************************************************
+ *  Copyright (c) 2016, Xilinx, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  1.  Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *  2.  Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *  3.  Neither the name of the copyright holder nor the names of its
+ *      contributors may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ *  OR BUSINESS INTERRUPTION). HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ *  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ *  ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *****************************************************************************/
+#pragma once
+#include "picotest/picotest.h"
+#include "testhelper.h"
+#include "tiny_cnn/tiny_cnn.h"
+
+namespace tiny_cnn {
+
+inline void dummy_offload(const vec_t&, vec_t&, unsigned int, OffloadConvParams*) {}
+
+TEST(offload_partitioner, offload_all) {
+    network<mse, adagrad> nn;
+    nn << fully_connected_layer<identity>(10, 20)
+       << fully_connected_layer<identity>(20, 20)
+       << fully_connected_layer<identity>(20, 10);
+
+    accel_cost_model m;
+    m.layer_costs["fully-connected"] = accel_layer_cost(1e6, 0);
+
+    auto p = partition_offload(nn, { 10, 10, 10 }, m);
+
+    EXPECT_EQ(3, std::count(p.offloaded.begin(), p.offloaded.end(), true));
+    EXPECT_EQ(1, p.segments.size());
+
+    auto off = apply_offload_partition(nn, p, dummy_offload);
+    EXPECT_EQ(1, off.depth());
+    EXPECT_EQ("offloaded", off[0]->layer_type());
+    EXPECT_EQ(10, off.in_dim());
+    EXPECT_EQ(10, off.out_dim());
+}
+
+TEST(offload_partitioner, resource_budget) {
+    network<mse, adagrad> nn;
+    nn << fully_connected_layer<identity>(10, 20)  // 220 params
+       << fully_connected_layer<identity>(20, 20)  // 420 params
+       << fully_connected_layer<identity>(20, 10); // 210 params
+
+    accel_cost_model m;
+    m.layer_costs["fully-connected"] = accel_layer_cost(1e6, 1);
+    m.resource_budget = 500;
+
+    auto p = partition_offload(nn, { 10, 100, 10 }, m);
+
+    EXPECT_FALSE(p.offloaded[0]);
+    EXPECT_TRUE(p.offloaded[1]);
+    EXPECT_FALSE(p.offloaded[2]);
+    EXPECT_NEAR(20.0, p.host_us, 1e-6);
+
+    auto off = apply_offload_partition(nn, p, dummy_offload, 7);
+    EXPECT_EQ(3, off.depth());
+    EXPECT_EQ("offloaded", off[1]->layer_type());
+    EXPECT_EQ("fully-connected", off[2]->layer_type());
+}
+
+TEST(offload_partitioner, balance) {
+    network<mse, adagrad> nn;
+    for (int i = 0; i < 4; i++)
+        nn << fully_connected_layer<identity>(10, 10); // 110 connections
+
+    accel_cost_model m;
+    m.layer_costs["fully-connected"] = accel_layer_cost(110.0 / 50.0, 0); // 50us per layer
+
+    auto p = partition_offload(nn, { 50, 50, 50, 50 }, m);
+
+    EXPECT_NEAR(100.0, p.host_us, 1e-6);
+    EXPECT_NEAR(100.0, p.accel_us, 1e-6);
+    EXPECT_NEAR(1e4, p.throughput(), 1e-3);
+}
+
+namespace {
+
+OffloadConvParams last_conv_params;
+bool last_had_conv_params = false;
+
+void recording_offload(const vec_t&, vec_t&, unsigned int, OffloadConvParams* p) {
+    last_had_conv_params = p != nullptr;
+    if (p) last_conv_params = *p;
+}
+
+} // namespace
+
+TEST(offload_partitioner, conv_params) {
+    network<mse, adagrad> nn;
+    nn << convolutional_layer<identity>(8, 6, 3, 2, 4)
+       << max_pooling_layer<identity>(6, 4, 4, 2)
+       << fully_connected_layer<identity>(3 * 2 * 4, 10);
+
+    accel_cost_model m;
+    m.layer_costs["conv"] = accel_layer_cost(1e6, 0);
+    m.layer_costs["max-pool"] = accel_layer_cost(1e6, 0);
+
+    auto p = partition_offload(nn, { 100, 100, 1 }, m);
+    EXPECT_EQ(1, p.segments.size());
+    EXPECT_EQ(0, p.segments[0].first);
+    EXPECT_EQ(1, p.segments[0].second);
+
+    auto off = apply_offload_partition(nn, p, recording_offload);
+    vec_t in(8 * 6 * 2);
+    off.predict(in);
+
+    EXPECT_TRUE(last_had_conv_params);
+    EXPECT_EQ(8, last_conv_params.in_width);
+    EXPECT_EQ(6, last_conv_params.in_height);
+    EXPECT_EQ(3, last_conv_params.window_size);
+    EXPECT_EQ(2, last_conv_params.in_channels);
+    EXPECT_EQ(4, last_conv_params.out_channels);
+}
+
+TEST(offload_partitioner, conv_params_are_copied) {
+    OffloadConvParams p;
+    p.in_width = 8; p.in_height = 6; p.window_size = 3; p.in_channels = 2; p.out_channels = 4;
+
+    network<mse, adagrad> nn;
+    {
+        offloaded_layer l(8 * 6 * 2, 6 * 4 * 4, recording_offload, 0);
+        l.set_conv_params(p);
+        nn << l;
+
+        // the network's copy keeps its own params
+        OffloadConvParams q = p;
+        q.in_width = 1;
+        l.set_conv_params(q);
+    }
+
+    vec_t in(8 * 6 * 2);
+    nn.predict(in);
+    EXPECT_TRUE(last_had_conv_params);
+    EXPECT_EQ(8, last_conv_params.in_width);
+}
+
+TEST(offload_partitioner, conv_refused) {
+    accel_cost_model m;
+    m.layer_costs["conv"] = accel_layer_cost(1e6, 0);
+    m.layer_costs["fully-connected"] = accel_layer_cost(1e6, 0);
+
+    // padded convolutions cannot be described by OffloadConvParams
+    {
+        network<mse, adagrad> nn;
+        nn << convolutional_layer<identity>(8, 8, 3, 1, 2, padding::same);
+        auto p = partition_offload(nn, { 100 }, m);
+
+        bool thrown = false;
+        try {
+            apply_offload_partition(nn, p, recording_offload);
+        } catch (const nn_error&) {
+            thrown = true;
+        }
+        EXPECT_TRUE(thrown);
+    }
+
+    // a conv layer behind another layer of the same segment has no parameters to go with it
+    {
+        network<mse, adagrad> nn;
+        nn << fully_connected_layer<identity>(10, 8 * 8)
+           << convolutional_layer<identity>(8, 8, 3, 1, 2);
+        auto p = partition_offload(nn, { 100, 100 }, m);
+        EXPECT_EQ(1, p.segments.size());
+
+        bool thrown = false;
+        try {
+            apply_offload_partition(nn, p, recording_offload);
+        } catch (const nn_error&) {
+            thrown = true;
+        }
+        EXPECT_TRUE(thrown);
+    }
+}
+
+} // namespace tiny_cnn
@@ -0,0 +1,68 @@
+/******************************************************************************
+ *  Copyright (c) 2016, Xilinx, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  1.  Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *  2.  Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *  3.  Neither the name of the copyright holder nor the names of its
+ *      contributors may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ *  OR BUSINESS INTERRUPTION). HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ *  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ *  ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *****************************************************************************/
+#pragma once
+#include "picotest/picotest.h"
+#include "testhelper.h"
+#include "tiny_cnn/tiny_cnn.h"
+
+namespace tiny_cnn {
+
+TEST(parallel_scheduler, plan) {
+    layers ls;
+    ls.add(std::make_shared<fully_connected_layer<tan_h>>(1000, 1000));  // 1M connections
+    ls.add(std::make_shared<fully_connected_layer<tan_h>>(1000, 1));     // 1k connections
+
+    parallel_scheduler s;
+
+    // one sample, 8 threads: only the large layer is worth splitting
+    auto p = s.plan(ls, 1, 8);
+    EXPECT_TRUE(p[0].mode == layer_parallelism::intra_layer);
+    EXPECT_TRUE(p[1].mode == layer_parallelism::none);
+    EXPECT_TRUE(p[0].grainsize >= 1 && p[0].grainsize < 1000 / 8);
+
+    // the batch alone keeps all threads busy
+    p = s.plan(ls, 64, 8);
+    EXPECT_TRUE(p[0].mode == layer_parallelism::samples);
+    EXPECT_TRUE(p[1].mode == layer_parallelism::samples);
+
+    // measured timings override the estimate
+    s.calibrate({ 1.0, 1000.0 });
+    p = s.plan(ls, 1, 8);
+    EXPECT_TRUE(p[0].mode == layer_parallelism::none);
+    EXPECT_TRUE(p[1].mode == layer_parallelism::intra_layer);
+
+    parallel_scheduler::apply(ls, p);
+    EXPECT_FALSE(ls[0]->parallelize());
+    EXPECT_TRUE(ls[1]->parallelize());
+}
+
+} // namespace tiny_cnn
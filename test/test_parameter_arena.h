@@ -0,0 +1,123 @@
+/******************************************************************************
+ *  Copyright (c) 2016, Xilinx, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  1.  Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *  2.  Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *  3.  Neither the name of the copyright holder nor the names of its
+ *      contributors may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ *  OR BUSINESS INTERRUPTION). HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ *  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ *  ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *****************************************************************************/
+#pragma once
+#include "picotest/picotest.h"
+#include "testhelper.h"
+#include "tiny_cnn/tiny_cnn.h"
+
+namespace tiny_cnn {
+
+// the optimizer applied to the merged gradients, vector by vector
+template <typename Optimizer>
+struct per_vector_reference {
+    void step(vec_t* dW, vec_t* H, vec_t* W, int n) {
+        for (int v = 0; v < n; v++)
+            opt.update(dW[v], H[v], W[v]);
+    }
+    Optimizer opt;
+};
+
+// adam as in the paper: the bias correction advances once per step, for
+// all vectors together (adam::update advances it once per vector)
+template <>
+struct per_vector_reference<adam> {
+    void step(vec_t* dW, vec_t*, vec_t* W, int n) {
+        const adam a;
+        b1_t *= a.b1;
+        b2_t *= a.b2;
+        for (int v = 0; v < n; v++) {
+            m[v].resize(W[v].size());
+            s[v].resize(W[v].size());
+            for (size_t i = 0; i < W[v].size(); i++) {
+                m[v][i] = a.b1 * m[v][i] + (1 - a.b1) * dW[v][i];
+                s[v][i] = a.b2 * s[v][i] + (1 - a.b2) * dW[v][i] * dW[v][i];
+                W[v][i] -= a.alpha * (m[v][i] / (1 - b1_t)) / std::sqrt(s[v][i] / (1 - b2_t) + float_t(1e-8));
+            }
+        }
+    }
+    vec_t m[2], s[2];
+    float_t b1_t = adam().b1_t, b2_t = adam().b2_t; // adam's starting powers
+};
+
+// the fused pass over a parameter_arena must give the same weights as
+// merging the workers by hand and applying the reference
+template <typename Optimizer>
+void check_fused_update() {
+    // the first vector straddles a chunk boundary
+    const size_t sizes[] = { parameter_arena::chunk_size + 13, 7 };
+    vec_t W[2], Wref[2], H[2], merged[2];
+    vec_t diff[2][CNN_TASK_SIZE];
+    parameter_arena p;
+
+    for (int v = 0; v < 2; v++) {
+        W[v].resize(sizes[v]);
+        uniform_rand(W[v].begin(), W[v].end(), -1.0, 1.0);
+        Wref[v] = W[v];
+        H[v].resize(sizes[v]);
+        merged[v].resize(sizes[v]);
+        for (auto& d : diff[v]) d.resize(sizes[v]);
+        p.add(W[v], diff[v], H[v]);
+    }
+    EXPECT_EQ(sizes[0] + sizes[1], p.size());
+
+    Optimizer fused;
+    per_vector_reference<Optimizer> ref;
+    for (int step = 0; step < 3; step++) {
+        for (int v = 0; v < 2; v++) {
+            uniform_rand(diff[v][0].begin(), diff[v][0].end(), -1.0, 1.0);
+            uniform_rand(diff[v][1].begin(), diff[v][1].end(), -1.0, 1.0);
+            for (size_t i = 0; i < sizes[v]; i++)
+                merged[v][i] = (diff[v][0][i] + diff[v][1][i]) / 2;
+        }
+
+        fused.update_fused(p, 2, 2);
+        ref.step(merged, H, Wref, 2);
+
+        for (int v = 0; v < 2; v++) {
+            for (size_t i = 0; i < sizes[v]; i++) {
+                EXPECT_NEAR(Wref[v][i], W[v][i], 1e-6);
+                EXPECT_EQ(float_t(0), diff[v][0][i]);
+                EXPECT_EQ(float_t(0), diff[v][1][i]);
+            }
+        }
+    }
+}
+
+TEST(parameter_arena, fused_update) {
+    check_fused_update<gradient_descent>();
+    check_fused_update<momentum>();
+    check_fused_update<RMSprop>();
+    check_fused_update<adagrad>();
+    check_fused_update<adam>();
+}
+
+} // namespace tiny_cnn
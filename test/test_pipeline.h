@@ -0,0 +1,152 @@
+/******************************************************************************
+ *  Copyright (c) 2016, Xilinx, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  1.  Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *  2.  Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *  3.  Neither the name of the copyright holder nor the names of its
+ *      contributors may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ *  OR BUSINESS INTERRUPTION). HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ *  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ *  ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *****************************************************************************/
+#pragma once
+#include "picotest/picotest.h"
+#include "testhelper.h"
+#include "tiny_cnn/tiny_cnn.h"
+#include <atomic>
+#include <chrono>
+#include <ctime>
+
+namespace tiny_cnn {
+
+TEST(pipeline, balance) {
+    std::vector<size_t> b = balance_pipeline({ 1, 1, 8, 2, 2, 2, 2 }, 3);
+    EXPECT_EQ(3u, b.size());
+    EXPECT_EQ(0u, b[0]);
+    EXPECT_EQ(2u, b[1]);   // [1 1] [8] [2 2 2 2]
+    EXPECT_EQ(3u, b[2]);
+}
+
+TEST(pipeline, same_as_predict) {
+    network<mse, adagrad> nn;
+    nn << convolutional_layer<tan_h>(10, 10, 3, 1, 4)
+       << average_pooling_layer<tan_h>(8, 8, 4, 2)
+       << fully_connected_layer<tan_h>(64, 16)
+       << fully_connected_layer<identity>(16, 3);
+    nn.init_weight();
+
+    std::vector<vec_t> in(20, vec_t(100));
+    std::vector<vec_t> expected;
+    for (auto& v : in) {
+        uniform_rand(v.begin(), v.end(), -1.0, 1.0);
+        expected.push_back(nn.predict(v));
+    }
+
+    {
+        pipeline<mse, adagrad> p(nn, { 0, 2, 3 }, std::vector<int>(), 4);
+        EXPECT_EQ(3u, p.stages());
+
+        std::thread feeder([&] {
+            for (auto& v : in) p.push(v);
+        });
+        for (size_t i = 0; i < in.size(); i++) {
+            vec_t out;
+            p.pop(out);
+            for (size_t j = 0; j < out.size(); j++)
+                EXPECT_FLOAT_EQ(expected[i][j], out[j]);
+        }
+        feeder.join();
+    }
+
+    // the network is usable again
+    vec_t out = nn.predict(in[0]);
+    EXPECT_FLOAT_EQ(expected[0][0], out[0]);
+}
+
+namespace {
+
+std::atomic<bool> fail_forward(false);
+
+class failing_layer : public fully_connected_layer<identity> {
+public:
+    failing_layer(cnn_size_t in_dim, cnn_size_t out_dim) : fully_connected_layer<identity>(in_dim, out_dim) {}
+
+    const vec_t& forward_propagation(const vec_t& in, size_t index) override {
+        if (fail_forward) throw nn_error("layer failed");
+        return fully_connected_layer<identity>::forward_propagation(in, index);
+    }
+};
+
+} // namespace
+
+TEST(pipeline, stage_error) {
+    network<mse, adagrad> nn;
+    nn << fully_connected_layer<identity>(4, 4)
+       << failing_layer(4, 4)
+       << fully_connected_layer<identity>(4, 2);
+    nn.init_weight();
+
+    pipeline<mse, adagrad> p(nn, { 0, 1, 2 });
+    vec_t out;
+    p.push(vec_t(4, float_t(1)));
+    p.pop(out);
+    EXPECT_EQ(2u, out.size());
+
+    // the exception of the stage thread reaches the caller instead of terminating
+    fail_forward = true;
+    bool thrown = false;
+    try {
+        p.push(vec_t(4, float_t(1)));
+        p.pop(out);
+    } catch (const nn_error&) {
+        thrown = true;
+    }
+    fail_forward = false;
+    EXPECT_TRUE(thrown);
+}
+
+#if defined(__linux__)
+TEST(pipeline, idle_stages_sleep) {
+    network<mse, adagrad> nn;
+    nn << fully_connected_layer<identity>(4, 4)
+       << fully_connected_layer<identity>(4, 4)
+       << fully_connected_layer<identity>(4, 2);
+    nn.init_weight();
+
+    pipeline<mse, adagrad> p(nn, { 0, 1, 2 });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    // three stages waiting for input must not burn their cores
+    const std::clock_t start = std::clock();
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    const double cpu_seconds = double(std::clock() - start) / CLOCKS_PER_SEC;
+    EXPECT_TRUE(cpu_seconds < 0.05);
+
+    vec_t out;
+    p.push(vec_t(4, float_t(1)));
+    p.pop(out);
+    EXPECT_EQ(2u, out.size());
+}
+#endif
+
+} // namespace tiny_cnn
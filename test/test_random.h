@@ -0,0 +1,115 @@
+/******************************************************************************
+ *  Copyright (c) 2016, Xilinx, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  1.  Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *  2.  Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *  3.  Neither the name of the copyright holder nor the names of its
+ *      contributors may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ *  OR BUSINESS INTERRUPTION). HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ *  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ *  ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *****************************************************************************/
+#pragma once
+#include "picotest/picotest.h"
+#include "testhelper.h"
+#include "tiny_cnn/tiny_cnn.h"
+
+namespace tiny_cnn {
+
+TEST(random, philox) {
+    // known answers from the Random123 distribution
+    const uint32_t zero[4] = { 0, 0, 0, 0 };
+    const uint32_t ones[4] = { 0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff };
+    const uint32_t pi_ctr[4] = { 0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344 };
+    const uint32_t pi_key[2] = { 0xa4093822, 0x299f31d0 };
+    uint32_t out[4];
+
+    detail::philox4x32(zero, zero, out);
+    EXPECT_EQ(0x6627e8d5u, out[0]);
+    EXPECT_EQ(0xe169c58du, out[1]);
+    EXPECT_EQ(0xbc57ac4cu, out[2]);
+    EXPECT_EQ(0x9b00dbd8u, out[3]);
+
+    detail::philox4x32(ones, ones, out);
+    EXPECT_EQ(0x408f276du, out[0]);
+    EXPECT_EQ(0x41c83b0eu, out[1]);
+    EXPECT_EQ(0xa20bc7c6u, out[2]);
+    EXPECT_EQ(0x6d5451fdu, out[3]);
+
+    detail::philox4x32(pi_ctr, pi_key, out);
+    EXPECT_EQ(0xd16cfe09u, out[0]);
+    EXPECT_EQ(0x94fdccebu, out[1]);
+    EXPECT_EQ(0x5001e420u, out[2]);
+    EXPECT_EQ(0x24126ea1u, out[3]);
+}
+
+TEST(random, stream) {
+    random_stream a(3, 1), b(3, 1), c(3, 2);
+
+    // bulk generation continues the scalar sequence
+    std::vector<uint32_t> bulk(203);
+    a.next_u32();
+    a.fill_u32(&bulk[0], bulk.size());
+    b.next_u32();
+    for (size_t i = 0; i < bulk.size(); i++)
+        EXPECT_EQ(b.next_u32(), bulk[i]);
+
+    // substreams are independent
+    EXPECT_NE(random_stream(3, 1).next_u64(), c.next_u64());
+
+    bool mask[1000];
+    random_stream(5, 0).bernoulli(mask, 1000, 0.25);
+    const int ones = static_cast<int>(std::count(mask, mask + 1000, true));
+    EXPECT_GT(ones, 200);
+    EXPECT_LT(ones, 300);
+
+    for (int i = 0; i < 100; i++) {
+        const int v = c.uniform_int(-3, 3);
+        EXPECT_GE(v, -3);
+        EXPECT_LE(v, 3);
+    }
+}
+
+TEST(random, seed) {
+    const uint64_t seed = get_random_seed();
+    vec_t v1(10), v2(10);
+
+    set_random_seed(42);
+    uniform_rand(v1.begin(), v1.end(), -1, 1);
+    set_random_seed(42);
+    uniform_rand(v2.begin(), v2.end(), -1, 1);
+    EXPECT_TRUE(v1 == v2);
+
+    // the dropout masks of a worker repeat as well
+    dropout_layer d1(100, float_t(0.5));
+    vec_t in(100, float_t(1));
+    set_random_seed(7);
+    vec_t out1 = d1.forward_propagation(in, 3);
+    set_random_seed(7);
+    vec_t out2 = d1.forward_propagation(in, 3);
+    EXPECT_TRUE(out1 == out2);
+
+    set_random_seed(seed);
+}
+
+} // namespace tiny_cnn
@@ -0,0 +1,104 @@
+/******************************************************************************
+ *  Copyright (c) 2016, Xilinx, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  1.  Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *  2.  Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *  3.  Neither the name of the copyright holder nor the names of its
+ *      contributors may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ *  OR BUSINESS INTERRUPTION). HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ *  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ *  ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *****************************************************************************/
+#pragma once
+#include "picotest/picotest.h"
+#include "testhelper.h"
+#include "tiny_cnn/tiny_cnn.h"
+
+namespace tiny_cnn {
+
+TEST(scratch_arena, alignment) {
+    scratch_arena arena;
+    scratch_scope scope(arena);
+
+    char* c = scope.allocate<char>(3);
+    float_t* f = scope.allocate<float_t>(17);
+    double* d = scope.allocate<double>(1);
+
+    EXPECT_EQ(0u, reinterpret_cast<size_t>(c) % 64);
+    EXPECT_EQ(0u, reinterpret_cast<size_t>(f) % 64);
+    EXPECT_EQ(0u, reinterpret_cast<size_t>(d) % 64);
+    EXPECT_TRUE(static_cast<void*>(f) != static_cast<void*>(d));
+}
+
+TEST(scratch_arena, scoped_release) {
+    scratch_arena arena(1024);
+    float_t* outer;
+    float_t* first;
+    {
+        scratch_scope s1(arena);
+        outer = s1.allocate<float_t>(16);
+        {
+            scratch_scope s2(arena);
+            first = s2.allocate<float_t>(16);
+            EXPECT_TRUE(first != outer);
+        }
+        // the inner scope gave its memory back
+        scratch_scope s3(arena);
+        EXPECT_TRUE(s3.allocate<float_t>(16) == first);
+    }
+    scratch_scope s4(arena);
+    EXPECT_TRUE(s4.allocate<float_t>(16) == outer);
+}
+
+TEST(scratch_arena, steady_state) {
+    scratch_arena arena(256);
+
+    // outgrows the first block, then is merged into one block of the peak size
+    for (int round = 0; round < 3; round++) {
+        const size_t allocs = alloc_check::count();
+        {
+            scratch_scope scope(arena);
+            for (int i = 0; i < 10; i++) {
+                float_t* p = scope.allocate<float_t>(1000);
+                std::fill(p, p + 1000, float_t(i));
+            }
+        }
+        if (round > 0) EXPECT_EQ(allocs, alloc_check::count());
+    }
+    EXPECT_GE(arena.capacity(), arena.peak());
+    EXPECT_GE(arena.peak(), 10 * 1000 * sizeof(float_t));
+}
+
+TEST(scratch_arena, per_thread) {
+    scratch_arena* main_arena = &scratch_arena::local();
+    scratch_arena* other_arena = nullptr;
+
+    std::thread t([&] { other_arena = &scratch_arena::local(); });
+    t.join();
+
+    EXPECT_TRUE(other_arena != nullptr);
+    EXPECT_TRUE(other_arena != main_arena);
+    EXPECT_TRUE(&scratch_arena::local() == main_arena);
+}
+
+} // namespace tiny_cnn
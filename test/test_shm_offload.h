@@ -0,0 +1,176 @@
+/******************************************************************************
+ *  Copyright (c) 2016, Xilinx, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  1.  Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *  2.  Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *  3.  Neither the name of the copyright holder nor the names of its
+ *      contributors may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ *  OR BUSINESS INTERRUPTION). HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ *  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ *  ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *****************************************************************************/
+#pragma once
+#include "picotest/picotest.h"
+#include "testhelper.h"
+#include "tiny_cnn/tiny_cnn.h"
+
+#if !defined(_WIN32)
+#include "tiny_cnn/io/shm_offload.h"
+#include <thread>
+#include <unistd.h>
+
+namespace tiny_cnn {
+
+namespace {
+
+std::string shm_test_name(const char* suffix) {
+    return "/tiny_cnn_test_" + std::to_string(::getpid()) + "_" + suffix;
+}
+
+// publishes a hand-written request the way a (possibly hostile) host would
+uint32_t raw_shm_call(shm_offload::ring& r, uint64_t in_size, uint64_t out_size) {
+    shm_offload::ring_header* h = r.header();
+    const uint64_t pos = h->head.fetch_add(1);
+    shm_offload::slot& s = r.slot_at(pos);
+    while (s.seq.load(std::memory_order_acquire) != pos) std::this_thread::yield();
+
+    std::memset(&s.req, 0, sizeof(s.req));
+    s.req.in_size = in_size;
+    s.req.out_size = out_size;
+    s.seq.store(pos + 1, std::memory_order_release);
+
+    while (s.seq.load(std::memory_order_acquire) != pos + 2) std::this_thread::yield();
+    const uint32_t status = s.req.status;
+    s.seq.store(pos + h->num_slots, std::memory_order_release);
+    return status;
+}
+
+} // namespace
+
+TEST(shm_offload, round_trip) {
+    const std::string name = shm_test_name("rt");
+    auto fc = std::make_shared<fully_connected_layer<activation::identity>>(16, 8);
+    fc->init_weight();
+
+    std::vector<vec_t> in(4, vec_t(16));
+    std::vector<vec_t> expected;
+    for (auto& v : in) {
+        uniform_rand(v.begin(), v.end(), -1.0, 1.0);
+        expected.push_back(fc->forward_propagation(v, 0));
+    }
+
+    shm_offload::server srv(name, 4, 16, shm_offload::timing_model());
+    srv.add_layer(3, 0, fc);
+    std::thread service([&] { srv.run(); });
+
+    shm_offload::client c(name);
+    std::vector<std::thread> hosts;
+    std::atomic<int> mismatches(0);
+
+    // more threads than slots: requests wait for the ring to drain
+    for (int t = 0; t < 6; t++) {
+        hosts.emplace_back([&, t] {
+            vec_t out(8);
+            for (int i = 0; i < 50; i++) {
+                const size_t k = (t + i) % in.size();
+                c.call(in[k], out, 3, nullptr);
+                if (out != expected[k]) mismatches++;
+            }
+        });
+    }
+    for (auto& h : hosts) h.join();
+
+    srv.shutdown();
+    service.join();
+
+    EXPECT_EQ(0, mismatches.load());
+    EXPECT_EQ(300u, c.calls());
+    EXPECT_EQ(300u, srv.calls());
+}
+
+TEST(shm_offload, rejects_oversized_requests) {
+    const std::string name = shm_test_name("big");
+    int created = 0;
+    shm_offload::layer_factory factory = [&](const shm_offload::request& r) -> std::shared_ptr<layer_base> {
+        created++;
+        return std::make_shared<fully_connected_layer<activation::identity>>(
+            static_cast<cnn_size_t>(r.in_size), static_cast<cnn_size_t>(r.out_size));
+    };
+
+    shm_offload::server srv(name, 4, 16, shm_offload::timing_model(), factory);
+    std::thread service([&] { srv.run(); });
+
+    {
+        std::unique_ptr<shm_offload::ring> r = shm_offload::ring::attach(name);
+        EXPECT_EQ(uint32_t(shm_offload::status_too_large), raw_shm_call(*r, 17, 4));
+        EXPECT_EQ(uint32_t(shm_offload::status_too_large), raw_shm_call(*r, 4, 1 << 20));
+        EXPECT_EQ(0, created);
+
+        EXPECT_EQ(uint32_t(shm_offload::status_ok), raw_shm_call(*r, 16, 16));
+        EXPECT_EQ(1, created);
+    }
+
+    // the client refuses them before they reach the ring
+    shm_offload::client c(name);
+    vec_t in(17), out(4);
+    bool thrown = false;
+    try {
+        c.call(in, out, 0, nullptr);
+    } catch (const nn_error&) {
+        thrown = true;
+    }
+    EXPECT_TRUE(thrown);
+
+    srv.shutdown();
+    service.join();
+}
+
+TEST(shm_offload, name_is_not_stolen) {
+    const std::string name = shm_test_name("own");
+    auto attachable = [&] {
+        try {
+            shm_offload::ring::attach(name);
+            return true;
+        } catch (const nn_error&) {
+            return false;
+        }
+    };
+    std::unique_ptr<shm_offload::server> first(new shm_offload::server(name, 4, 16, shm_offload::timing_model()));
+
+    bool thrown = false;
+    try {
+        shm_offload::server second(name, 4, 16, shm_offload::timing_model());
+    } catch (const nn_error&) {
+        thrown = true;
+    }
+    EXPECT_TRUE(thrown);
+    EXPECT_TRUE(attachable());
+
+    // an explicit replacement takes the name, and keeps it when the first goes
+    shm_offload::server second(name, 4, 16, shm_offload::timing_model(), shm_offload::bnn_layer_factory(), true);
+    first.reset();
+    EXPECT_TRUE(attachable());
+}
+
+} // namespace tiny_cnn
+#endif // !_WIN32
@@ -0,0 +1,182 @@
+/******************************************************************************
+ *  Copyright (c) 2016, Xilinx, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  1.  Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *  2.  Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *  3.  Neither the name of the copyright holder nor the names of its
+ *      contributors may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ *  OR BUSINESS INTERRUPTION). HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ *  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ *  ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *****************************************************************************/
+#pragma once
+#include "picotest/picotest.h"
+#include "testhelper.h"
+#include "tiny_cnn/tiny_cnn.h"
+#include "tiny_cnn/util/thread_pool.h"
+#include <chrono>
+#include <ctime>
+#include <mutex>
+#include <set>
+#include <sstream>
+
+namespace tiny_cnn {
+
+TEST(thread_pool, run) {
+    thread_pool pool(4);
+    std::vector<int> hits(1000, 0);
+
+    for (int n = 1; n <= 1000; n += 37) {
+        pool.run(0, n, [&](int b, int e) {
+            for (int i = b; i < e; i++) hits[i]++;
+        });
+    }
+    for (int i = 0; i < 1000; i++)
+        EXPECT_EQ((1000 - i + 36) / 37, hits[i]);
+
+    // nested loops are split across the same threads
+    std::atomic<int> count(0);
+    pool.run(0, 16, [&](int b, int e) {
+        for (int i = b; i < e; i++)
+            pool.run(0, 10, [&](int b2, int e2) { count += e2 - b2; });
+    });
+    EXPECT_EQ(160, count.load());
+
+    bool caught = false;
+    try {
+        pool.run(0, 100, [&](int b, int) { if (b > 50) throw nn_error("error"); });
+    } catch (const nn_error&) {
+        caught = true;
+    }
+    EXPECT_TRUE(caught);
+}
+
+#if defined(__linux__)
+TEST(thread_pool, idle_threads_block) {
+    thread_pool pool(4);
+
+    // one long chunk per loop: everybody else has to wait for it without
+    // burning a core (std::clock is the CPU time of the process here)
+    const std::clock_t start = std::clock();
+    for (int slow = 0; slow < 4; slow += 3) {
+        pool.run(0, 4, [&](int b, int e) {
+            for (int i = b; i < e; i++)
+                if (i == slow) std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        });
+    }
+    const double cpu_seconds = double(std::clock() - start) / CLOCKS_PER_SEC;
+    EXPECT_TRUE(cpu_seconds < 0.2);
+}
+#endif
+
+TEST(thread_pool, config) {
+    std::vector<int> cpus = thread_config::parse_cpu_list("0-2,5,7-8");
+    int expected[] = { 0, 1, 2, 5, 7, 8 };
+
+    EXPECT_EQ(6u, cpus.size());
+    for (size_t i = 0; i < cpus.size(); i++)
+        EXPECT_EQ(expected[i], cpus[i]);
+
+    thread_config cfg;
+    cfg.num_threads = 3;
+    cfg.cpus = { 0 };
+    EXPECT_EQ(0, cfg.cpu_of_thread(2));
+
+    thread_pool pool(cfg);
+    EXPECT_EQ(3u, pool.size());
+
+    std::atomic<int> count(0);
+    pool.run(0, 100, [&](int b, int e) { count += e - b; });
+    EXPECT_EQ(100, count.load());
+}
+
+#if !defined(CNN_USE_OMP) && !defined(CNN_USE_TBB)
+TEST(thread_pool, short_loops_are_parallel) {
+    const thread_config saved = global_thread_config();
+    thread_config cfg;
+    cfg.num_threads = 4;
+    set_thread_config(cfg);
+
+    // far fewer iterations than the old default grainsize of 100
+    std::mutex m;
+    std::set<std::thread::id> threads;
+    for_i(8, [&](int) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        std::lock_guard<std::mutex> lock(m);
+        threads.insert(std::this_thread::get_id());
+    });
+    set_thread_config(saved);
+
+    EXPECT_TRUE(threads.size() > 1);
+}
+#endif
+
+TEST(thread_config, numa_place) {
+    vec_t small(10, float_t(1)), large(3000, float_t(2)), empty;
+    const int node = numa_node_of_cpu(0);
+
+    if (numa_place<float_t, 64>({ &small, &large, &empty }, node)) {
+        // small buffers get whole pages of their own
+        EXPECT_EQ(0u, reinterpret_cast<size_t>(&small[0]) % 4096);
+        EXPECT_EQ(0u, reinterpret_cast<size_t>(&large[0]) % 64);
+    }
+    EXPECT_EQ(10u, small.size());
+    EXPECT_EQ(3000u, large.size());
+    EXPECT_TRUE(empty.empty());
+    EXPECT_EQ(float_t(1), small[9]);
+    EXPECT_EQ(float_t(2), large[2999]);
+
+    // the buffers keep working as vectors after they left the mapping
+    large.resize(5000, float_t(3));
+    EXPECT_EQ(float_t(2), large[0]);
+    EXPECT_EQ(float_t(3), large[4999]);
+}
+
+TEST(thread_config, bind_worker_buffers) {
+    network<mse, adagrad> a, b;
+    a << fully_connected_layer<tan_h>(20, 10) << fully_connected_layer<tan_h>(10, 3);
+    b << fully_connected_layer<tan_h>(20, 10) << fully_connected_layer<tan_h>(10, 3);
+    a.init_weight();
+    std::stringstream ss;
+    a.save(ss);
+    b.load(ss);
+
+    // every worker slot placed for cpu 0
+    const thread_config saved = global_thread_config();
+    global_thread_config().num_threads = 2;
+    global_thread_config().cpus = { 0 };
+    b.bind_worker_buffers();
+    global_thread_config() = saved;
+
+    std::vector<vec_t> data(8, vec_t(20));
+    std::vector<label_t> labels(8);
+    for (size_t i = 0; i < data.size(); i++) {
+        uniform_rand(data[i].begin(), data[i].end(), -1.0, 1.0);
+        labels[i] = static_cast<label_t>(i % 3);
+    }
+    a.train(data, labels, 4, 2, nop, nop, false, 1);
+    b.train(data, labels, 4, 2, nop, nop, false, 1);
+    EXPECT_TRUE(a.has_same_weights(b, 0));
+}
+
+} // namespace tiny_cnn
@@ -26,6 +26,7 @@
 */
 #pragma once
 #include "tiny_cnn/util/util.h"
+#include "tiny_cnn/util/fast_math.h"
 #include <algorithm>
 
 namespace tiny_cnn {
@@ -46,64 +47,142 @@ public:
 
     virtual float_t f(const vec_t& v, cnn_size_t index) const = 0;
 
+    // out[i] = f(v, i) for all i, in one pass over the vector
+    virtual void f(const vec_t& v, vec_t& out) const {
+        for (cnn_size_t i = 0; i < v.size(); i++) out[i] = f(v, i);
+    }
+
     // dfi/dyi
     virtual float_t df(float_t y) const = 0;
 
     // dfi/dyk (k=0,1,..n)
     virtual vec_t df(const vec_t& y, cnn_size_t i) const { vec_t v(y.size(), 0); v[i] = df(y[i]); return v; }
 
+    // dy[i] = dfi/dyi for all i
+    virtual void df(const vec_t& y, vec_t& dy) const {
+        for (cnn_size_t i = 0; i < y.size(); i++) dy[i] = df(y[i]);
+    }
+
+    // delta[i] *= dfi/dyi for all i (back propagation through the activation)
+    virtual void mul_df(const vec_t& y, vec_t& delta) const {
+        for (cnn_size_t i = 0; i < y.size(); i++) delta[i] *= df(y[i]);
+    }
+
+    // delta = J^T delta with the full jacobian J[k][i] = dyk/dai. the same as
+    // mul_df unless the outputs depend on more than their own input (softmax)
+    virtual void mul_jacobian(const vec_t& y, vec_t& delta) const {
+        mul_df(y, delta);
+    }
+
     // target value range for learning
     virtual std::pair<float_t, float_t> scale() const = 0;
+
+    // accuracy of exp/tanh in the whole-vector f(v, out)
+    void set_accuracy(math_accuracy accuracy) { accuracy_ = accuracy; }
+    math_accuracy accuracy() const { return accuracy_; }
+
+protected:
+    math_accuracy accuracy_ = math_accuracy::exact;
 };
 
-class identity : public function {
+/**
+ * activation applied to each element independently. Derived provides
+ * static value(x) and derivative(y) (in terms of the output y), the vector
+ * versions call them in plain loops that the compiler inlines and vectorizes.
+ * Derived may also provide approximate(v, out, accuracy), used by f(v, out)
+ * when the accuracy is not exact; returning false falls back to value()
+ **/
+template <typename Derived>
+class elementwise_function : public function {
 public:
     using function::df;
-    float_t f(const vec_t& v, cnn_size_t i) const override { return v[i]; }
-    float_t df(float_t /*y*/) const override { return float_t(1); }
+
+    float_t f(const vec_t& v, cnn_size_t i) const override { return Derived::value(v[i]); }
+    float_t df(float_t y) const override { return Derived::derivative(y); }
+
+    void f(const vec_t& v, vec_t& out) const override {
+        if (accuracy_ != math_accuracy::exact && Derived::approximate(v, out, accuracy_)) return;
+
+        const float_t* x = &v[0];
+        float_t* y = &out[0];
+        const size_t n = v.size();
+        for (size_t i = 0; i < n; i++) y[i] = Derived::value(x[i]);
+    }
+
+    void df(const vec_t& y, vec_t& dy) const override {
+        const float_t* py = &y[0];
+        float_t* pd = &dy[0];
+        const size_t n = y.size();
+        for (size_t i = 0; i < n; i++) pd[i] = Derived::derivative(py[i]);
+    }
+
+    void mul_df(const vec_t& y, vec_t& delta) const override {
+        const float_t* py = &y[0];
+        float_t* pd = &delta[0];
+        const size_t n = y.size();
+        for (size_t i = 0; i < n; i++) pd[i] *= Derived::derivative(py[i]);
+    }
+
+    static bool approximate(const vec_t&, vec_t&, math_accuracy) { return false; }
+};
+
+class identity : public elementwise_function<identity> {
+public:
+    static float_t value(float_t x) { return x; }
+    static float_t derivative(float_t /*y*/) { return float_t(1); }
     std::pair<float_t, float_t> scale() const override { return std::make_pair(float_t(0.1), float_t(0.9)); }
 };
 
-class bnn_sign : public function {
+class bnn_sign : public elementwise_function<bnn_sign> {
 public:
-    using function::df;
-    float_t f(const vec_t& v, cnn_size_t i) const override { return v[i] > 0 ? 1 : -1; }
-    float_t df(float_t /*y*/) const override { throw "Derivative of sign not implemented"; return float_t(1); }
+    static float_t value(float_t x) { return x > 0 ? 1 : -1; }
+    static float_t derivative(float_t /*y*/) { throw "Derivative of sign not implemented"; return float_t(1); }
     std::pair<float_t, float_t> scale() const override { throw "Scaling of sign not implemented"; return std::make_pair(float_t(0.1), float_t(0.9)); }
 };
 
 
-class sigmoid : public function {
+class sigmoid : public elementwise_function<sigmoid> {
 public:
-    using function::df;
-    float_t f(const vec_t& v, cnn_size_t i) const override { return float_t(1) / (float_t(1) + std::exp(-v[i])); }
-    float_t df(float_t y) const override { return y * (float_t(1) - y); }
+    static float_t value(float_t x) { return float_t(1) / (float_t(1) + exp(-x)); }
+    static float_t derivative(float_t y) { return y * (float_t(1) - y); }
+    static bool approximate(const vec_t& v, vec_t& out, math_accuracy accuracy) {
+        return fast_math::sigmoid(&v[0], &out[0], v.size(), accuracy);
+    }
     std::pair<float_t, float_t> scale() const override { return std::make_pair(float_t(0.1), float_t(0.9)); }
 };
 
-class relu : public function {
+class relu : public elementwise_function<relu> {
 public:
-    using function::df;
-    float_t f(const vec_t& v, cnn_size_t i) const override { return std::max(float_t(0), v[i]); }
-    float_t df(float_t y) const override { return y > float_t(0) ? float_t(1) : float_t(0); }
+    static float_t value(float_t x) { return std::max(float_t(0), x); }
+    static float_t derivative(float_t y) { return y > float_t(0) ? float_t(1) : float_t(0); }
     std::pair<float_t, float_t> scale() const override { return std::make_pair(float_t(0.1), float_t(0.9)); }
 };
 
 typedef relu rectified_linear; // for compatibility
 
-class leaky_relu : public function {
+class leaky_relu : public elementwise_function<leaky_relu> {
 public:
-    using function::df;
-    float_t f(const vec_t& v, cnn_size_t i) const override { return (v[i] > float_t(0)) ? v[i] : float_t(0.01) * v[i]; }
-    float_t df(float_t y) const override { return y > float_t(0) ? float_t(1) : float_t(0.01); }
+    static float_t value(float_t x) { return (x > float_t(0)) ? x : float_t(0.01) * x; }
+    static float_t derivative(float_t y) { return y > float_t(0) ? float_t(1) : float_t(0.01); }
     std::pair<float_t, float_t> scale() const override { return std::make_pair(float_t(0.1), float_t(0.9)); }
 };
 
-class elu : public function {
+class elu : public elementwise_function<elu> {
 public:
-    using function::df;
-    float_t f(const vec_t& v, cnn_size_t i) const override { return (v[i]<float_t(0) ? (exp(v[i])- float_t(1)) : v[i]); }
-    float_t df(float_t y) const override { return (y > float_t(0) ? float_t(1) : (float_t(1)+y)); }
+    static float_t value(float_t x) { return (x<float_t(0) ? (exp(x)- float_t(1)) : x); }
+    static float_t derivative(float_t y) { return (y > float_t(0) ? float_t(1) : (float_t(1)+y)); }
+    // exp of a chunk at a time, so that out may be v
+    static bool approximate(const vec_t& v, vec_t& out, math_accuracy accuracy) {
+        if (!fast_math::available<float_t>(accuracy)) return false;
+        float_t e[64];
+        for (size_t i = 0; i < v.size(); i += 64) {
+            const size_t len = std::min<size_t>(64, v.size() - i);
+            fast_math::exp(&v[i], e, len, accuracy);
+            for (size_t k = 0; k < len; k++)
+                out[i + k] = v[i + k] < float_t(0) ? e[k] - float_t(1) : v[i + k];
+        }
+        return true;
+    }
     std::pair<float_t, float_t> scale() const override { return std::make_pair(float_t(0.1), float_t(0.9)); }
 };
 
@@ -111,13 +190,28 @@ class softmax : public function {
 public:
     float_t f(const vec_t& v, cnn_size_t i) const override {
         float_t alpha = *std::max_element(v.begin(), v.end());
-        float_t numer = std::exp(v[i] - alpha);
+        float_t numer = exp(v[i] - alpha);
         float_t denom = float_t(0);
         for (auto x : v)
-            denom += std::exp(x - alpha);
+            denom += exp(x - alpha);
         return numer / denom;
     }
 
+    // max, exponentials and normalization in linear passes
+    void f(const vec_t& v, vec_t& out) const override {
+        const float_t alpha = *std::max_element(v.begin(), v.end());
+        const size_t n = v.size();
+        for (size_t i = 0; i < n; i++) out[i] = v[i] - alpha;
+        if (!fast_math::exp(&out[0], &out[0], n, accuracy_)) {
+            for (size_t i = 0; i < n; i++) out[i] = exp(out[i]);
+        }
+
+        float_t denom = float_t(0);
+        for (size_t i = 0; i < n; i++) denom += out[i];
+        const float_t inv = float_t(1) / denom;
+        for (size_t i = 0; i < n; i++) out[i] *= inv;
+    }
+
     float_t df(float_t y) const override {
         return y * (float_t(1) - y);
     }
@@ -130,50 +224,57 @@ public:
         return v;
     }
 
+    // diagonal of the jacobian
+    void df(const vec_t& y, vec_t& dy) const override {
+        for (size_t i = 0; i < y.size(); i++) dy[i] = y[i] * (float_t(1) - y[i]);
+    }
+
+    void mul_df(const vec_t& y, vec_t& delta) const override {
+        for (size_t i = 0; i < y.size(); i++) delta[i] *= y[i] * (float_t(1) - y[i]);
+    }
+
+    // sum_k delta[k] * dyk/dai = yi * (delta[i] - sum_k delta[k] * yk), in O(n)
+    void mul_jacobian(const vec_t& y, vec_t& delta) const override {
+        float_t dot = float_t(0);
+        for (size_t k = 0; k < y.size(); k++) dot += delta[k] * y[k];
+        for (size_t i = 0; i < y.size(); i++) delta[i] = y[i] * (delta[i] - dot);
+    }
+
     std::pair<float_t, float_t> scale() const override { return std::make_pair(float_t(0), float_t(1)); }
 };
 
-class tan_h : public function {
+class tan_h : public elementwise_function<tan_h> {
 public:
-    using function::df;
-    float_t f(const vec_t& v, cnn_size_t i) const override {
-        const float_t ep = std::exp(v[i]);
-        const float_t em = std::exp(-v[i]); 
+    static float_t value(float_t x) {
+        const float_t ep = exp(x);
+        const float_t em = exp(-x); 
         return (ep - em) / (ep + em);
     }
 
-    // fast approximation of tanh (improve 2-3% speed in LeNet-5)
-    /*float_t f(float_t x) const {
-        const float_t x2 = x * x;
-        x *= 1.0 + x2 * (0.1653 + x2 * 0.0097);
-        return x / std::sqrt(1.0 + x * x);// invsqrt(static_cast<float>(1.0 + x * x));
-    }*/
-
-    float_t df(float_t y) const override { return float_t(1) - sqr(y); }
+    static float_t derivative(float_t y) { return float_t(1) - sqr(y); }
+    static bool approximate(const vec_t& v, vec_t& out, math_accuracy accuracy) {
+        return fast_math::tanh(&v[0], &out[0], v.size(), accuracy);
+    }
     std::pair<float_t, float_t> scale() const override { return std::make_pair(float_t(-0.8), float_t(0.8)); }
-
-private:
-    /*float invsqrt(float x) const {
-        float x2 = x * 0.5f;
-        long i = *reinterpret_cast<long*>(&x);
-
-        i = 0x5f3759df - (i >> 1);
-        x = *reinterpret_cast<float*>(&i);
-        x = x * (1.5f - (x2 * x * x));
-        return x;
-    }*/
 };
 
 // s tan_h, but scaled to match the other functions
-class tan_hp1m2 : public function {
+class tan_hp1m2 : public elementwise_function<tan_hp1m2> {
 public:
-    using function::df;
-    float_t f(const vec_t& v, cnn_size_t i) const override {
-        const float_t ep = std::exp(v[i]);
-        return ep / (ep + std::exp(-v[i]));
+    static float_t value(float_t x) {
+        const float_t ep = exp(x);
+        return ep / (ep + exp(-x));
     }
 
-    float_t df(float_t y) const override { return 2 * y *(float_t(1) - y); }
+    static float_t derivative(float_t y) { return 2 * y *(float_t(1) - y); }
+
+    // e^x / (e^x + e^-x) = sigmoid(2x). out is only written once the
+    // approximation is known to run, as the exact fallback reads v
+    static bool approximate(const vec_t& v, vec_t& out, math_accuracy accuracy) {
+        if (!fast_math::available<float_t>(accuracy)) return false;
+        for (size_t i = 0; i < v.size(); i++) out[i] = v[i] + v[i];
+        return fast_math::sigmoid(&out[0], &out[0], v.size(), accuracy);
+    }
     std::pair<float_t, float_t> scale() const override { return std::make_pair(float_t(0.1), float_t(0.9)); }
 };
 
@@ -52,6 +52,29 @@
  */
 #define CNN_USE_EXCEPTIONS
 
+/**
+ * define to use fixed point arithmetic instead of floating point,
+ * i.e. emulate the datapath of the hardware bit-exactly.
+ * the format is set by CNN_FIXED_INT_BITS (including sign) and CNN_FIXED_FRAC_BITS
+ */
+//#define CNN_USE_FIXED_POINT
+
+#ifdef CNN_USE_FIXED_POINT
+#include "tiny_cnn/util/fixed_point.h"
+#ifndef CNN_FIXED_INT_BITS
+#define CNN_FIXED_INT_BITS 8
+#endif
+#ifndef CNN_FIXED_FRAC_BITS
+#define CNN_FIXED_FRAC_BITS 8
+#endif
+#ifndef CNN_FIXED_ROUNDING
+#define CNN_FIXED_ROUNDING round
+#endif
+#ifndef CNN_FIXED_OVERFLOW
+#define CNN_FIXED_OVERFLOW saturate
+#endif
+#endif
+
 /**
  * number of task in batch-gradient-descent.
  * @todo automatic optimization
@@ -68,7 +91,12 @@ namespace tiny_cnn {
  * calculation data type
  * you can change it to float, or user defined class (fixed point,etc)
  **/
+#ifdef CNN_USE_FIXED_POINT
+typedef fixed_point<CNN_FIXED_INT_BITS, CNN_FIXED_FRAC_BITS,
+                    fixed_rounding::CNN_FIXED_ROUNDING, fixed_overflow::CNN_FIXED_OVERFLOW> float_t;
+#else
 typedef float float_t;
+#endif
 
 /**
  * size of layer, model, data etc.
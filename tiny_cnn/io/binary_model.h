@@ -0,0 +1,389 @@
+/******************************************************************************
+ *  Copyright (c) 2016, Xilinx, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  1.  Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *  2.  Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *  3.  Neither the name of the copyright holder nor the names of its
+ *      contributors may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ *  OR BUSINESS INTERRUPTION). HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ *  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ *  ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *****************************************************************************/
+#pragma once
+
+// binary_model -- versioned binary container for the weights of a network,
+// laid out so that a file can be mapped into memory and read without parsing.
+//
+//   file_header                     64 bytes
+//   layer_section[layer_count]      128 bytes each, one per layer (input layer included)
+//   per layer with parameters or state, starting on a page boundary:
+//     weights, then biases, each 64-byte aligned like vec_t
+//     state table (state_entry[state_count]), then the arrays of
+//     layer_base::state(), each 64-byte aligned
+//
+// values are stored as raw float_t, integers in the byte order of the writer
+// (checked through byte_order). the checksum covers everything after the
+// file header.
+//
+// load() maps the file read-only, checks it, and copies every array into
+// its layer with one memcpy: the values are bit-exact and no text is parsed.
+// version 1 files have no state and still load into layers without any.
+// the layers keep their own storage (a std::vector cannot take over memory
+// it did not allocate), so each process holds one private copy of the weights.
+
+#include "tiny_cnn/util/util.h"
+#include "tiny_cnn/layers/layer.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#if defined(_WIN32)
+#include <iterator>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace tiny_cnn {
+namespace binary_model {
+
+const char file_magic[8] = { 'T', 'C', 'N', 'N', 'M', 'O', 'D', 'L' };
+const uint32_t file_version = 2;
+const uint32_t byte_order_mark = 0x01020304;
+const uint64_t section_alignment = 4096;
+const uint64_t array_alignment = 64;
+
+enum value_kind : uint32_t {
+    kind_float = 0,
+    kind_double = 1,
+    kind_other = 2 // e.g. fixed_point, only readable by the same build
+};
+
+struct file_header {
+    char     magic[8];
+    uint32_t version;
+    uint32_t header_size;   ///< sizeof(file_header)
+    uint32_t section_size;  ///< sizeof(layer_section)
+    uint32_t value_size;    ///< sizeof(float_t)
+    uint32_t value_kind;
+    uint32_t byte_order;
+    uint32_t layer_count;
+    uint32_t reserved0;
+    uint64_t file_size;
+    uint64_t checksum;
+    uint8_t  reserved[8];
+};
+
+struct layer_section {
+    char     type[32];      ///< layer_type(), zero padded
+    uint32_t in_shape[3];   ///< width, height, depth
+    uint32_t out_shape[3];
+    uint64_t weight_offset; ///< from the start of the file, 0 if there are none
+    uint64_t weight_count;
+    uint64_t bias_offset;
+    uint64_t bias_count;
+    uint64_t state_offset;  ///< table of state_entry, 0 if there is no state
+    uint32_t state_count;
+    uint32_t reserved0;
+    uint8_t  reserved[24];
+};
+
+struct state_entry {
+    uint64_t offset;        ///< from the start of the file
+    uint64_t bytes;
+};
+
+static_assert(sizeof(file_header) == 64, "file_header must stay 64 bytes");
+static_assert(sizeof(layer_section) == 128, "layer_section must stay 128 bytes");
+static_assert(sizeof(state_entry) == 16, "state_entry must stay 16 bytes");
+
+inline uint32_t float_kind() {
+    return std::is_same<float_t, float>::value ? kind_float :
+           std::is_same<float_t, double>::value ? kind_double : kind_other;
+}
+
+inline uint64_t round_up(uint64_t n, uint64_t alignment) {
+    return (n + alignment - 1) / alignment * alignment;
+}
+
+// FNV-1a over 64-bit words, then over the remaining bytes
+inline uint64_t checksum(const void* data, size_t bytes) {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    const uint64_t prime = 0x100000001b3ULL;
+    uint64_t h = 0xcbf29ce484222325ULL;
+    size_t i = 0;
+
+    for (; i + 8 <= bytes; i += 8) {
+        uint64_t w;
+        std::memcpy(&w, p + i, 8);
+        h = (h ^ w) * prime;
+    }
+    for (; i < bytes; i++) h = (h ^ p[i]) * prime;
+    return h ^ (h >> 32);
+}
+
+inline void set_shape(uint32_t* dst, const index3d<cnn_size_t>& s) {
+    dst[0] = static_cast<uint32_t>(s.width_);
+    dst[1] = static_cast<uint32_t>(s.height_);
+    dst[2] = static_cast<uint32_t>(s.depth_);
+}
+
+inline bool same_shape(const uint32_t* stored, const index3d<cnn_size_t>& s) {
+    uint32_t expected[3];
+    set_shape(expected, s);
+    return std::equal(expected, expected + 3, stored);
+}
+
+/**
+ * write the weights of the given layers (in network order, input layer
+ * first) as a binary model
+ **/
+inline void write(std::ostream& os, const std::vector<layer_base*>& layers) {
+    const size_t n = layers.size();
+    std::vector<layer_section> sections(n);
+    std::vector<std::vector<std::vector<uint8_t>>> states(n);
+    std::vector<std::vector<state_entry>> entries(n);
+    uint64_t offset = sizeof(file_header) + n * sizeof(layer_section);
+
+    for (size_t i = 0; i < n; i++) {
+        layer_base* l = layers[i];
+        if (l->is_exploded()) throw nn_error("failed to save weights because of infinite weight");
+
+        layer_section& s = sections[i];
+        std::memset(&s, 0, sizeof(s));
+        const std::string type = l->layer_type();
+        std::memcpy(s.type, type.c_str(), std::min(type.size(), sizeof(s.type) - 1));
+        set_shape(s.in_shape, l->in_shape());
+        set_shape(s.out_shape, l->out_shape());
+        s.weight_count = l->weight().size();
+        s.bias_count = l->bias().size();
+        states[i] = l->state();
+        s.state_count = static_cast<uint32_t>(states[i].size());
+
+        if (s.weight_count + s.bias_count + s.state_count == 0) continue;
+
+        offset = round_up(offset, section_alignment);
+        s.weight_offset = offset;
+        offset = round_up(offset + s.weight_count * sizeof(float_t), array_alignment);
+        s.bias_offset = offset;
+        offset += s.bias_count * sizeof(float_t);
+
+        if (s.state_count == 0) continue;
+
+        s.state_offset = round_up(offset, array_alignment);
+        offset = s.state_offset + s.state_count * sizeof(state_entry);
+        for (const auto& array : states[i]) {
+            state_entry e;
+            e.offset = round_up(offset, array_alignment);
+            e.bytes = array.size();
+            entries[i].push_back(e);
+            offset = e.offset + e.bytes;
+        }
+    }
+
+    file_header h;
+    std::memset(&h, 0, sizeof(h));
+    std::memcpy(h.magic, file_magic, sizeof(h.magic));
+    h.version = file_version;
+    h.header_size = sizeof(file_header);
+    h.section_size = sizeof(layer_section);
+    h.value_size = sizeof(float_t);
+    h.value_kind = float_kind();
+    h.byte_order = byte_order_mark;
+    h.layer_count = static_cast<uint32_t>(n);
+    h.file_size = round_up(offset, array_alignment);
+
+    std::vector<char> buf(static_cast<size_t>(h.file_size), 0);
+    if (n) std::memcpy(&buf[sizeof(file_header)], &sections[0], n * sizeof(layer_section));
+    for (size_t i = 0; i < n; i++) {
+        const layer_section& s = sections[i];
+        if (s.weight_count) std::memcpy(&buf[s.weight_offset], &layers[i]->weight()[0], s.weight_count * sizeof(float_t));
+        if (s.bias_count) std::memcpy(&buf[s.bias_offset], &layers[i]->bias()[0], s.bias_count * sizeof(float_t));
+        if (s.state_count) std::memcpy(&buf[s.state_offset], &entries[i][0], s.state_count * sizeof(state_entry));
+        for (size_t k = 0; k < states[i].size(); k++) {
+            if (!states[i][k].empty())
+                std::memcpy(&buf[entries[i][k].offset], &states[i][k][0], states[i][k].size());
+        }
+    }
+    h.checksum = checksum(&buf[sizeof(file_header)], buf.size() - sizeof(file_header));
+    std::memcpy(&buf[0], &h, sizeof(h));
+
+    os.write(&buf[0], static_cast<std::streamsize>(buf.size()));
+    if (!os) throw nn_error("failed to write binary model");
+}
+
+/**
+ * read-only mapping of a whole file (a page aligned copy where mmap is not
+ * available)
+ **/
+class mapped_file {
+public:
+    explicit mapped_file(const std::string& path) : data_(nullptr), size_(0) {
+#if defined(_WIN32)
+        std::ifstream ifs(path.c_str(), std::ios::binary);
+        if (!ifs) throw nn_error("failed to open " + path);
+        std::vector<char> content((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+        size_ = content.size();
+        if (size_ == 0) throw nn_error("empty model file: " + path);
+        copy_.assign(content.begin(), content.end());
+        data_ = &copy_[0];
+#else
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) throw nn_error("failed to open " + path);
+        struct stat st;
+        if (::fstat(fd, &st) != 0 || st.st_size <= 0) {
+            ::close(fd);
+            throw nn_error("empty model file: " + path);
+        }
+        size_ = static_cast<size_t>(st.st_size);
+        void* p = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED) throw nn_error("failed to map " + path);
+        data_ = static_cast<char*>(p);
+#endif
+    }
+
+    ~mapped_file() {
+#if !defined(_WIN32)
+        if (data_) ::munmap(data_, size_);
+#endif
+    }
+
+    mapped_file(const mapped_file&) = delete;
+    mapped_file& operator = (const mapped_file&) = delete;
+
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+    char* data_;
+    size_t size_;
+#if defined(_WIN32)
+    std::vector<char, aligned_allocator<char, section_alignment>> copy_;
+#endif
+};
+
+/**
+ * map a binary model and copy its weights, biases and layer state into the
+ * given layers. the file must describe the same architecture: layer types,
+ * shapes, parameter counts and state sizes are checked before any layer is
+ * touched
+ **/
+inline void load(const std::string& path, const std::vector<layer_base*>& layers, bool verify_checksum = true) {
+    const mapped_file file(path);
+    const char* base = file.data();
+    const size_t size = file.size();
+
+    file_header h;
+    if (size < sizeof(h)) throw nn_error("not a binary model: " + path);
+    std::memcpy(&h, base, sizeof(h));
+
+    if (std::memcmp(h.magic, file_magic, sizeof(file_magic)) != 0)
+        throw nn_error("not a binary model: " + path);
+    if (h.version == 0 || h.version > file_version)
+        throw nn_error("unsupported binary model version " + std::to_string(h.version));
+    if (h.byte_order != byte_order_mark)
+        throw nn_error("binary model was written with a different byte order");
+    if (h.header_size != sizeof(file_header) || h.section_size != sizeof(layer_section))
+        throw nn_error("corrupted binary model header");
+    if (h.value_size != sizeof(float_t) || h.value_kind != float_kind())
+        throw nn_error("binary model was written with a different float_t");
+    if (h.file_size != size)
+        throw nn_error("binary model is truncated");
+    if (h.layer_count != layers.size())
+        throw nn_error("binary model has " + std::to_string(h.layer_count) +
+                       " layers, the network " + std::to_string(layers.size()));
+    if (sizeof(file_header) + h.layer_count * sizeof(layer_section) > size)
+        throw nn_error("corrupted binary model header");
+    if (verify_checksum && checksum(base + sizeof(file_header), size - sizeof(file_header)) != h.checksum)
+        throw nn_error("binary model checksum mismatch");
+
+    std::vector<layer_section> sections(layers.size());
+    if (!sections.empty())
+        std::memcpy(&sections[0], base + sizeof(file_header), sections.size() * sizeof(layer_section));
+
+    auto in_file = [&](uint64_t offset, uint64_t count, uint64_t value_size) {
+        return count == 0 ||
+            (offset % array_alignment == 0 && offset <= size && count <= (size - offset) / value_size);
+    };
+
+    std::vector<std::vector<state_entry>> entries(layers.size());
+
+    for (size_t i = 0; i < layers.size(); i++) {
+        const layer_section& s = sections[i];
+        layer_base* l = layers[i];
+        const std::string where = "layer " + std::to_string(i) + " (" + l->layer_type() + ")";
+
+        if (std::string(s.type, strnlen(s.type, sizeof(s.type))) != l->layer_type().substr(0, sizeof(s.type) - 1))
+            throw nn_error("binary model: " + where + " is stored as " + std::string(s.type, strnlen(s.type, sizeof(s.type))));
+        if (!same_shape(s.in_shape, l->in_shape()) || !same_shape(s.out_shape, l->out_shape()))
+            throw nn_error("binary model: shape mismatch at " + where);
+        if (s.weight_count != l->weight().size() || s.bias_count != l->bias().size())
+            throw nn_error("binary model: parameter count mismatch at " + where);
+        if (!in_file(s.weight_offset, s.weight_count, sizeof(float_t)) || !in_file(s.bias_offset, s.bias_count, sizeof(float_t)))
+            throw nn_error("binary model: corrupted section of " + where);
+
+        const std::vector<std::vector<uint8_t>> expected = l->state();
+        if (s.state_count != expected.size())
+            throw nn_error("binary model: state mismatch at " + where);
+        if (!in_file(s.state_offset, s.state_count, sizeof(state_entry)))
+            throw nn_error("binary model: corrupted section of " + where);
+        entries[i].resize(s.state_count);
+        if (s.state_count)
+            std::memcpy(&entries[i][0], base + s.state_offset, s.state_count * sizeof(state_entry));
+        for (size_t k = 0; k < expected.size(); k++) {
+            const state_entry& e = entries[i][k];
+            if (e.bytes != expected[k].size())
+                throw nn_error("binary model: state mismatch at " + where);
+            if (!in_file(e.offset, e.bytes, 1))
+                throw nn_error("binary model: corrupted section of " + where);
+        }
+    }
+
+    for (size_t i = 0; i < layers.size(); i++) {
+        const layer_section& s = sections[i];
+        if (s.weight_count + s.bias_count != 0)
+            layers[i]->set_parameters(reinterpret_cast<const float_t*>(base + s.weight_offset),
+                                      reinterpret_cast<const float_t*>(base + s.bias_offset));
+
+        // after set_parameters, so that the stored state wins over whatever
+        // post_update derived from the weights
+        if (s.state_count == 0) continue;
+        std::vector<std::vector<uint8_t>> state;
+        for (const state_entry& e : entries[i]) {
+            const uint8_t* p = reinterpret_cast<const uint8_t*>(base + e.offset);
+            state.emplace_back(p, p + e.bytes);
+        }
+        layers[i]->set_state(state);
+    }
+}
+
+} // namespace binary_model
+} // namespace tiny_cnn
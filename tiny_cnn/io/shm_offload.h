@@ -0,0 +1,530 @@
+/******************************************************************************
+ *  Copyright (c) 2016, Xilinx, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  1.  Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *  2.  Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *  3.  Neither the name of the copyright holder nor the names of its
+ *      contributors may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ *  OR BUSINESS INTERRUPTION). HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ *  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ *  ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *****************************************************************************/
+#pragma once
+
+// shm_offload -- shared memory transport between offloaded_layer and a local
+// "accelerator service" process (see examples/offload_service).
+//
+// the service creates a POSIX shared memory object holding a bounded ring of
+// request slots, the host attaches to it and installs shm_offload::handler as
+// the OffloadHandler of its offloaded_layers. every call claims a slot, copies
+// its input in and waits until the service has written the output back.
+// neither side takes a lock: ownership of a slot is passed around through a
+// per-slot sequence number (bounded queue after D. Vyukov), so several host
+// threads can keep multiple requests in flight at the same time.
+//
+// POSIX only.
+
+#include "tiny_cnn/util/util.h"
+#include "tiny_cnn/layers/offloaded_layer.h"
+#include "tiny_cnn/layers/bnn_conv_layer.h"
+#include "tiny_cnn/layers/bnn_fc_layer.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <map>
+#include <memory>
+#include <functional>
+#include <fstream>
+#include <cerrno>
+#include <cstring>
+#include <cstdint>
+
+namespace tiny_cnn {
+namespace shm_offload {
+
+const uint32_t ring_magic = 0x4f464c44; // "OFLD"
+const uint32_t ring_version = 1;
+
+enum call_status : uint32_t {
+    status_ok = 0,
+    status_size_mismatch = 1,
+    status_no_layer = 2,
+    status_failed = 3,
+    status_too_large = 4    // in_size or out_size above the slot capacity
+};
+
+// per-call description of the offloaded work, written by the host
+struct request {
+    uint32_t offload_id;
+    uint32_t target_set;
+    uint32_t has_conv_params;
+    uint32_t status;            // written back by the service
+    OffloadConvParams conv_params;
+    uint64_t in_size;
+    uint64_t out_size;
+};
+
+// seq == pos     : free, may be claimed by the host for position pos
+// seq == pos + 1 : request published, waiting for the service
+// seq == pos + 2 : response published, waiting for the host to pick it up
+struct alignas(64) slot {
+    std::atomic<uint64_t> seq;
+    request req;
+};
+
+struct ring_header {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t num_slots;
+    uint64_t capacity;          // max elements of the in/out buffers of a slot
+    uint64_t region_size;
+    alignas(64) std::atomic<uint64_t> head;     // next position claimed by the host
+    alignas(64) std::atomic<uint64_t> tail;     // next position served by the service
+    alignas(64) std::atomic<uint32_t> shutdown;
+};
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "shm_offload requires lock-free 64bit atomics");
+
+// spin for a while, then give the core away
+inline void backoff(unsigned int& spins) {
+    if (++spins < 1024) return;
+    std::this_thread::yield();
+}
+
+/**
+ * a mapped shared memory ring.
+ * the creating side (service) owns the object name and unlinks it on
+ * destruction, unless another service has replaced it in the meantime
+ **/
+class ring {
+public:
+    ring(const ring&) = delete;
+    ring& operator = (const ring&) = delete;
+
+    ~ring() {
+        if (base_) ::munmap(base_, size_);
+        if (owner_ && still_named()) ::shm_unlink(name_.c_str());
+    }
+
+    /**
+     * create the object name. fails if it exists (a running service, or the
+     * leftover of one that crashed) unless replace is set: then the clients
+     * of the previous service are detached from it without notice
+     **/
+    static std::unique_ptr<ring> create(const std::string& name, uint64_t num_slots, uint64_t capacity,
+                                        bool replace = false) {
+        if (num_slots < 4)
+            throw nn_error("shm_offload: at least 4 slots are required");
+
+        uint64_t size = data_offset(num_slots) + num_slots * 2 * capacity * sizeof(float_t);
+
+        if (replace) ::shm_unlink(name.c_str());
+        int fd = ::shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+        if (fd < 0 && errno == EEXIST)
+            throw nn_error("shm_offload: shared memory object " + name + " already exists "
+                           "(another service is running, or replace it explicitly)");
+        if (fd < 0)
+            throw nn_error("shm_offload: failed to create shared memory object " + name);
+        if (::ftruncate(fd, static_cast<off_t>(size)) != 0) {
+            ::close(fd);
+            ::shm_unlink(name.c_str());
+            throw nn_error("shm_offload: failed to size shared memory object " + name);
+        }
+
+        std::unique_ptr<ring> r(new ring(name, fd, size, true));
+
+        ring_header* h = new (r->base_) ring_header();
+        h->magic = ring_magic;
+        h->version = ring_version;
+        h->num_slots = num_slots;
+        h->capacity = capacity;
+        h->region_size = size;
+        h->head.store(0);
+        h->tail.store(0);
+        h->shutdown.store(0);
+
+        for (uint64_t i = 0; i < num_slots; i++) {
+            slot* s = new (r->slot_ptr(i)) slot();
+            s->seq.store(i, std::memory_order_release);
+        }
+        return r;
+    }
+
+    static std::unique_ptr<ring> attach(const std::string& name) {
+        int fd = ::shm_open(name.c_str(), O_RDWR, 0600);
+        if (fd < 0)
+            throw nn_error("shm_offload: accelerator service is not running (" + name + ")");
+
+        struct stat st;
+        if (::fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(ring_header)) {
+            ::close(fd);
+            throw nn_error("shm_offload: invalid shared memory object " + name);
+        }
+
+        std::unique_ptr<ring> r(new ring(name, fd, static_cast<size_t>(st.st_size), false));
+        const ring_header* h = r->header();
+        if (h->magic != ring_magic || h->version != ring_version || h->region_size != r->size_)
+            throw nn_error("shm_offload: incompatible accelerator service on " + name);
+        return r;
+    }
+
+    ring_header* header() { return static_cast<ring_header*>(base_); }
+
+    slot& slot_at(uint64_t pos) { return *slot_ptr(pos % header()->num_slots); }
+
+    float_t* input(uint64_t pos) {
+        return data() + (pos % header()->num_slots) * 2 * header()->capacity;
+    }
+
+    float_t* output(uint64_t pos) {
+        return input(pos) + header()->capacity;
+    }
+
+private:
+    ring(const std::string& name, int fd, size_t size, bool owner)
+        : name_(name), base_(nullptr), size_(size), owner_(owner), dev_(0), ino_(0) {
+        struct stat st;
+        if (::fstat(fd, &st) == 0) {
+            dev_ = st.st_dev;
+            ino_ = st.st_ino;
+        }
+        void* p = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED) {
+            if (owner) ::shm_unlink(name.c_str());
+            throw nn_error("shm_offload: failed to map shared memory object " + name);
+        }
+        base_ = p;
+    }
+
+    // whether the name still refers to the object created by this ring
+    bool still_named() const {
+        int fd = ::shm_open(name_.c_str(), O_RDONLY, 0600);
+        if (fd < 0) return false;
+        struct stat st;
+        const bool same = ::fstat(fd, &st) == 0 && st.st_dev == dev_ && st.st_ino == ino_;
+        ::close(fd);
+        return same;
+    }
+
+    static uint64_t slots_offset() {
+        return (sizeof(ring_header) + 63) / 64 * 64;
+    }
+
+    static uint64_t data_offset(uint64_t num_slots) {
+        return slots_offset() + num_slots * sizeof(slot);
+    }
+
+    slot* slot_ptr(uint64_t index) {
+        return reinterpret_cast<slot*>(static_cast<char*>(base_) + slots_offset()) + index;
+    }
+
+    float_t* data() {
+        return reinterpret_cast<float_t*>(static_cast<char*>(base_) + data_offset(header()->num_slots));
+    }
+
+    std::string name_;
+    void* base_;
+    size_t size_;
+    bool owner_;
+    dev_t dev_;
+    ino_t ino_;
+};
+
+/**
+ * host side of the transport. call() is thread-safe, so every worker
+ * running an offloaded_layer may have a request in flight.
+ **/
+class client {
+public:
+    explicit client(const std::string& name) : ring_(ring::attach(name)), calls_(0) {}
+
+    void call(const vec_t& in, vec_t& out, unsigned int offloadID,
+              OffloadConvParams* convParams, unsigned int targetSet = 0) {
+        ring_header* h = ring_->header();
+
+        if (in.size() > h->capacity || out.size() > h->capacity)
+            throw nn_error(format_str("shm_offload: layer %u exceeds slot capacity (%u elements)",
+                                      offloadID, static_cast<unsigned int>(h->capacity)));
+
+        uint64_t pos = claim();
+        slot& s = ring_->slot_at(pos);
+
+        s.req.offload_id = offloadID;
+        s.req.target_set = targetSet;
+        s.req.has_conv_params = convParams ? 1 : 0;
+        if (convParams) s.req.conv_params = *convParams;
+        s.req.status = status_ok;
+        s.req.in_size = in.size();
+        s.req.out_size = out.size();
+        std::memcpy(ring_->input(pos), &in[0], in.size() * sizeof(float_t));
+        s.seq.store(pos + 1, std::memory_order_release);
+
+        unsigned int spins = 0;
+        while (s.seq.load(std::memory_order_acquire) != pos + 2) {
+            if (h->shutdown.load(std::memory_order_relaxed))
+                throw nn_error("shm_offload: accelerator service shut down");
+            backoff(spins);
+        }
+
+        uint32_t status = s.req.status;
+        if (status == status_ok)
+            std::memcpy(&out[0], ring_->output(pos), out.size() * sizeof(float_t));
+
+        // hand the slot over to the request one lap ahead
+        s.seq.store(pos + h->num_slots, std::memory_order_release);
+        calls_.fetch_add(1, std::memory_order_relaxed);
+
+        if (status != status_ok)
+            throw nn_error(format_str("shm_offload: call to layer %u failed (status %u)", offloadID, status));
+    }
+
+    uint64_t calls() const { return calls_.load(); }
+
+private:
+    uint64_t claim() {
+        ring_header* h = ring_->header();
+        unsigned int spins = 0;
+        uint64_t pos = h->head.load(std::memory_order_relaxed);
+
+        for (;;) {
+            uint64_t seq = ring_->slot_at(pos).seq.load(std::memory_order_acquire);
+            int64_t diff = static_cast<int64_t>(seq - pos);
+
+            if (diff == 0) {
+                if (h->head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    return pos;
+            } else if (diff < 0) {
+                // ring is full
+                if (h->shutdown.load(std::memory_order_relaxed))
+                    throw nn_error("shm_offload: accelerator service shut down");
+                backoff(spins);
+                pos = h->head.load(std::memory_order_relaxed);
+            } else {
+                pos = h->head.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    std::unique_ptr<ring> ring_;
+    std::atomic<uint64_t> calls_;
+};
+
+inline std::unique_ptr<client>& default_client() {
+    static std::unique_ptr<client> c;
+    return c;
+}
+
+/**
+ * attach the process-wide client used by shm_offload::handler
+ **/
+inline void attach(const std::string& name) {
+    default_client().reset(new client(name));
+}
+
+#ifdef SOLITAIRE
+inline void handler(const vec_t& in, vec_t& out, unsigned int offloadID,
+                    OffloadConvParams* convParams, unsigned int targetSet) {
+    if (!default_client()) throw nn_error("shm_offload: call attach() first");
+    default_client()->call(in, out, offloadID, convParams, targetSet);
+}
+#else
+inline void handler(const vec_t& in, vec_t& out, unsigned int offloadID, OffloadConvParams* convParams) {
+    if (!default_client()) throw nn_error("shm_offload: call attach() first");
+    default_client()->call(in, out, offloadID, convParams);
+}
+#endif
+
+/**
+ * emulated cost of one accelerator call:
+ * latency_us + (input bytes + output bytes) / bandwidth
+ **/
+struct timing_model {
+    timing_model() : latency_us(0), bandwidth_mbps(0) {}
+    timing_model(double latency, double bandwidth) : latency_us(latency), bandwidth_mbps(bandwidth) {}
+
+    double call_us(uint64_t bytes) const {
+        double t = latency_us;
+        if (bandwidth_mbps > 0) t += double(bytes) / bandwidth_mbps; // 1MB/s == 1byte/us
+        return t;
+    }
+
+    double latency_us;      // fixed per-call overhead (invocation, interrupts etc)
+    double bandwidth_mbps;  // DMA bandwidth in MB/s, 0 for unlimited
+};
+
+// creates the CPU stand-in for a request the service has not seen before
+typedef std::function<std::shared_ptr<layer_base>(const request&)> layer_factory;
+
+/**
+ * stand-in for the accelerator: binarized conv for requests carrying
+ * OffloadConvParams, binarized fully-connected otherwise.
+ * weights are read from <weight_dir>/<offloadID>.bin (same format as
+ * loadFromBinaryFile of the layers) when the file exists.
+ **/
+inline layer_factory bnn_layer_factory(const std::string& weight_dir = "") {
+    return [weight_dir](const request& r) -> std::shared_ptr<layer_base> {
+        std::string file;
+        if (!weight_dir.empty()) {
+            file = weight_dir + "/" + std::to_string(r.offload_id) + ".bin";
+            if (!std::ifstream(file).good()) file = "";
+        }
+
+        if (r.has_conv_params) {
+            const OffloadConvParams& p = r.conv_params;
+            return std::make_shared<bnn_conv_layer>(p.in_width, p.in_height, p.window_size,
+                                                    p.in_channels, p.out_channels, false, file);
+        }
+        return std::make_shared<bnn_fc_layer<activation::identity>>(
+            static_cast<cnn_size_t>(r.in_size), static_cast<cnn_size_t>(r.out_size), false, false, file);
+    };
+}
+
+/**
+ * service side of the transport. serves the ring in order on the calling
+ * thread, like a single accelerator would.
+ **/
+class server {
+public:
+    server(const std::string& name, uint64_t num_slots, uint64_t capacity,
+           const timing_model& timing, layer_factory factory = bnn_layer_factory(), bool replace = false)
+        : ring_(ring::create(name, num_slots, capacity, replace)), timing_(timing), factory_(factory),
+          in_(capacity), calls_(0), bytes_(0), overruns_(0), busy_us_(0) {}
+
+    /**
+     * register the layer executed for (offloadID, targetSet).
+     * layers not registered are created on first use by the factory
+     **/
+    void add_layer(unsigned int offloadID, unsigned int targetSet, std::shared_ptr<layer_base> l) {
+        layers_[key(offloadID, targetSet)] = l;
+    }
+
+    /**
+     * serve requests until shutdown() is called
+     **/
+    void run() {
+        ring_header* h = ring_->header();
+        uint64_t pos = h->tail.load(std::memory_order_relaxed);
+
+        while (!h->shutdown.load(std::memory_order_relaxed)) {
+            slot& s = ring_->slot_at(pos);
+            unsigned int spins = 0;
+            while (s.seq.load(std::memory_order_acquire) != pos + 1) {
+                if (h->shutdown.load(std::memory_order_relaxed)) return;
+                if (spins > 65536)
+                    std::this_thread::sleep_for(std::chrono::microseconds(20));
+                else
+                    backoff(spins);
+            }
+
+            serve(s.req, ring_->input(pos), ring_->output(pos));
+
+            s.seq.store(pos + 2, std::memory_order_release);
+            h->tail.store(++pos, std::memory_order_relaxed);
+        }
+    }
+
+    // may be called from a signal handler
+    void shutdown() { ring_->header()->shutdown.store(1); }
+
+    uint64_t calls() const { return calls_; }
+    uint64_t bytes() const { return bytes_; }
+    uint64_t overruns() const { return overruns_; } ///< calls whose CPU kernel was slower than the emulated time
+    double busy_us() const { return busy_us_; }
+
+private:
+    typedef std::chrono::steady_clock clock;
+
+    static uint64_t key(unsigned int offloadID, unsigned int targetSet) {
+        return (uint64_t(targetSet) << 32) | offloadID;
+    }
+
+    void serve(request& shared, const float_t* in, float_t* out) {
+        // the request lives in memory the other process can write to: validate
+        // a private copy, never the shared one
+        const request r = shared;
+        const clock::time_point start = clock::now();
+        const uint64_t capacity = ring_->header()->capacity;
+
+        if (r.in_size > capacity || r.out_size > capacity) {
+            shared.status = status_too_large;
+            calls_++;
+            return;
+        }
+
+        const uint64_t bytes = (r.in_size + r.out_size) * sizeof(float_t);
+        const clock::time_point deadline = start +
+            std::chrono::duration_cast<clock::duration>(std::chrono::duration<double, std::micro>(timing_.call_us(bytes)));
+
+        shared.status = execute(r, in, out);
+
+        // emulate the accelerator: the call takes as long as the timing model says,
+        // independent of how fast the CPU stand-in computed the result
+        if (clock::now() > deadline) {
+            overruns_++;
+        } else {
+            while (clock::now() < deadline)
+                ;
+        }
+
+        calls_++;
+        bytes_ += bytes;
+        busy_us_ += std::chrono::duration<double, std::micro>(clock::now() - start).count();
+    }
+
+    uint32_t execute(const request& r, const float_t* in, float_t* out) {
+        try {
+            std::shared_ptr<layer_base>& l = layers_[key(r.offload_id, r.target_set)];
+            if (!l) l = factory_(r);
+            if (!l) return status_no_layer;
+            if (l->in_size() != r.in_size || l->out_size() != r.out_size)
+                return status_size_mismatch;
+
+            in_.resize(r.in_size);
+            std::copy(in, in + r.in_size, in_.begin());
+            const vec_t& result = l->forward_propagation(in_, 0);
+            if (result.size() != r.out_size) return status_size_mismatch;
+            std::copy(result.begin(), result.end(), out);
+            return status_ok;
+        } catch (...) {
+            return status_failed;
+        }
+    }
+
+    std::unique_ptr<ring> ring_;
+    timing_model timing_;
+    layer_factory factory_;
+    std::map<uint64_t, std::shared_ptr<layer_base>> layers_;
+    vec_t in_;
+    uint64_t calls_;
+    uint64_t bytes_;
+    uint64_t overruns_;
+    double busy_us_;
+};
+
+} // namespace shm_offload
+} // namespace tiny_cnn
@@ -97,11 +97,9 @@ public:
                 unsigned int pos = ch*dim_ + j;
                 a[pos] = gamma(ch) * (in[pos] - mean(ch)) * invstd(ch) + beta(ch);
             }
-        });
+        }, grainsize_);
 
-        for_i(parallelize_, out_size_, [&](int i) {
-            out[i] = h_.f(a, i);
-        });
+        h_.f(a, out);
         CNN_LOG_VECTOR(out, "[bn]forward");
 
         return next_ ? next_->forward_propagation(out, index) : out;
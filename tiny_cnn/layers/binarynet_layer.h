@@ -78,6 +78,15 @@ public:
         for (auto& thr : Threshold_) is >> thr;
     }
 
+    std::vector<std::vector<uint8_t>> state() const override {
+        return { this->pack_state(Wbin_), this->pack_state(Threshold_) };
+    }
+
+    void set_state(const std::vector<std::vector<uint8_t>>& s) override {
+        this->unpack_state(s.at(0), Wbin_);
+        this->unpack_state(s.at(1), Threshold_);
+    }
+
     size_t connection_size() const override {
         // number of connections/parameters in this layer
         // - one for each synaptic weight
@@ -141,7 +150,8 @@ public:
     }
 
     const vec_t& forward_propagation(const vec_t& in, size_t index) override {
-        std::vector<bool> in_bin(in_size_, false);
+        std::vector<bool>& in_bin = in_bin_[index];
+        in_bin.resize(in_size_);
         // explicitly binarize the input
         float2bipolar(in, in_bin);
         vec_t &a = a_[index];
@@ -149,7 +159,8 @@ public:
 
         if(Offload_ != 0) {
             // call offload hook to perform actual computation
-            std::vector<bool> res(out_size_, false);
+            std::vector<bool>& res = res_[index];
+            res.resize(out_size_);
             Offload_(in_bin, Threshold_, Wbin_, res);
             for(unsigned int i = 0; i < out_size_; i++)
                 out[i] = res[i] == 1 ? +1 : -1;
@@ -165,7 +176,7 @@ public:
                 // compute the activation by comparing against the threshold
                 // (the tiny-cnn specified act.fn. becomes unnecessary)
                 out[i] = a[i] >= Threshold_[i] ? +1 : -1;
-            });
+            }, grainsize_);
         }
 
 
@@ -191,6 +202,8 @@ protected:
     std::vector<bool> Wbin_;
     std::vector<unsigned int> Threshold_;
     BinMatVecMult Offload_;
+    std::vector<bool> in_bin_[CNN_TASK_SIZE]; // binarized input per worker
+    std::vector<bool> res_[CNN_TASK_SIZE];    // offloaded results per worker
 
     // utility function to convert a vector of floats into a vector of bools, where the
     // output boolean represents the sign of the input value (false: negative,
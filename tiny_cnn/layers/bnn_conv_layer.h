@@ -93,6 +93,17 @@ public:
         return out_channels_ * window_size_ * window_size_;
     }
 
+    ///< binarized weights, which are not derived from weight() when loaded from a file
+    virtual std::vector<std::vector<uint8_t>> state() const override
+    {
+        return { pack_state(Wbin_) };
+    }
+
+    virtual void set_state(const std::vector<std::vector<uint8_t>>& s) override
+    {
+        unpack_state(s.at(0), Wbin_);
+    }
+
     ///< number of connections
     virtual size_t connection_size() const override
     {
@@ -101,6 +112,9 @@ public:
 
     std::string layer_type() const override { return "bnn_conv_layer"; }
 
+    index3d<cnn_size_t> in_shape() const override { return index3d<cnn_size_t>(in_width_, in_height_, in_channels_); }
+    index3d<cnn_size_t> out_shape() const override { return index3d<cnn_size_t>(out_width_, out_height_, out_channels_); }
+
     virtual void post_update() override {
         // once the weights have been updated, update the binarized versions too
         float2bipolar(W_, Wbin_);
@@ -113,7 +127,8 @@ public:
     virtual const vec_t& forward_propagation(const vec_t& in_raw, size_t worker_index) override
     {
         // turn the input into a vector of bools
-        std::vector<bool> in_bin(in_raw.size(), false);
+        std::vector<bool>& in_bin = in_bin_[worker_index];
+        in_bin.resize(in_raw.size());
         float2bipolar(in_raw, in_bin);
         vec_t &out = output_[worker_index];
 
@@ -160,6 +175,7 @@ public:
 protected:
     bool usePopcount_;
     std::vector<bool> Wbin_;
+    std::vector<bool> in_bin_[CNN_TASK_SIZE]; // binarized input per worker
     cnn_size_t in_width_;
     cnn_size_t in_height_;
     cnn_size_t window_size_;
@@ -67,6 +67,14 @@ public:
       wf.close();
     }
 
+    std::vector<std::vector<uint8_t>> state() const override {
+        return { this->pack_state(Wbin_) };
+    }
+
+    void set_state(const std::vector<std::vector<uint8_t>>& s) override {
+        this->unpack_state(s.at(0), Wbin_);
+    }
+
     size_t connection_size() const override {
         return size_t(in_size_) * out_size_;
     }
@@ -85,7 +93,8 @@ public:
     }
 
     const vec_t& forward_propagation(const vec_t& in, size_t index) override {
-        std::vector<bool> in_bin(in_size_, false);
+        std::vector<bool>& in_bin = in_bin_[index];
+        in_bin.resize(in_size_);
         // explicitly binarize the input
         float2bipolar(in, in_bin);
         vec_t &a = a_[index];
@@ -104,11 +113,9 @@ public:
                 else
                   a[i]  += (Wbin_[wInd] == in_bin[c]) ? +1 : -1;
             }
-        });
+        }, grainsize_);
 
-        for_i(parallelize_, out_size_, [&](int i) {
-            out[i] = h_.f(a, i);
-        });
+        h_.f(a, out);
         CNN_LOG_VECTOR(out, "[bfc]forward");
 
         return next_ ? next_->forward_propagation(out, index) : out;
@@ -128,6 +135,7 @@ public:
 
 protected:
     std::vector<bool> Wbin_;
+    std::vector<bool> in_bin_[CNN_TASK_SIZE]; // binarized input per worker
     bool usePopcount_, rowMajorWeights_;
 
     // utility function to convert a vector of floats into a vector of bools, where the
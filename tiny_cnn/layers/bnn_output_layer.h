@@ -40,15 +40,12 @@ public:
     const vec_t& forward_propagation(const vec_t& in, size_t index) override {
         vec_t &out = output_[index];
 
-        for(unsigned int ch = 0; ch < channels_; ch++) {
-          for(unsigned int j = 0; j < dim_; j++) {
-              unsigned int pos = ch*dim_ + j;
-              out[pos] = in[pos] - thresholds_[ch];
-
-              if(invertOutput_[ch])
-                  out[pos] = -out[pos];
-          }
-        }
+        for_i(parallelize_, channels_, [&](int ch) {
+            const float_t t = thresholds_[ch], s = sign_[ch];
+            const cnn_size_t base = ch*dim_;
+            for(cnn_size_t j = 0; j < dim_; j++)
+                out[base + j] = s * (in[base + j] - t);
+        }, grainsize_);
 
         return next_ ? next_->forward_propagation(out, index) : out;
     }
@@ -33,6 +33,7 @@
 #include "tiny_cnn/layers/layer.h"
 #include "tiny_cnn/activations/activation_function.h"
 #include "tiny_cnn/util/util.h"
+#include "tiny_cnn/util/product.h"
 #include <vector>
 #include <string>
 #include <iostream>
@@ -46,10 +47,8 @@ public:
     // dim: number of pixels/elements in each channel.
     bnn_threshold_layer(cnn_size_t channels, cnn_size_t dim = 1, std::string binaryParamFile = "")
         : Base(dim*channels, dim*channels, 0, 0), dim_(dim), channels_(channels),
-          thresholds_(channels, 0), invertOutput_(channels, false)
+          thresholds_(channels, float_t(0)), sign_(channels, float_t(1))
     {
-      // TODO re-enable parallelization -- need to support worker index in forward prop
-      set_parallelize(false);
       if(binaryParamFile != "")
         loadFromBinaryFile(binaryParamFile);
     }
@@ -67,17 +66,32 @@ public:
       for(unsigned int line = 0 ; line < channels_; line++) {
         unsigned long long e = 0;
         tf.read((char *)&e, sizeof(unsigned long long));
-        thresholds_[line] = e;
+        thresholds_[line] = float_t(static_cast<long long>(e));
       }
       tf.close();
     }
 
-    std::vector<int> & thresholds() {
+    vec_t & thresholds() {
       return thresholds_;
     }
 
-    std::vector<bool> & invertOutput() {
-      return invertOutput_;
+    // the inversion is kept as the sign (+1/-1) of each channel's output,
+    // so that the forward pass needs no per-element branch
+    void set_invert_output(cnn_size_t channel, bool invert) {
+      sign_[channel] = invert ? float_t(-1) : float_t(1);
+    }
+
+    bool invert_output(cnn_size_t channel) const {
+      return sign_[channel] < float_t(0);
+    }
+
+    std::vector<std::vector<uint8_t>> state() const override {
+        return { pack_state(thresholds_), pack_state(sign_) };
+    }
+
+    void set_state(const std::vector<std::vector<uint8_t>>& s) override {
+        unpack_state(s.at(0), thresholds_);
+        unpack_state(s.at(1), sign_);
     }
 
     size_t connection_size() const override {
@@ -95,19 +109,26 @@ public:
     const vec_t& forward_propagation(const vec_t& in, size_t index) override {
         vec_t &out = output_[index];
 
-        for(unsigned int ch = 0; ch < channels_; ch++) {
-          for(unsigned int j = 0; j < dim_; j++) {
-              unsigned int pos = ch*dim_ + j;
-              out[pos] = (in[pos] > thresholds_[ch] ? +1 : -1);
-
-              if(invertOutput_[ch])
-                  out[pos] = -out[pos];
-          }
-        }
+        for_i(parallelize_, channels_, [&](int ch) {
+            const cnn_size_t pos = ch*dim_;
+            vectorize::threshold_sign(&in[pos], thresholds_[ch], sign_[ch], dim_, &out[pos]);
+        }, grainsize_);
 
         return next_ ? next_->forward_propagation(out, index) : out;
     }
 
+    // same as forward_propagation, but emits the outputs as packed bits
+    // (bit i set means output i is +1) for binarized consumers.
+    // bits must hold (in_size_ + 63) / 64 words
+    void forward_packed(const vec_t& in, uint64_t* bits) const {
+        std::fill(bits, bits + (in_size_ + 63) / 64, uint64_t(0));
+
+        for(cnn_size_t ch = 0; ch < channels_; ch++) {
+            const cnn_size_t pos = ch*dim_;
+            vectorize::threshold_bits(&in[pos], thresholds_[ch], invert_output(ch), dim_, bits, pos);
+        }
+    }
+
     const vec_t& back_propagation(const vec_t& curr_delta, size_t index) override {
         throw "Not yet implemented";
         return curr_delta;
@@ -124,9 +145,8 @@ protected:
     unsigned int dim_;
     unsigned int channels_;
 
-
-    std::vector<int> thresholds_;
-    std::vector<bool> invertOutput_;
+    vec_t thresholds_;
+    vec_t sign_;  // -1 for channels with inverted output, +1 otherwise
 };
 
 } // namespace tiny_cnn
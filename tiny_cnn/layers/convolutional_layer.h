@@ -332,7 +332,7 @@ public:
 
         for_i(parallelize_, in_padded_.size(), [&](int i) {
             (*prev_delta)[i] *= sqr(prev_h.df(prev_out[i]));
-        });
+        }, grainsize_);
 
         if (pad_type_ == padding::same)
             copy_and_unpad_delta(prev_delta2_padded_, prev_delta2_);
@@ -352,43 +352,40 @@ public:
         vec_t &out = output_[worker_index]; // output
         const vec_t &in = *(prev_out_padded_[worker_index]); // input
         
-        std::fill(a.begin(), a.end(), float_t(0));
-
         for_i(parallelize_, out_.depth_, [&](int o) {
-            for (cnn_size_t inc = 0; inc < in_.depth_; inc++) {
-                if (!tbl_.is_connected(o, inc)) continue;
+            float_t *pa = &a[out_.get_index(0, 0, o)];
 
-                const float_t *pw = &this->W_[weight_.get_index(0, 0, in_.depth_ * o + inc)];
-                const float_t *pi = &in[in_padded_.get_index(0, 0, inc)];
-                float_t *pa = &a[out_.get_index(0, 0, o)];
+            for (cnn_size_t y = 0; y < out_.height_; y++) {
+                for (cnn_size_t x = 0; x < out_.width_; x++) {
+                    // per channel sums first, then their total: the same
+                    // order of float operations as a channel-major loop
+                    vectorize::accumulator<float_t> total;
 
-                for (cnn_size_t y = 0; y < out_.height_; y++) {
-                    for (cnn_size_t x = 0; x < out_.width_; x++) {
-                        const float_t * ppw = pw;
-                        const float_t * ppi = pi + (y * h_stride_) * in_padded_.width_ + x * w_stride_;
-                        float_t sum = float_t(0);
+                    for (cnn_size_t inc = 0; inc < in_.depth_; inc++) {
+                        if (!tbl_.is_connected(o, inc)) continue;
+
+                        const float_t * ppw = &this->W_[weight_.get_index(0, 0, in_.depth_ * o + inc)];
+                        const float_t * ppi = &in[in_padded_.get_index(0, 0, inc)] +
+                                              (y * h_stride_) * in_padded_.width_ + x * w_stride_;
+                        vectorize::accumulator<float_t> sum;
 
                         // should be optimized for small kernel(3x3,5x5)
                         for (cnn_size_t wy = 0; wy < weight_.height_; wy++) {
                             for (cnn_size_t wx = 0; wx < weight_.width_; wx++) {
-                                sum += *ppw++ * ppi[wy * in_padded_.width_ + wx];
+                                sum.mac(*ppw++, ppi[wy * in_padded_.width_ + wx]);
                             }
                         }
-                        pa[y * out_.width_ + x] += sum;
+                        total.add(sum);
                     }
+
+                    if (!this->b_.empty())
+                        total.add(this->b_[o]);
+                    pa[y * out_.width_ + x] = total.result();
                 }
             }
+        }, grainsize_);
 
-            if (!this->b_.empty()) {
-                float_t *pa = &a[out_.get_index(0, 0, o)];
-                float_t b = this->b_[o];
-                std::for_each(pa, pa + out_.width_ * out_.height_, [&](float_t& f) { f += b; });
-            }
-        });
-
-        for_i(parallelize_, out_size_, [&](int i) {
-            out[i] = h_.f(a, i);
-        });
+        h_.f(a, out);
 
         CNN_LOG_VECTOR(in_raw, "[pc]in");
         CNN_LOG_VECTOR(W_, "[pc]w");
@@ -412,7 +409,7 @@ public:
         std::fill(prev_delta->begin(), prev_delta->end(), float_t(0));
 
         // propagate delta to previous layer
-        for_i(in_.depth_, [&](int inc) {
+        for_i(parallelize_, in_.depth_, [&](int inc) {
             for (cnn_size_t outc = 0; outc < out_.depth_; outc++) {
                 if (!tbl_.is_connected(outc, inc)) continue;
 
@@ -434,14 +431,12 @@ public:
                     }
                 }
             }
-        });
+        }, grainsize_);
 
-        for_i(parallelize_, in_padded_.size(), [&](int i) {
-            (*prev_delta)[i] *= prev_h.df(prev_out[i]);
-        });
+        prev_h.mul_df(prev_out, *prev_delta);
 
         // accumulate dw
-        for_i(in_.depth_, [&](int inc) {
+        for_i(parallelize_, in_.depth_, [&](int inc) {
             for (cnn_size_t outc = 0; outc < out_.depth_; outc++) {
 
                 if (!tbl_.is_connected(outc, inc)) continue;
@@ -459,7 +454,7 @@ public:
                     }
                 }
             }
-        });
+        }, grainsize_);
 
         // accumulate db
         if (!db.empty()) {
@@ -27,10 +27,32 @@
 #pragma once
 #include "tiny_cnn/util/util.h"
 #include "tiny_cnn/layers/layer.h"
+#include "tiny_cnn/util/product.h"
 #include <algorithm>
+#include <cstdint>
+#include <vector>
 
 namespace tiny_cnn {
 
+namespace detail {
+
+// row b holds 1 for each clear bit of b (kept unit) and 0 for each set bit
+struct dropout_keep_table {
+    dropout_keep_table() {
+        for (int b = 0; b < 256; b++)
+            for (int k = 0; k < 8; k++)
+                keep[b][k] = (b >> k) & 1 ? float_t(0) : float_t(1);
+    }
+    VECTORIZE_ALIGN(32) float_t keep[256][8];
+
+    static const dropout_keep_table& instance() {
+        static const dropout_keep_table t;
+        return t;
+    }
+};
+
+} // namespace detail
+
 // normal 
 class dropout_layer : public layer<activation::identity> {
 public:
@@ -43,8 +65,7 @@ public:
           dropout_rate_(dropout_rate),
           scale_(float_t(1) / (float_t(1) - dropout_rate_))
     {
-        mask_ = new bool[in_size_ * CNN_TASK_SIZE];
-        std::fill(mask_, mask_ + (in_size_ * CNN_TASK_SIZE), false);
+        for (auto& m : mask_) m.assign(mask_words(), 0);
     }
 
     dropout_layer(const dropout_layer& obj)
@@ -53,35 +74,26 @@ public:
           dropout_rate_(obj.dropout_rate_),
           scale_(float_t(1) / (float_t(1) - dropout_rate_))
     {
-        mask_ = new bool[in_size_ * CNN_TASK_SIZE];
-        std::copy(obj.mask_, (obj.mask_ + (in_size_ * CNN_TASK_SIZE)), mask_);
+        std::copy(obj.mask_, obj.mask_ + CNN_TASK_SIZE, mask_);
     }
 
     dropout_layer(dropout_layer&& obj)
         : layer<activation::identity>(obj.in_size_, obj.in_size_, 0, 0),
           phase_(obj.phase_),
           dropout_rate_(obj.dropout_rate_),
-          scale_(float_t(1) / (float_t(1) - dropout_rate_)),
-          mask_(obj.mask_)
-    {
-        obj.mask_ = nullptr;
-    }
-
-    virtual ~dropout_layer()
+          scale_(float_t(1) / (float_t(1) - dropout_rate_))
     {
-        delete[] mask_;
+        for (cnn_size_t i = 0; i < CNN_TASK_SIZE; i++)
+            mask_[i].swap(obj.mask_[i]);
     }
 
     dropout_layer& operator=(const dropout_layer& obj)
     {
-        delete[] mask_;
-
         layer::operator=(obj);
         phase_ = obj.phase_;
         dropout_rate_ = obj.dropout_rate_;
         scale_ = obj.scale_;
-        mask_ = new bool[in_size_ * CNN_TASK_SIZE];
-        std::copy(obj.mask_, (obj.mask_ + (obj.in_size_ * CNN_TASK_SIZE)), mask_);
+        std::copy(obj.mask_, obj.mask_ + CNN_TASK_SIZE, mask_);
         return *this;
     }
 
@@ -91,7 +103,8 @@ public:
         phase_ = obj.phase_;
         dropout_rate_ = obj.dropout_rate_;
         scale_ = obj.scale_;
-        std::swap(mask_, obj.mask_);
+        for (cnn_size_t i = 0; i < CNN_TASK_SIZE; i++)
+            mask_[i].swap(obj.mask_[i]);
         return *this;
     }
 
@@ -128,11 +141,12 @@ public:
     const vec_t& back_propagation(const vec_t& current_delta, size_t worker_index) override 
     {
         vec_t& prev_delta = prev_delta_[worker_index];
-        bool* mask = &mask_[worker_index * CNN_TASK_SIZE];
 
-        for (size_t i = 0; i < current_delta.size(); i++) {
-            prev_delta[i] = mask[i] * current_delta[i];
-        }
+        // d(out)/d(in) is the same mask and scale as in the forward pass
+        if (phase_ == net_phase::train)
+            apply_mask(&current_delta[0], &mask_[worker_index][0], current_delta.size(), scale_, &prev_delta[0]);
+        else
+            std::copy(current_delta.begin(), current_delta.end(), prev_delta.begin());
         return prev_->back_propagation(prev_delta, worker_index);
     }
 
@@ -140,19 +154,16 @@ public:
     {
         vec_t& out = output_[worker_index];
         vec_t& a = a_[worker_index];
-        bool* mask = &mask_[worker_index * CNN_TASK_SIZE];
 
         if (phase_ == net_phase::train) {
-            for (size_t i = 0; i < in.size(); i++)
-                mask[i] = bernoulli(dropout_rate_);
-
-            for (size_t i = 0; i < in.size(); i++)
-                a[i] = out[i] = mask[i] * scale_ * in[i];
+            uint64_t* mask = &mask_[worker_index][0];
+            rng_[worker_index].bernoulli_bits(mask, in.size(), static_cast<double>(dropout_rate_));
+            apply_mask(&in[0], mask, in.size(), scale_, &out[0]);
         }
         else {
-            for (size_t i = 0; i < in.size(); i++)
-                a[i] = out[i] = in[i];
+            std::copy(in.begin(), in.end(), out.begin());
         }
+        std::copy(out.begin(), out.end(), a.begin());
         return next_ ? next_->forward_propagation(out, worker_index) : out;
     }
 
@@ -166,13 +177,38 @@ public:
 
     std::string layer_type() const override { return "dropout"; }
 
-    const bool* get_mask() const { return mask_; }
+    /**
+     * mask of the last training forward pass of a worker, one bit per unit
+     * (bit i % 64 of word i / 64), set for the units that were dropped
+     **/
+    const std::vector<uint64_t>& get_mask(size_t worker_index = 0) const { return mask_[worker_index]; }
+
+    bool is_dropped(size_t unit, size_t worker_index = 0) const {
+        return (mask_[worker_index][unit / 64] >> (unit % 64)) & 1;
+    }
 
 private:
+    size_t mask_words() const { return (in_size_ + 63) / 64; }
+
+    // dst = src * scale for the kept units, 0 for the dropped ones
+    static void apply_mask(const float_t* src, const uint64_t* mask, size_t n, float_t scale, float_t* dst) {
+        const auto& t = detail::dropout_keep_table::instance();
+        size_t i = 0;
+
+        for (; i + 8 <= n; i += 8) {
+            const float_t* keep = t.keep[(mask[i / 64] >> (i % 64)) & 0xff];
+            for (int k = 0; k < 8; k++)
+                dst[i + k] = src[i + k] * scale * keep[k];
+        }
+        for (; i < n; i++)
+            dst[i] = (mask[i / 64] >> (i % 64)) & 1 ? float_t(0) : src[i] * scale;
+    }
+
     net_phase phase_;
     float_t dropout_rate_;
     float_t scale_;
-    bool *mask_;
+    std::vector<uint64_t> mask_[CNN_TASK_SIZE];
+    random_stream rng_[CNN_TASK_SIZE]; // one per worker, masks do not depend on thread scheduling
 };
 
 } // namespace tiny_cnn
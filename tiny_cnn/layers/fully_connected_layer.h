@@ -37,7 +37,7 @@ public:
     CNN_USE_LAYER_MEMBERS;
 
     fully_connected_layer(cnn_size_t in_dim, cnn_size_t out_dim, bool has_bias = true, std::string binaryParamFile = "")
-        : Base(in_dim, out_dim, size_t(in_dim) * out_dim, has_bias ? out_dim : 0), has_bias_(has_bias) {
+        : Base(in_dim, out_dim, size_t(in_dim) * out_dim, has_bias ? out_dim : 0), has_bias_(has_bias), batch_size_(0) {
       if(binaryParamFile != "") {
           loadFromBinaryFile(binaryParamFile);
       }
@@ -81,18 +81,17 @@ public:
         vec_t &out = output_[index];
 
         for_i(parallelize_, out_size_, [&](int i) {
-            a[i] = float_t(0);
+            vectorize::accumulator<float_t> sum;
             for (cnn_size_t c = 0; c < in_size_; c++) {
-                a[i] += W_[c*out_size_ + i] * in[c];
+                sum.mac(W_[c*out_size_ + i], in[c]);
             }
 
             if (has_bias_)
-                a[i] += b_[i];
-        });
+                sum.add(b_[i]);
+            a[i] = sum.result();
+        }, grainsize_);
 
-        for_i(parallelize_, out_size_, [&](int i) {
-            out[i] = h_.f(a, i);
-        });
+        h_.f(a, out);
         CNN_LOG_VECTOR(out, "[fc]forward");
 
         return next_ ? next_->forward_propagation(out, index) : out;
@@ -109,7 +108,15 @@ public:
             // propagate delta to previous layer
             // prev_delta[c] += current_delta[r] * W_[c * out_size_ + r]
             prev_delta[c] = vectorize::dot(&curr_delta[0], &W_[c*out_size_], out_size_);
-            prev_delta[c] *= prev_h.df(prev_out[c]);
+        }
+        prev_h.mul_df(prev_out, prev_delta);
+
+        if (batch_size_ > 0) {
+            // keep the sample, dW is computed for the whole batch in end_batch
+            const cnn_size_t row = batch_row_[index];
+            std::copy(prev_out.begin(), prev_out.end(), &batch_in_[row*in_size_]);
+            std::copy(curr_delta.begin(), curr_delta.end(), &batch_delta_[row*out_size_]);
+            return prev_->back_propagation(prev_delta_[index], index);
         }
 
         for_(parallelize_, 0, size_t(out_size_), [&](const blocked_range& r) {
@@ -122,7 +129,7 @@ public:
                 for (int i = r.begin(); i < r.end(); i++)
                     db[i] += curr_delta[i];
             }
-        });
+        }, grainsize_);
 
         CNN_LOG_VECTOR(curr_delta, "[fc]curr_delta");
         CNN_LOG_VECTOR(prev_delta, "[fc]prev_delta");
@@ -159,10 +166,57 @@ public:
         return prev_->back_propagation_2nd(prev_delta2_);
     }
 
+    void begin_batch(cnn_size_t batch_size) override {
+        batch_size_ = batch_size;
+        batch_in_.resize(size_t(batch_size) * in_size_);
+        batch_delta_.resize(size_t(batch_size) * out_size_);
+    }
+
+    void set_batch_row(cnn_size_t worker_index, cnn_size_t row) override {
+        batch_row_[worker_index] = row;
+    }
+
+    // dW += X^T * D, db += sum of the rows of D, where row s of X / D is the
+    // input / delta of sample s. each row of dW is updated by all samples
+    // while it is in cache, instead of one rank-1 update of dW per sample
+    void end_batch() override {
+        const cnn_size_t n = batch_size_;
+        const cnn_size_t tile = 1024; // columns of D per sweep over dW
+        vec_t& dW = dW_[0];
+        vec_t& db = db_[0];
+
+        if (n == 0) return;
+        batch_size_ = 0;
+
+        for (cnn_size_t j = 0; j < out_size_; j += tile) {
+            const cnn_size_t len = std::min(tile, out_size_ - j);
+
+            for_i(in_size_, [&](int c) {
+                float_t* w = &dW[c*out_size_ + j];
+                for (cnn_size_t s = 0; s < n; s++)
+                    vectorize::muladd(&batch_delta_[s*out_size_ + j], batch_in_[s*in_size_ + c], len, w);
+            }, 1);
+        }
+
+        if (has_bias_) {
+            for (cnn_size_t s = 0; s < n; s++)
+                vectorize::reduce<float_t>(&batch_delta_[s*out_size_], out_size_, &db[0]);
+        }
+
+        CNN_LOG_VECTOR(dW, "[fc]dW-batch");
+        CNN_LOG_VECTOR(db, "[fc]db-batch");
+    }
+
     std::string layer_type() const override { return "fully-connected"; }
 
 protected:
     bool has_bias_;
+
+private:
+    cnn_size_t batch_size_; // samples in the open batch, 0 if none
+    cnn_size_t batch_row_[CNN_TASK_SIZE];
+    vec_t batch_in_;
+    vec_t batch_delta_;
 };
 
 } // namespace tiny_cnn
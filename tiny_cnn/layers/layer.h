@@ -25,11 +25,15 @@
     SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 #pragma once
+#include <cstdint>
+#include <cstring>
 #include <sstream>
 #include <iomanip>
 #include <memory>
+#include <vector>
 #include "tiny_cnn/util/util.h"
 #include "tiny_cnn/util/product.h"
+#include "tiny_cnn/util/parameter_arena.h"
 #include "tiny_cnn/util/image.h"
 #include "tiny_cnn/util/weight_init.h"
 
@@ -46,7 +50,7 @@ public:
     virtual ~layer_base() = default;
 
     layer_base(cnn_size_t in_dim, cnn_size_t out_dim, size_t weight_dim, size_t bias_dim)
-        : parallelize_(true), next_(nullptr), prev_(nullptr),
+        : parallelize_(true), grainsize_(1), next_(nullptr), prev_(nullptr),
           weight_init_(std::make_shared<weight_init::xavier>()),
           bias_init_(std::make_shared<weight_init::constant>(float_t(0))) {
         set_size(in_dim, out_dim, weight_dim, bias_dim);
@@ -67,10 +71,27 @@ public:
         tail->prev_ = this;
     }
 
+    /**
+     * replace the layer that forward_propagation continues with
+     * (nullptr ends the propagation here), returns the previous one
+     **/
+    layer_base* exchange_next(layer_base* next) {
+        std::swap(next, next_);
+        return next;
+    }
+
     void set_parallelize(bool parallelize) {
         parallelize_ = parallelize;
     }
 
+    ///< minimum number of iterations per chunk in the layer's parallel loops
+    void set_grainsize(int grainsize) {
+        grainsize_ = std::max(1, grainsize);
+    }
+
+    bool parallelize() const { return parallelize_; }
+    int grainsize() const { return grainsize_; }
+
     // cannot call from ctor because of pure virtual function call fan_in_size().
     // so should call this function explicitly after ctor
     void init_weight() {
@@ -84,6 +105,33 @@ public:
         clear_diff(CNN_TASK_SIZE);
     }
 
+    /**
+     * place the buffers of the given worker slot (output, deltas and
+     * gradients) on a NUMA node. they move to their own pages, returns
+     * false if they stay where they are
+     **/
+    bool bind_worker_buffers(cnn_size_t worker_index, int node) {
+        return numa_place<float_t, 64>({ &a_[worker_index], &output_[worker_index], &prev_delta_[worker_index],
+                                         &dW_[worker_index], &db_[worker_index] }, node);
+    }
+
+    /**
+     * copy the weights and the per-worker buffers into fresh allocations,
+     * which follow the memory_policy in effect now
+     **/
+    void reallocate_buffers() {
+        auto reallocate = [](vec_t& v) {
+            vec_t fresh(v.begin(), v.end());
+            v.swap(fresh);
+        };
+        for (cnn_size_t i = 0; i < CNN_TASK_SIZE; i++) {
+            for (vec_t* v : { &a_[i], &output_[i], &prev_delta_[i], &dW_[i], &db_[i] })
+                reallocate(*v);
+        }
+        for (vec_t* v : { &W_, &b_, &Whessian_, &bhessian_, &prev_delta2_ })
+            reallocate(*v);
+    }
+
     void divide_hessian(int denominator) {
         for (auto& w : Whessian_) w /= denominator;
         for (auto& b : bhessian_) b /= denominator;
@@ -162,6 +210,26 @@ public:
         for (auto& b : b_) is >> b;
     }
 
+    /**
+     * set the weights and biases from raw arrays of weight().size() and
+     * bias().size() values (e.g. the sections of a mapped model file)
+     **/
+    void set_parameters(const float_t* w, const float_t* b) {
+        std::copy(w, w + W_.size(), W_.begin());
+        std::copy(b, b + b_.size(), b_.begin());
+        post_update();
+    }
+
+    /**
+     * state kept outside weight()/bias() (e.g. binarized weights or
+     * thresholds), one raw byte array per member. the binary model stores
+     * these next to the parameters; set_state receives arrays of the same
+     * count and sizes and is called after set_parameters
+     **/
+    virtual std::vector<std::vector<uint8_t>> state() const { return {}; }
+
+    virtual void set_state(const std::vector<std::vector<uint8_t>>& s) { CNN_UNREFERENCED_PARAMETER(s); }
+
     /////////////////////////////////////////////////////////////////////////
     // visualize
 
@@ -201,6 +269,20 @@ public:
      **/
      virtual void set_context(net_phase ctx) { CNN_UNREFERENCED_PARAMETER(ctx); }
 
+    /**
+     * batched weight gradient. between begin_batch and end_batch a layer may
+     * just record the input and delta of each sample in back_propagation
+     * (its row in the batch is passed to set_batch_row before the sample runs
+     * on that worker), then add the gradient of the whole batch to worker
+     * slot 0 in end_batch. by default the gradient is accumulated per sample
+     **/
+    virtual void begin_batch(cnn_size_t batch_size) { CNN_UNREFERENCED_PARAMETER(batch_size); }
+    virtual void set_batch_row(cnn_size_t worker_index, cnn_size_t row) {
+        CNN_UNREFERENCED_PARAMETER(worker_index);
+        CNN_UNREFERENCED_PARAMETER(row);
+    }
+    virtual void end_batch() {}
+
     template <typename Optimizer>
     void update_weight(Optimizer *o, cnn_size_t worker_size, cnn_size_t batch_size) {
         if (W_.empty()) return;
@@ -216,18 +298,52 @@ public:
         CNN_LOG_VECTOR(W_, "[W-updated]");
         CNN_LOG_VECTOR(b_, "[db-updated]");
 
-        clear_diff(worker_size);
+        // merge has already cleared the other workers
+        clear_diff(1);
         post_update();
     }
 
+    /**
+     * apply the gradient of one worker directly, without merging
+     * (asynchronous / hogwild training), and clear it.
+     * workers call this concurrently, so post_update is not called here;
+     * the network calls it once per layer after the batch
+     **/
+    template <typename Optimizer>
+    void update_weight_async(Optimizer *o, cnn_size_t worker_index) {
+        if (W_.empty()) return;
+
+        o->update_async(dW_[worker_index], W_);
+        o->update_async(db_[worker_index], b_);
+
+        std::fill(dW_[worker_index].begin(), dW_[worker_index].end(), float_t(0));
+        std::fill(db_[worker_index].begin(), db_[worker_index].end(), float_t(0));
+    }
+
+    /**
+     * register W and b (with their gradients) in the flat view used by
+     * optimizers that update all layers at once
+     **/
+    void collect_parameters(parameter_arena& p) {
+        if (W_.empty()) return;
+        p.add(W_, dW_, Whessian_);
+        p.add(b_, db_, bhessian_);
+    }
+
+    template <typename Optimizer>
+    void reserve_optimizer_state(Optimizer *o) const {
+        o->reserve(W_);
+        o->reserve(b_);
+    }
+
     bool has_same_weights(const layer_base& rhs, float_t eps) const {
         if (W_.size() != rhs.W_.size() || b_.size() != rhs.b_.size())
             return false;
 
         for (size_t i = 0; i < W_.size(); i++)
-          if (std::abs(W_[i] - rhs.W_[i]) > eps) return false;
+          if (abs(W_[i] - rhs.W_[i]) > eps) return false;
         for (size_t i = 0; i < b_.size(); i++)
-          if (std::abs(b_[i] - rhs.b_[i]) > eps) return false;
+          if (abs(b_[i] - rhs.b_[i]) > eps) return false;
 
         return true;
     }
@@ -236,6 +352,7 @@ protected:
     cnn_size_t in_size_;
     cnn_size_t out_size_;
     bool parallelize_;
+    int grainsize_;
 
     layer_base* next_;
     layer_base* prev_;
@@ -259,24 +376,62 @@ protected:
     std::shared_ptr<weight_init::function> weight_init_;
     std::shared_ptr<weight_init::function> bias_init_;
 
+    // byte arrays for state()/set_state(), one byte per bool
+    static std::vector<uint8_t> pack_state(const std::vector<bool>& v) {
+        return std::vector<uint8_t>(v.begin(), v.end());
+    }
+
+    template <typename T, typename Alloc>
+    static std::vector<uint8_t> pack_state(const std::vector<T, Alloc>& v) {
+        const uint8_t* p = reinterpret_cast<const uint8_t*>(v.data());
+        return std::vector<uint8_t>(p, p + v.size() * sizeof(T));
+    }
+
+    static void unpack_state(const std::vector<uint8_t>& s, std::vector<bool>& v) {
+        if (s.size() != v.size()) throw nn_error("layer state size mismatch");
+        std::copy(s.begin(), s.end(), v.begin());
+    }
+
+    template <typename T, typename Alloc>
+    static void unpack_state(const std::vector<uint8_t>& s, std::vector<T, Alloc>& v) {
+        if (s.size() != v.size() * sizeof(T)) throw nn_error("layer state size mismatch");
+        if (!s.empty()) std::memcpy(v.data(), s.data(), s.size());
+    }
+
 private:
     /** sums contributions to gradient (of the loss function with respect to weights and
-        bias) as calculated by individual threads */
+        bias) as calculated by individual threads into slot 0, divided by the batch size.
+        the other slots are left cleared */
     void merge(cnn_size_t worker_size, cnn_size_t batch_size) {
-        for (cnn_size_t i = 1; i < worker_size; i++)
-            vectorize::reduce<float_t>(&dW_[i][0],
-                static_cast<cnn_size_t>(dW_[i].size()), &dW_[0][0]);
-        for (cnn_size_t i = 1; i < worker_size; i++)
-            vectorize::reduce<float_t>(&db_[i][0],
-                static_cast<cnn_size_t>(db_[i].size()), &db_[0][0]);
-
-        std::transform(dW_[0].begin(), dW_[0].end(), dW_[0].begin(), [&](float_t x) { return x / batch_size; });
-        std::transform(db_[0].begin(), db_[0].end(), db_[0].begin(), [&](float_t x) { return x / batch_size; });
+        reduce_diff(dW_, worker_size, batch_size);
+        reduce_diff(db_, worker_size, batch_size);
 
         CNN_LOG_VECTOR(dW_[0], "[dW-merged]");
         CNN_LOG_VECTOR(db_[0], "[db-merged]");
     }
 
+    // each thread takes a disjoint slice of the parameters and, while the slice is
+    // in cache, folds all workers into slot 0, clears them and divides by the batch size
+    static void reduce_diff(vec_t* diff, cnn_size_t worker_size, cnn_size_t batch_size) {
+        const size_t n = diff[0].size();
+        const int slice = 2048;
+        if (n == 0) return;
+
+        for_(n >= 2 * slice, 0, n, [&](const blocked_range& r) {
+            const size_t begin = r.begin();
+            const size_t len = r.end() - r.begin();
+            float_t* dst = &diff[0][begin];
+
+            for (cnn_size_t i = 1; i < worker_size; i++) {
+                float_t* src = &diff[i][begin];
+                vectorize::reduce<float_t>(src, len, dst);
+                std::fill(src, src + len, float_t(0));
+            }
+            for (size_t k = 0; k < len; k++)
+                dst[k] /= batch_size;
+        }, slice);
+    }
+
     void clear_diff(size_t worker_size) {
         for (size_t i = 0; i < worker_size; i++) {
             std::fill(dW_[i].begin(), dW_[i].end(), float_t(0));
@@ -26,6 +26,7 @@
 */
 #pragma once
 #include "tiny_cnn/layers/layer.h"
+#include "tiny_cnn/optimizers/optimizer.h"
 #include "input_layer.h"
 
 namespace tiny_cnn {
@@ -68,6 +69,10 @@ public:
         return layers_[index + 1].get();
     }
 
+    std::shared_ptr<layer_base> shared_at(size_t index) const {
+        return layers_[index + 1];
+    }
+
     void init_weight() {
         for (auto pl : layers_)
             pl->init_weight();
@@ -84,12 +89,68 @@ public:
             pl->divide_hessian(denominator);
     }
 
+    /**
+     * merge the gradients of all workers and apply them. optimizers with
+     * update_fused get every parameter of the network in one parallel pass
+     * over a parameter_arena, others are called once per weight vector
+     **/
     template <typename Optimizer>
     void update_weights(Optimizer *o, size_t worker_size, size_t batch_size) {
+        update_weights(o, static_cast<cnn_size_t>(worker_size), static_cast<cnn_size_t>(batch_size),
+                       std::integral_constant<bool, has_fused_update<Optimizer>::value>());
+    }
+
+    void begin_batch(size_t batch_size) {
+        for (auto pl : layers_)
+            pl->begin_batch(static_cast<cnn_size_t>(batch_size));
+    }
+
+    void set_batch_row(size_t worker_index, size_t row) {
+        for (auto pl : layers_)
+            pl->set_batch_row(static_cast<cnn_size_t>(worker_index), static_cast<cnn_size_t>(row));
+    }
+
+    void end_batch() {
+        for (auto pl : layers_)
+            pl->end_batch();
+    }
+
+    template <typename Optimizer>
+    void update_weights_async(Optimizer *o, size_t worker_index) {
         for (auto pl : layers_)
-            pl->update_weight(o, static_cast<cnn_size_t>(worker_size), batch_size);
+            pl->update_weight_async(o, static_cast<cnn_size_t>(worker_index));
+    }
+
+    void post_update() {
+        for (auto pl : layers_)
+            pl->post_update();
+    }
+
+    template <typename Optimizer>
+    void reserve_optimizer_state(Optimizer *o) const {
+        for (auto pl : layers_)
+            pl->reserve_optimizer_state(o);
     }
     
+    /**
+     * place the buffers of each worker slot on the NUMA node of the
+     * thread it is meant for (slot i to thread i % cfg.num_threads,
+     * see thread_config for when that holds)
+     **/
+    void bind_worker_buffers(const thread_config& cfg) {
+        for (cnn_size_t i = 0; i < CNN_TASK_SIZE; i++) {
+            const int node = numa_node_of_cpu(cfg.cpu_of_thread(i % cfg.num_threads));
+            if (node < 0) continue;
+            for (auto pl : layers_)
+                pl->bind_worker_buffers(i, node);
+        }
+    }
+
+    void reallocate_buffers() {
+        for (auto pl : layers_)
+            pl->reallocate_buffers();
+    }
+
     void set_parallelize(bool parallelize) {
         for (auto pl : layers_)
             pl->set_parallelize(parallelize);
@@ -107,7 +168,26 @@ private:
             add(rhs.layers_[i]);
     }
 
+    template <typename Optimizer>
+    void update_weights(Optimizer *o, cnn_size_t worker_size, cnn_size_t batch_size, std::true_type) {
+        // rebuilt every step (no allocation once the capacity is reached),
+        // so the view never refers to resized or removed layers
+        params_.clear();
+        for (auto pl : layers_)
+            pl->collect_parameters(params_);
+
+        o->update_fused(params_, worker_size, batch_size);
+        post_update();
+    }
+
+    template <typename Optimizer>
+    void update_weights(Optimizer *o, cnn_size_t worker_size, cnn_size_t batch_size, std::false_type) {
+        for (auto pl : layers_)
+            pl->update_weight(o, worker_size, batch_size);
+    }
+
     std::vector<std::shared_ptr<layer_base>> layers_;
+    parameter_arena params_;
 };
 
 } // namespace tiny_cnn
@@ -71,10 +71,8 @@ public:
 
         for_i(parallelize_, out_size_, [&](int i) {
             a[i] = scale_ * in[i] + bias_;
-        });
-        for_i(parallelize_, out_size_, [&](int i) {
-            out[i] = h_.f(a, i);
-        });
+        }, grainsize_);
+        h_.f(a, out);
 
         return next_ ? next_->forward_propagation(out, index) : out;
     }
@@ -85,8 +83,9 @@ public:
         vec_t& prev_delta = prev_delta_[index];
 
         for_i(parallelize_, out_size_, [&](int i) {
-            prev_delta[i] = current_delta[i] * scale_ * prev_h.df(prev_out[i]);
-        });
+            prev_delta[i] = current_delta[i] * scale_;
+        }, grainsize_);
+        prev_h.mul_df(prev_out, prev_delta);
 
         return prev_->back_propagation(prev_delta_[index], index);
     }
@@ -97,7 +96,7 @@ public:
 
         for_i(parallelize_, out_size_, [&](int i) {
             prev_delta2_[i] = current_delta2[i] * sqr(scale_ * prev_h.df(prev_out[i]));
-        });
+        }, grainsize_);
 
         return prev_->back_propagation_2nd(prev_delta2_);
     }
@@ -26,6 +26,7 @@
 */
 #pragma once
 #include "tiny_cnn/util/util.h"
+#include "tiny_cnn/util/scratch_arena.h"
 #include <algorithm>
 
 namespace tiny_cnn {
@@ -48,7 +49,7 @@ public:
     lrn_layer(cnn_size_t in_width, cnn_size_t in_height, cnn_size_t local_size, cnn_size_t in_channels,
                        float_t alpha, float_t beta, norm_region region = norm_region::across_channels)
         : Base(in_width*in_height*in_channels, in_width*in_height*in_channels, 0, 0),
-        in_shape_(in_width, in_height, in_channels), size_(local_size), alpha_(alpha), beta_(beta), region_(region), in_square_(in_shape_.area()) {}
+        in_shape_(in_width, in_height, in_channels), size_(local_size), alpha_(alpha), beta_(beta), region_(region) {}
 
     size_t param_size() const override {
         return 0;
@@ -79,9 +80,7 @@ public:
             forward_within(in, a);
         }
 
-        for_i(parallelize_, out_size_, [&](int i) {
-            out[i] = h_.f(a, i);
-        });
+        h_.f(a, out);
         return next_ ? next_->forward_propagation(out, index) : out;
     }
 
@@ -98,11 +97,14 @@ public:
 
 private:
     void forward_across(const vec_t& in, vec_t& out) {
-        std::fill(in_square_.begin(), in_square_.end(), float_t(0));
+        // running sum of squares over the window, private to this thread
+        scratch_scope scratch;
+        float_t* in_square = scratch.allocate<float_t>(in_shape_.area());
+        std::fill(in_square, in_square + in_shape_.area(), float_t(0));
 
         for (cnn_size_t i = 0; i < size_ / 2; i++) {
             cnn_size_t idx = in_shape_.get_index(0, 0, i);
-            add_square_sum(&in[idx], in_shape_.area(), &in_square_[0]);
+            add_square_sum(&in[idx], in_shape_.area(), in_square);
         }
 
         cnn_size_t head = size_ / 2;
@@ -113,15 +115,15 @@ private:
 
         for (cnn_size_t i = 0; i < channels; i++, head++, tail++) {
             if (head < channels)
-                add_square_sum(&in[in_shape_.get_index(0, 0, head)], wxh, &in_square_[0]);
+                add_square_sum(&in[in_shape_.get_index(0, 0, head)], wxh, in_square);
 
             if (tail >= 0)
-                sub_square_sum(&in[in_shape_.get_index(0, 0, tail)], wxh, &in_square_[0]);
+                sub_square_sum(&in[in_shape_.get_index(0, 0, tail)], wxh, in_square);
 
             float_t *dst = &out[in_shape_.get_index(0, 0, i)];
             const float_t *src = &in[in_shape_.get_index(0, 0, i)];
             for (cnn_size_t j = 0; j < wxh; j++)
-                dst[j] = src[j] * std::pow(float_t(1) + alpha_div_size * in_square_[j], -beta_);
+                dst[j] = src[j] * pow(float_t(1) + alpha_div_size * in_square[j], -beta_);
         }
     }
 
@@ -146,8 +148,6 @@ private:
     cnn_size_t size_;
     float_t alpha_, beta_;
     norm_region region_;
-
-    vec_t in_square_;
 };
 
 } // namespace tiny_cnn
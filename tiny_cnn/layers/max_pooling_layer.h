@@ -97,11 +97,9 @@ public:
                 }
                 a[i] = max_value;
             }
-        });
+        }, grainsize_);
 
-        for_i(parallelize_, out_size_, [&](int i) {
-            out[i] = h_.f(a, i);
-        });
+        h_.f(a, out);
 
         CNN_LOG_VECTOR(out, "[maxp]fwd");
         return next_ ? next_->forward_propagation(out, index) : out;
@@ -116,9 +114,10 @@ public:
         for_(parallelize_, 0, size_t(in_size_), [&](const blocked_range& r) {
             for (int i = r.begin(); i != r.end(); i++) {
                 cnn_size_t outi = in2out_[i];
-                prev_delta[i] = (max_idx[outi] == i) ? current_delta[outi] * prev_h.df(prev_out[i]) : float_t(0);
+                prev_delta[i] = (max_idx[outi] == i) ? current_delta[outi] : float_t(0);
             }
-        });
+        }, grainsize_);
+        prev_h.mul_df(prev_out, prev_delta);
         return prev_->back_propagation(prev_delta_[index], index);
     }
 
@@ -84,6 +84,12 @@ public:
 
     std::string layer_type() const override { return "offloaded"; }
 
+    // pass a copy of p, owned by this layer (and its copies), to the handler
+    void set_conv_params(const OffloadConvParams& p) {
+        ownConvParams_ = p;
+        hasOwnConvParams_ = true;
+    }
+
     size_t param_size() const override {
         return 0;
     }
@@ -104,9 +110,9 @@ public:
     const vec_t& forward_propagation(const vec_t& in, size_t index) override {
         vec_t & out = output_[index];
 #ifdef SOLITAIRE
-        offloadHandler_(in, out, offloadID_, offloadConvParams_, targetSet_);
+        offloadHandler_(in, out, offloadID_, conv_params(), targetSet_);
 #else
-	offloadHandler_(in, out, offloadID_, offloadConvParams_);
+	offloadHandler_(in, out, offloadID_, conv_params());
 #endif
         return next_ ? next_->forward_propagation(out, index) : out;
     }
@@ -123,8 +129,15 @@ public:
     }
 
 protected:
+    // resolved at call time, so that copies of the layer use their own params
+    OffloadConvParams * conv_params() {
+        return hasOwnConvParams_ ? &ownConvParams_ : offloadConvParams_;
+    }
+
     OffloadHandler offloadHandler_;
     OffloadConvParams * offloadConvParams_;
+    OffloadConvParams ownConvParams_;
+    bool hasOwnConvParams_ = false;
     unsigned int offloadID_;
 #ifdef SOLITAIRE
     unsigned int targetSet_;
@@ -95,11 +95,9 @@ public:
 
             a[i] *= scale_factor_;
             a[i] += b_[out2bias_[i]];
-        });
+        }, grainsize_);
 
-        for_i(parallelize_, out_size_, [&](int i) {
-            output_[index][i] = h_.f(a, i);
-        });
+        h_.f(a, output_[index]);
         CNN_LOG_VECTOR(in, "[pc]in");
         CNN_LOG_VECTOR(W_, "[pc]w");
         CNN_LOG_VECTOR(a, "[pc]a");
@@ -121,9 +119,10 @@ public:
                 for (auto connection : connections) 
                     delta += W_[connection.first] * current_delta[connection.second]; // 40.6%
 
-                prev_delta[i] = delta * scale_factor_ * prev_h.df(prev_out[i]); // 2.1%
+                prev_delta[i] = delta * scale_factor_;
             }
-        });
+        }, grainsize_);
+        prev_h.mul_df(prev_out, prev_delta);
 
         for_(parallelize_, 0, weight2io_.size(), [&](const blocked_range& r) {
             for (int i = r.begin(); i < r.end(); i++) {
@@ -135,7 +134,7 @@ public:
 
                 dW_[index][i] += diff * scale_factor_;
             }
-        });
+        }, grainsize_);
 
         for (size_t i = 0; i < bias2out_.size(); i++) {
             const std::vector<cnn_size_t>& outs = bias2out_[i];
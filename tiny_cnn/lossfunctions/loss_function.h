@@ -45,7 +45,7 @@ public:
 class cross_entropy {
 public:
     static float_t f(float_t y, float_t t) {
-        return -t * std::log(y) - (float_t(1) - t) * std::log(float_t(1) - y);
+        return -t * log(y) - (float_t(1) - t) * log(float_t(1) - y);
     }
 
     static float_t df(float_t y, float_t t) {
@@ -57,7 +57,7 @@ public:
 class cross_entropy_multiclass {
 public:
     static float_t f(float_t y, float_t t) {
-        return -t * std::log(y);
+        return -t * log(y);
     }
 
     static float_t df(float_t y, float_t t) {
@@ -65,14 +65,20 @@ public:
     }
 };
 
+// grad[i] = dE/dy[i], written into a vector of the same size as y
 template <typename E>
-vec_t gradient(const vec_t& y, const vec_t& t) {
-    vec_t grad(y.size());
+void gradient(const vec_t& y, const vec_t& t, vec_t& grad) {
     assert(y.size() == t.size());
+    assert(grad.size() == y.size());
 
     for (cnn_size_t i = 0; i < y.size(); i++)
         grad[i] = E::df(y[i], t[i]);
+}
 
+template <typename E>
+vec_t gradient(const vec_t& y, const vec_t& t) {
+    vec_t grad(y.size());
+    gradient<E>(y, t, grad);
     return grad;
 }
 
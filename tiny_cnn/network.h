@@ -26,6 +26,7 @@
 */
 #pragma once
 #include <iostream>
+#include <fstream>
 #include <stdexcept>
 #include <algorithm>
 #include <iterator>
@@ -35,8 +36,13 @@
 
 #include "tiny_cnn/util/util.h"
 #include "tiny_cnn/layers/layers.h"
+#include "tiny_cnn/util/parallel_scheduler.h"
+#include "tiny_cnn/util/data_loader.h"
+#include "tiny_cnn/util/scratch_arena.h"
+#include "tiny_cnn/io/binary_model.h"
 #include "tiny_cnn/lossfunctions/loss_function.h"
 #include "tiny_cnn/activations/activation_function.h"
+#include "tiny_cnn/optimizers/optimizer.h"
 
 namespace tiny_cnn {
 
@@ -85,6 +91,14 @@ struct result {
     std::map<label_t, std::map<label_t, int> > confusion_matrix;
 };
 
+/**
+ * how the gradients of the workers reach the weights during training
+ **/
+enum class update_mode {
+    synchronous, ///< merge the gradients of a minibatch, then update once
+    hogwild      ///< each worker applies every sample's gradient at once, without barriers
+};
+
 enum grad_check_mode {
     GRAD_CHECK_ALL, ///< check all elements of weights
     GRAD_CHECK_RANDOM ///< check 10 randomly selected weights
@@ -96,7 +110,7 @@ class network
 public:
     typedef LossFunction E;
 
-    explicit network(const std::string& name = "") : name_(name) {}
+    explicit network(const std::string& name = "") : name_(name), update_mode_(update_mode::synchronous), accuracy_(math_accuracy::exact) {}
 
     /**
      * return input dims of network
@@ -110,22 +124,79 @@ public:
 
     std::string  name() const           { return name_; }
     Optimizer&   optimizer()            { return optimizer_; }
+    parallel_scheduler& scheduler()     { return scheduler_; }
+
+    /**
+     * select asynchronous (hogwild) training, for workloads where the barrier
+     * and merge of synchronous minibatch training cost more than the compute.
+     * workers update the shared weights without locks, so concurrent updates
+     * of one weight may be lost. requires an optimizer with update_async
+     * (gradient_descent, momentum)
+     **/
+    void         set_update_mode(update_mode mode) { update_mode_ = mode; }
+    update_mode  get_update_mode() const           { return update_mode_; }
+
+    /**
+     * select exact or approximated exp/tanh/sigmoid for the activations of
+     * all layers, including the ones added later. approximations apply to
+     * float_t = float, other types always compute exactly
+     **/
+    void set_math_accuracy(math_accuracy accuracy) {
+        accuracy_ = accuracy;
+        for (size_t i = 0; i != layers_.depth(); ++i)
+            layers_[i]->activation_function().set_accuracy(accuracy);
+    }
+    math_accuracy get_math_accuracy() const { return accuracy_; }
 
     /**
      * explicitly initialize weights of all layers
      **/
     void         init_weight()          { layers_.init_weight(); }
 
+    /**
+     * place the per-worker buffers of all layers on the NUMA node of the
+     * thread they are assigned to (see thread_config)
+     **/
+    void         bind_worker_buffers()  { layers_.bind_worker_buffers(global_thread_config()); }
+
+    /**
+     * move the weights and per-worker buffers of all layers into new
+     * allocations, e.g. onto huge pages after set_memory_policy()
+     **/
+    void         reallocate_buffers()   { layers_.reallocate_buffers(); }
+
+    /**
+     * choose sample-parallel or intra-layer parallelism of each layer for the
+     * given batch size (see parallel_scheduler). called by train(); call it
+     * before predict() when running inference on several threads
+     **/
+    void schedule_parallelism(size_t batch_size, bool training = false) {
+        const size_t threads = global_thread_config().num_threads;
+        scheduler_.apply(layers_, scheduler_.plan(layers_, batch_size, threads, training));
+    }
+
     /**
      * add one layer to tail(output-side)
      **/
-    void         add(std::shared_ptr<layer_base> layer) { layers_.add(layer); }
+    void         add(std::shared_ptr<layer_base> layer) {
+        layer->activation_function().set_accuracy(accuracy_);
+        layers_.add(layer);
+    }
 
     /**
      * executes forward-propagation and returns output
      **/
     vec_t        predict(const vec_t& in) { return fprop(in); }
 
+    /**
+     * executes forward-propagation and copies the output into out, which
+     * does not allocate once out has the capacity of the output layer
+     **/
+    void         predict(const vec_t& in, vec_t& out) {
+        const vec_t& y = fprop(in);
+        out.assign(y.begin(), y.end());
+    }
+
     /**
      * executes forward-propagation and returns maximum output
      **/
@@ -178,16 +249,21 @@ public:
         set_netphase(net_phase::train);
         if (reset_weights)
             init_weight();
-        layers_.set_parallelize(batch_size < CNN_TASK_SIZE);
+        schedule_parallelism(std::min(batch_size, static_cast<size_t>(n_threads)), true);
+        if (global_thread_config().numa_local)
+            bind_worker_buffers();
         optimizer_.reset();
 
         for (int iter = 0; iter < epoch; iter++) {
             if (optimizer_.requires_hessian())
                 calc_hessian(in);
             for (size_t i = 0; i < in.size(); i+=batch_size) {
+                const size_t allocs = alloc_check::count();
                 train_once(&in[i], &t[i],
                            static_cast<int>(std::min(batch_size, in.size() - i)),
                            n_threads);
+                if (alloc_check::enabled() && iter > 0)
+                    check_steady_state(allocs);
                 on_batch_enumerate();
 
                 if (i % 100 == 0 && layers_.is_exploded()) {
@@ -209,6 +285,65 @@ public:
         return train(in, t, batch_size, epoch, nop, nop);
     }
 
+    /**
+     * training conv-net on the minibatches of a data_loader, which is started
+     * here and keeps preparing (shuffling, transforming, encoding targets) the
+     * following batches on its own threads while the current one is trained
+     *
+     * @param loader             loader that has not been started yet
+     * @param on_batch_enumerate callback for each mini-batch enumerate
+     * @param on_epoch_enumerate callback for each epoch
+     * @param reset_weights      reset all weights or keep current
+     * @param n_threads          number of tasks
+     */
+    template <typename OnBatchEnumerate, typename OnEpochEnumerate, typename T>
+    bool train(data_loader<T>&  loader,
+               OnBatchEnumerate on_batch_enumerate,
+               OnEpochEnumerate on_epoch_enumerate,
+               const bool       reset_weights = true,
+               const int        n_threads = CNN_TASK_SIZE
+               )
+    {
+        check_training_data(loader.inputs(), loader.targets());
+        set_netphase(net_phase::train);
+        if (reset_weights)
+            init_weight();
+        schedule_parallelism(std::min(loader.config().batch_size, static_cast<size_t>(n_threads)), true);
+        if (global_thread_config().numa_local)
+            bind_worker_buffers();
+        optimizer_.reset();
+
+        const float_t tmin = target_value_min();
+        const float_t tmax = target_value_max();
+        loader.start([tmin, tmax](const T& t, vec_t& dst) { target_vector(t, dst, tmin, tmax); }, out_dim());
+
+        size_t n = 0;
+        while (const minibatch* b = loader.next()) {
+            if (b->index == 0 && optimizer_.requires_hessian())
+                calc_hessian(loader.inputs());
+
+            train_once(&b->in[0], &b->t[0], static_cast<int>(b->size), n_threads);
+            on_batch_enumerate();
+
+            if (n++ % 100 == 0 && layers_.is_exploded()) {
+                std::cout << "[Warning]Detected infinite value in weight. stop learning." << std::endl;
+                loader.stop();
+                return false;
+            }
+            if (b->index + 1 == loader.batches_per_epoch())
+                on_epoch_enumerate();
+        }
+        return true;
+    }
+
+    /**
+     * training conv-net on a data_loader without callback
+     **/
+    template<typename T>
+    bool train(data_loader<T>& loader) {
+        return train(loader, nop, nop);
+    }
+
     /**
      * set the netphase to train or test
      * @param phase phase of network, could be train or test
@@ -266,7 +401,7 @@ public:
      * @attention this saves only network *weights*, not network configuration
      **/
     void save(std::ostream& os) const {
-        os.precision(std::numeric_limits<tiny_cnn::float_t>::digits10);
+        os.precision(std::numeric_limits<tiny_cnn::float_t>::max_digits10);
 
         auto l = layers_.head();
         while (l) { l->save(os); l = l->next(); }
@@ -283,6 +418,26 @@ public:
         while (l) { l->load(is); l = l->next(); }
     }
 
+    /**
+     * save network weights, and the state layers keep besides them (e.g.
+     * binarized weights and thresholds), as a binary model (see io/binary_model.h)
+     * @attention this saves only network *weights*, not network configuration
+     **/
+    void save_binary(const std::string& path) const {
+        std::ofstream ofs(path.c_str(), std::ios::binary | std::ios::trunc);
+        if (!ofs) throw nn_error("failed to open " + path);
+        binary_model::write(ofs, all_layers());
+    }
+
+    /**
+     * load the weights of a binary model, without parsing. the network must
+     * have the architecture the model was saved from
+     * @attention this loads only network *weights*, not network configuration
+     **/
+    void load_binary(const std::string& path, bool verify_checksum = true) {
+        binary_model::load(path, all_layers(), verify_checksum);
+    }
+
     /**
      * checking gradients calculated by bprop
      * detail information:
@@ -360,6 +515,13 @@ public:
         return layers_[index];
     }
 
+    /**
+     * return shared pointer of index-th layer
+     **/
+    std::shared_ptr<layer_base> shared_at(size_t index) const {
+        return layers_.shared_at(index);
+    }
+
     /**
      * number of layers
      **/
@@ -407,29 +569,44 @@ protected:
     }
 private:
 
+    // fills the first num vectors of *vec, reusing the ones it already holds
     void label2vector(const label_t* t, int num, std::vector<vec_t> *vec) const {
         cnn_size_t outdim = out_dim();
 
         assert(num > 0);
         assert(outdim > 0);
 
-        vec->reserve(num);
+        if (vec->size() < static_cast<size_t>(num))
+            vec->resize(num);
         for (int i = 0; i < num; i++) {
             assert(t[i] < outdim);
-            vec->emplace_back(outdim, target_value_min());
-            vec->back()[t[i]] = target_value_max();
+            (*vec)[i].assign(outdim, target_value_min());
+            (*vec)[i][t[i]] = target_value_max();
         }
     }
 
+    // every layer including the input layer, in network order
+    std::vector<layer_base*> all_layers() const {
+        std::vector<layer_base*> v;
+        for (auto l = layers_.head(); l; l = l->next()) v.push_back(l);
+        return v;
+    }
+
+    void check_steady_state(size_t allocs_before) const {
+        const size_t n = alloc_check::count() - allocs_before;
+        if (n != 0)
+            throw nn_error("heap allocation in the steady-state training loop (" +
+                           std::to_string(n) + " in one minibatch)");
+    }
+
     /**
      * train on one minibatch
      *
      * @param size is the number of data points to use in this batch
      */
     void train_once(const vec_t* in, const label_t* t, int size, const int nbThreads = CNN_TASK_SIZE) {
-        std::vector<vec_t> v;
-        label2vector(t, size, &v);
-        train_once(in, &v[0], size, nbThreads );
+        label2vector(t, size, &targets_);
+        train_once(in, &targets_[0], size, nbThreads );
     }
 
     /**
@@ -441,6 +618,8 @@ private:
         if (size == 1) {
             bprop(fprop(in[0]), t[0]);
             layers_.update_weights(&optimizer_, 1, 1);
+        } else if (update_mode_ == update_mode::hogwild) {
+            train_onebatch_async(in, t, size, nbThreads);
         } else {
             train_onebatch(in, t, size, nbThreads);
         }
@@ -459,20 +638,59 @@ private:
         // number of data points to use in each thread
         int data_per_thread = (batch_size + num_threads - 1) / num_threads;
 
+        // layers that support it compute dW for the whole batch at once
+        layers_.begin_batch(batch_size);
+
         // i is the thread / worker index
         for_i(num_threads, [&](int i) {
             int start_index = i * data_per_thread;
             int end_index = std::min(batch_size, start_index + data_per_thread);
 
+            // scratch taken by the layers is released at the end of the batch
+            scratch_scope scratch;
+
             // loop over data points in this batch assigned to thread i
-            for (int j = start_index; j < end_index; ++j)
+            for (int j = start_index; j < end_index; ++j) {
+                layers_.set_batch_row(i, j);
                 bprop(fprop(in[j], i), t[j], i);
+            }
         }, 1);
-        
+
+        layers_.end_batch();
+
         // merge all dW and update W by optimizer
         layers_.update_weights(&optimizer_, num_threads, batch_size);
     }
 
+    /**
+     * trains on one minibatch without synchronization: every worker applies the
+     * gradient of each of its samples to the shared weights as soon as it is computed
+     */
+    void train_onebatch_async(const vec_t* in, const vec_t* t, int batch_size, const int num_tasks = CNN_TASK_SIZE) {
+        if (!has_async_update<Optimizer>::value)
+            throw nn_error("hogwild training requires an optimizer with update_async");
+
+        int num_threads = std::min(batch_size, num_tasks);
+        int data_per_thread = (batch_size + num_threads - 1) / num_threads;
+
+        layers_.reserve_optimizer_state(&optimizer_);
+
+        for_i(num_threads, [&](int i) {
+            int start_index = i * data_per_thread;
+            int end_index = std::min(batch_size, start_index + data_per_thread);
+            scratch_scope scratch;
+
+            for (int j = start_index; j < end_index; ++j) {
+                bprop(fprop(in[j], i), t[j], i);
+                update_weights_async(i, std::integral_constant<bool, has_async_update<Optimizer>::value>());
+            }
+        }, 1);
+
+        // derived weights (e.g. binarized copies) are refreshed once the
+        // workers are done; within the batch they lag the shared weights
+        layers_.post_update();
+    }
+
     void calc_hessian(const std::vector<vec_t>& in, int size_initialize_hessian = 500) {
         int size = std::min((int)in.size(), size_initialize_hessian);
 
@@ -510,7 +728,8 @@ private:
     }
 
     void bprop_2nd(const vec_t& out) {
-        vec_t delta(out_dim());
+        vec_t& delta = delta_[0];
+        delta.resize(out_dim());
         const activation::function& h = layers_.tail()->activation_function();
 
         if (is_canonical_link(h)) {
@@ -523,22 +742,22 @@ private:
     }
 
     void bprop(const vec_t& out, const vec_t& t, int idx = 0) {
-        vec_t delta(out_dim());
+        // reused per worker, so the output stage does not allocate
+        vec_t& delta = delta_[idx];
+        delta.resize(out_dim());
         const activation::function& h = layers_.tail()->activation_function();
+        const size_t n = out.size();
 
         if (is_canonical_link(h)) {
             // we have a combination of loss function and last layer
             // output activation function which is such that
             // dE / da = (dE/dy) * (dy/da) = y - target
-            for_i(out_dim(), [&](int i){ delta[i] = out[i] - t[i]; });
+            for (size_t i = 0; i < n; i++) delta[i] = out[i] - t[i];
         } else {
-            vec_t dE_dy = gradient<E>(out, t);
-
-            // delta = dE/da = (dE/dy) * (dy/da)
-            for (size_t i = 0; i < out_dim(); i++) {
-                vec_t dy_da = h.df(out, i);
-                delta[i] = vectorize::dot(&dE_dy[0], &dy_da[0], out_dim());
-            }
+            // delta = dE/da = (dE/dy) * (dy/da), one pass for the loss and
+            // one for the activation, without forming the jacobian
+            gradient<E>(out, t, delta);
+            h.mul_jacobian(out, delta);
         }
 
         layers_.tail()->back_propagation(delta, idx);
@@ -568,7 +787,7 @@ private:
 
         float_t delta_by_bprop = dw[check_index];
 
-        return std::abs(delta_by_bprop - delta_by_numerical) <= eps;
+        return abs(delta_by_bprop - delta_by_numerical) <= eps;
     }
 
     void check_t(size_t i, label_t t, cnn_size_t dim_out) {
@@ -606,12 +825,32 @@ private:
         }
     }
 
+    static void target_vector(label_t t, vec_t& dst, float_t tmin, float_t tmax) {
+        std::fill(dst.begin(), dst.end(), tmin);
+        dst[t] = tmax;
+    }
+
+    static void target_vector(const vec_t& t, vec_t& dst, float_t, float_t) {
+        std::copy(t.begin(), t.end(), dst.begin());
+    }
+
     float_t target_value_min() const { return layers_.tail()->activation_function().scale().first; }
     float_t target_value_max() const { return layers_.tail()->activation_function().scale().second; }
 
+    void update_weights_async(int worker_index, std::true_type) {
+        layers_.update_weights_async(&optimizer_, worker_index);
+    }
+
+    void update_weights_async(int, std::false_type) {}
+
     std::string name_;
     Optimizer optimizer_;
     layers layers_;
+    parallel_scheduler scheduler_;
+    update_mode update_mode_;
+    math_accuracy accuracy_;
+    vec_t delta_[CNN_TASK_SIZE];
+    std::vector<vec_t> targets_; // one-hot targets of the current minibatch
 };
 
 /**
@@ -26,7 +26,9 @@
 */
 #pragma once
 #include "tiny_cnn/util/util.h"
+#include "tiny_cnn/util/parameter_arena.h"
 #include <unordered_map>
+#include <utility>
 
 namespace tiny_cnn {
 
@@ -49,6 +51,35 @@ struct optimizer {
 
     bool requires_hessian() const { return usesHessian; } // vc2012 doesn't support constexpr
     virtual void reset() {} // override to implement pre-learning action
+    void reserve(const vec_t& /*W*/) {} // prepare the state of W before concurrent updates
+};
+
+/**
+ * true if Optimizer can apply single-sample updates from several threads
+ * at once (update_async), as used by hogwild training
+ **/
+template <typename Optimizer>
+struct has_async_update {
+    template <typename U>
+    static auto check(U* o) -> decltype(o->update_async(std::declval<const vec_t&>(), std::declval<vec_t&>()), std::true_type());
+    template <typename U>
+    static std::false_type check(...);
+
+    static const bool value = decltype(check<Optimizer>(nullptr))::value;
+};
+
+/**
+ * true if Optimizer can update all parameters of a network in one pass
+ * over a parameter_arena (update_fused)
+ **/
+template <typename Optimizer>
+struct has_fused_update {
+    template <typename U>
+    static auto check(U* o) -> decltype(o->update_fused(std::declval<const parameter_arena&>(), cnn_size_t(), cnn_size_t()), std::true_type());
+    template <typename U>
+    static std::false_type check(...);
+
+    static const bool value = decltype(check<Optimizer>(nullptr))::value;
 };
 
 // helper class to hold N values for each weight
@@ -56,17 +87,39 @@ template <int N, bool usesHessian = false>
 struct stateful_optimizer : public optimizer<usesHessian> {
     void reset() override {
         for (auto& e : E_) e.clear();
+        for (auto& f : flat_) f.clear();
+    }
+
+    void reserve(const vec_t& key) {
+        for (auto& e : E_)
+            if (e[&key].empty()) e[&key].resize(key.size(), float_t());
     }
 
 protected:
+    // lookups of reserved keys do not modify the map and may run concurrently
     template <int Index>
     vec_t& get(const vec_t& key) {
         static_assert(Index < N, "index out of range");
-        if (E_[Index][&key].empty())
-            E_[Index][&key].resize(key.size(), float_t());
-        return E_[Index][&key];
+        auto it = E_[Index].find(&key);
+        if (it != E_[Index].end() && !it->second.empty())
+            return it->second;
+        vec_t& e = E_[Index][&key];
+        e.resize(key.size(), float_t());
+        return e;
     }
+
+    // state of the fused update, laid out like the parameter_arena.
+    // separate from the per-vector state above
+    template <int Index>
+    float_t* flat(const parameter_arena& p) {
+        static_assert(Index < N, "index out of range");
+        vec_t& f = flat_[Index];
+        if (f.size() != p.size()) f.assign(p.size(), float_t());
+        return f.data();
+    }
+
     std::unordered_map<const vec_t*, vec_t> E_[N];
+    vec_t flat_[N];
 };
 
 /**
@@ -86,6 +139,13 @@ public:
         });
     }
 
+    void update_fused(const parameter_arena& p, cnn_size_t worker_size, cnn_size_t batch_size) {
+        p.for_each_run(worker_size, batch_size, [&](float_t* W, const float_t* dW, const float_t* H, size_t, size_t n) {
+            for (size_t i = 0; i < n; i++)
+                W[i] = W[i] - (alpha / (H[i] + mu)) * dW[i];
+        });
+    }
+
     float_t alpha; // learning rate
     float_t mu; // constant to prevent step size from becoming too large when H is small
 };
@@ -105,7 +165,19 @@ struct adagrad : public stateful_optimizer<1, false> {
 
         for_i(static_cast<int>(W.size()), [&](int i) {
             g[i] += dW[i] * dW[i];
-            W[i] -= alpha * dW[i] / (std::sqrt(g[i]) + eps);
+            W[i] -= alpha * dW[i] / (sqrt(g[i]) + eps);
+        });
+    }
+
+    void update_fused(const parameter_arena& p, cnn_size_t worker_size, cnn_size_t batch_size) {
+        float_t* g = flat<0>(p);
+
+        p.for_each_run(worker_size, batch_size, [&](float_t* W, const float_t* dW, const float_t*, size_t offset, size_t n) {
+            float_t* gi = g + offset;
+            for (size_t i = 0; i < n; i++) {
+                gi[i] += dW[i] * dW[i];
+                W[i] -= alpha * dW[i] / (sqrt(gi[i]) + eps);
+            }
         });
     }
 
@@ -129,7 +201,19 @@ struct RMSprop : public stateful_optimizer<1, false> {
         for_i(static_cast<int>(W.size()), [&](int i)
         {
             g[i] = mu * g[i] + (1 - mu) * dW[i] * dW[i];
-            W[i] -= alpha * dW[i] / std::sqrt(g[i] + eps);
+            W[i] -= alpha * dW[i] / sqrt(g[i] + eps);
+        });
+    }
+
+    void update_fused(const parameter_arena& p, cnn_size_t worker_size, cnn_size_t batch_size) {
+        float_t* g = flat<0>(p);
+
+        p.for_each_run(worker_size, batch_size, [&](float_t* W, const float_t* dW, const float_t*, size_t offset, size_t n) {
+            float_t* gi = g + offset;
+            for (size_t i = 0; i < n; i++) {
+                gi[i] = mu * gi[i] + (1 - mu) * dW[i] * dW[i];
+                W[i] -= alpha * dW[i] / sqrt(gi[i] + eps);
+            }
         });
     }
 
@@ -159,7 +243,27 @@ struct adam : public stateful_optimizer<2, false> {
             mt[i] = b1 * mt[i] + (float_t(1) - b1) * dW[i];
             vt[i] = b2 * vt[i] + (float_t(1) - b2) * dW[i] * dW[i];
 
-            W[i] -= alpha * ( mt[i]/(float_t(1) -b1_t) ) / std::sqrt( (vt[i]/(float_t(1)-b2_t)) + eps);
+            W[i] -= alpha * ( mt[i]/(float_t(1) -b1_t) ) / sqrt( (vt[i]/(float_t(1)-b2_t)) + eps);
+        });
+    }
+
+    // advances b1_t / b2_t once per step, as in the paper (update advances
+    // them once per parameter vector)
+    void update_fused(const parameter_arena& p, cnn_size_t worker_size, cnn_size_t batch_size) {
+        float_t* m = flat<0>(p);
+        float_t* v = flat<1>(p);
+
+        b1_t*=b1;b2_t*=b2;
+
+        p.for_each_run(worker_size, batch_size, [&](float_t* W, const float_t* dW, const float_t*, size_t offset, size_t n) {
+            float_t* mt = m + offset;
+            float_t* vt = v + offset;
+            for (size_t i = 0; i < n; i++) {
+                mt[i] = b1 * mt[i] + (float_t(1) - b1) * dW[i];
+                vt[i] = b2 * vt[i] + (float_t(1) - b2) * dW[i] * dW[i];
+
+                W[i] -= alpha * ( mt[i]/(float_t(1) -b1_t) ) / sqrt( (vt[i]/(float_t(1)-b2_t)) + eps);
+            }
         });
     }
 
@@ -188,6 +292,20 @@ struct gradient_descent : public optimizer<false> {
         });
     }
 
+    void update_fused(const parameter_arena& p, cnn_size_t worker_size, cnn_size_t batch_size) {
+        p.for_each_run(worker_size, batch_size, [&](float_t* W, const float_t* dW, const float_t*, size_t, size_t n) {
+            for (size_t i = 0; i < n; i++)
+                W[i] = W[i] - alpha * (dW[i] + lambda * W[i]);
+        });
+    }
+
+    // called by several workers at once without synchronization (hogwild),
+    // concurrent updates of the same weight may overwrite each other
+    void update_async(const vec_t& dW, vec_t& W) {
+        for (size_t i = 0; i < W.size(); i++)
+            W[i] = W[i] - alpha * (dW[i] + lambda * W[i]);
+    }
+
     float_t alpha; // learning rate
     float_t lambda; // weight decay
 };
@@ -213,6 +331,31 @@ public:
         });
     }
 
+    void update_fused(const parameter_arena& p, cnn_size_t worker_size, cnn_size_t batch_size) {
+        float_t* v = flat<0>(p);
+
+        p.for_each_run(worker_size, batch_size, [&](float_t* W, const float_t* dW, const float_t*, size_t offset, size_t n) {
+            float_t* dWprev = v + offset;
+            for (size_t i = 0; i < n; i++) {
+                float_t V = mu * dWprev[i] - alpha * (dW[i] + W[i] * lambda);
+                W[i]      += V;
+                dWprev[i] =  V;
+            }
+        });
+    }
+
+    // called by several workers at once without synchronization (hogwild),
+    // the velocity is shared between them. reserve(W) must have been called
+    void update_async(const vec_t& dW, vec_t& W) {
+        vec_t& dWprev = get<0>(W);
+
+        for (size_t i = 0; i < W.size(); i++) {
+            float_t V = mu * dWprev[i] - alpha * (dW[i] + W[i] * lambda);
+            W[i]      += V;
+            dWprev[i] =  V;
+        }
+    }
+
     float_t alpha; // learning rate
     float_t lambda; // weight decay
     float_t mu; // momentum
@@ -56,6 +56,11 @@
 #include "util/image.h"
 #include "util/deform.h"
 #include "util/product.h"
+#include "util/fast_math.h"
+#include "util/scratch_arena.h"
+#include "util/offload_partitioner.h"
+#include "util/bnn_dataflow.h"
+#include "util/pipeline.h"
 
 #include "io/mnist_parser.h"
 #include "io/cifar10_parser.h"
@@ -33,6 +33,9 @@
 #include <mm_malloc.h>
 #endif
 #include "nn_error.h"
+#include "alloc_check.h"
+#include "memory_policy.h"
+#include <memory>
 
 namespace tiny_cnn {
 
@@ -66,6 +69,11 @@ public:
     }
 
     pointer allocate(size_type size, const void* = nullptr) {
+        if (void* placed = detail::place_in_region(sizeof(T) * size, alignment))
+            return static_cast<pointer>(placed);
+        alloc_check::record();
+        if (void* mapped = detail::policy_allocate(sizeof(T) * size))
+            return static_cast<pointer>(mapped);
         void* p = aligned_alloc(alignment, sizeof(T) * size);
         if (!p && size > 0)
             throw nn_error("failed to allocate");
@@ -76,7 +84,8 @@ public:
         return ~static_cast<std::size_t>(0) / sizeof(T);
     }
 
-    void deallocate(pointer ptr, size_type) {
+    void deallocate(pointer ptr, size_type size) {
+        if (detail::policy_deallocate(ptr, sizeof(T) * size)) return;
         aligned_free(ptr);
     }
 
@@ -146,4 +155,5 @@ inline bool operator!=(const aligned_allocator<T1, alignment>&, const aligned_al
 {
     return false;
 }
-}
\ No newline at end of file
+
+} // namespace tiny_cnn
@@ -0,0 +1,76 @@
+/******************************************************************************
+ *  Copyright (c) 2016, Xilinx, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  1.  Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *  2.  Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *  3.  Neither the name of the copyright holder nor the names of its
+ *      contributors may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ *  OR BUSINESS INTERRUPTION). HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ *  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ *  ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *****************************************************************************/
+#pragma once
+#include <atomic>
+#include <cstddef>
+
+/**
+ * debug mode that counts heap allocations, to verify that training reaches an
+ * allocation-free steady state. define CNN_ALLOC_CHECK in every translation
+ * unit of the program, and include alloc_check_new.h (the counting global
+ * operator new/delete) from exactly one of them.
+ *
+ * network::train then treats the first epoch as warm-up and throws nn_error
+ * if a later minibatch allocates. allocations of all threads are counted, so
+ * nothing else should run concurrently with the checked loop
+ **/
+
+namespace tiny_cnn {
+namespace alloc_check {
+
+inline std::atomic<size_t>& counter() {
+    static std::atomic<size_t> n(0);
+    return n;
+}
+
+// number of heap allocations so far, 0 when CNN_ALLOC_CHECK is not defined
+inline size_t count() {
+    return counter().load(std::memory_order_relaxed);
+}
+
+// counts an allocation that does not go through operator new (aligned_allocator)
+inline void record() {
+#ifdef CNN_ALLOC_CHECK
+    counter().fetch_add(1, std::memory_order_relaxed);
+#endif
+}
+
+inline bool enabled() {
+#ifdef CNN_ALLOC_CHECK
+    return true;
+#else
+    return false;
+#endif
+}
+
+} // namespace alloc_check
+} // namespace tiny_cnn
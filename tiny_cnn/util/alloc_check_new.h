@@ -0,0 +1,74 @@
+/******************************************************************************
+ *  Copyright (c) 2016, Xilinx, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  1.  Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *  2.  Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *  3.  Neither the name of the copyright holder nor the names of its
+ *      contributors may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ *  OR BUSINESS INTERRUPTION). HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ *  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ *  ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *****************************************************************************/
+#pragma once
+#include <cstdlib>
+#include <new>
+#include "alloc_check.h"
+
+/**
+ * replacement global operator new/delete that count heap allocations for
+ * CNN_ALLOC_CHECK. these are ordinary (non-inline) definitions: include this
+ * header from exactly one translation unit of the program, which defines
+ * CNN_ALLOC_CHECK like all the others
+ **/
+
+#ifndef CNN_ALLOC_CHECK
+#error "alloc_check_new.h requires CNN_ALLOC_CHECK"
+#endif
+
+// kept out of line: inlined into callers, the malloc/free pair below makes
+// -Wmismatched-new-delete flag every new-expression whose delete it sees
+#if defined(__GNUC__)
+#define CNN_ALLOC_CHECK_NOINLINE __attribute__((noinline))
+#else
+#define CNN_ALLOC_CHECK_NOINLINE
+#endif
+
+CNN_ALLOC_CHECK_NOINLINE void* operator new(std::size_t size) {
+    tiny_cnn::alloc_check::record();
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+CNN_ALLOC_CHECK_NOINLINE void* operator new[](std::size_t size) {
+    return ::operator new(size);
+}
+
+CNN_ALLOC_CHECK_NOINLINE void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+CNN_ALLOC_CHECK_NOINLINE void operator delete[](void* p) noexcept {
+    std::free(p);
+}
+
+#undef CNN_ALLOC_CHECK_NOINLINE
@@ -0,0 +1,224 @@
+/******************************************************************************
+ *  Copyright (c) 2016, Xilinx, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  1.  Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *  2.  Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *  3.  Neither the name of the copyright holder nor the names of its
+ *      contributors may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ *  OR BUSINESS INTERRUPTION). HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ *  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ *  ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *****************************************************************************/
+#pragma once
+
+// cycle-approximate throughput model of a FINN-style streaming dataflow
+// implementation of a binarized network.
+//
+// every layer becomes its own compute unit and all units work concurrently on
+// consecutive frames, so the initiation interval (II) of the pipeline is the
+// cycle count of the slowest unit. a matrix layer with R rows (neurons /
+// output channels), C columns (fan-in) and V matrix-vector products per frame
+// (output pixels of a conv) folded onto PE x SIMD lanes needs
+//     V * ceil(R / PE) * ceil(C / SIMD)
+// cycles per frame. element-wise layers (thresholds, pooling...) process PE
+// elements per cycle.
+
+#include "tiny_cnn/network.h"
+#include <vector>
+#include <string>
+#include <cstdint>
+
+namespace tiny_cnn {
+
+/**
+ * folding factors of one layer.
+ * pe: neurons computed in parallel, simd: synapses per neuron per cycle
+ **/
+struct layer_folding {
+    layer_folding() : pe(1), simd(1) {}
+    layer_folding(cnn_size_t pe_, cnn_size_t simd_) : pe(pe_), simd(simd_) {}
+
+    cnn_size_t pe;
+    cnn_size_t simd;
+};
+
+/**
+ * target device parameters
+ **/
+struct dataflow_config {
+    dataflow_config() : clock_mhz(200), lut_per_lane(2.5), lut_per_pe(40) {}
+
+    double clock_mhz;
+    double lut_per_lane;  // LUTs of one xnor-popcount synapse lane
+    double lut_per_pe;    // LUTs of one PE besides its lanes (accumulator, threshold compare)
+};
+
+struct dataflow_layer_estimate {
+    std::string type;
+    cnn_size_t rows;      // R: neurons or output channels
+    cnn_size_t cols;      // C: synapses per neuron
+    cnn_size_t vectors;   // V: matrix-vector products per frame
+    layer_folding folding;
+    uint64_t cycles;      // cycles per frame
+    double luts;
+    uint64_t weight_bits; // on-chip weight memory
+};
+
+struct dataflow_estimate {
+    std::vector<dataflow_layer_estimate> layers;
+    uint64_t ii_cycles;      // initiation interval of the pipeline
+    size_t bottleneck;       // index of the slowest layer
+    uint64_t latency_cycles; // first frame in to result out (upper bound)
+    double luts;
+    double fps;
+};
+
+namespace detail {
+
+inline uint64_t ceil_div(uint64_t a, uint64_t b) {
+    return (a + b - 1) / b;
+}
+
+// smallest divisor of n greater than d, or 0 if d >= n
+inline cnn_size_t next_divisor(cnn_size_t n, cnn_size_t d) {
+    for (cnn_size_t k = d + 1; k <= n; k++)
+        if (n % k == 0) return k;
+    return 0;
+}
+
+inline dataflow_layer_estimate dataflow_shape(const layer_base& l) {
+    dataflow_layer_estimate e;
+    e.type = l.layer_type();
+
+    if (e.type == "bnn_conv_layer") {
+        e.cols = static_cast<cnn_size_t>(l.fan_in_size());
+        e.vectors = static_cast<cnn_size_t>(l.connection_size() / l.fan_in_size());
+        e.rows = l.out_size() / e.vectors;
+    } else if (e.type == "binarynet-fully-connected" || e.type == "bnn_fc_layer") {
+        e.rows = l.out_size();
+        e.cols = l.in_size();
+        e.vectors = 1;
+    } else if (l.param_size() == 0) {
+        // element-wise streaming unit (thresholding, pooling, interleaving...)
+        e.rows = l.in_size();
+        e.cols = 1;
+        e.vectors = 1;
+    } else {
+        throw nn_error("dataflow model: unsupported layer type " + e.type);
+    }
+    e.weight_bits = e.cols > 1 ? uint64_t(e.rows) * e.cols : 0;
+    return e;
+}
+
+inline void dataflow_cost(dataflow_layer_estimate& e, const dataflow_config& cfg) {
+    if (e.folding.pe == 0 || e.folding.simd == 0 || e.folding.pe > e.rows || e.folding.simd > e.cols)
+        throw nn_error(format_str("dataflow model: invalid folding PE=%u SIMD=%u for %ux%u matrix of %s",
+            e.folding.pe, e.folding.simd, e.rows, e.cols, e.type.c_str()));
+
+    e.cycles = uint64_t(e.vectors) * ceil_div(e.rows, e.folding.pe) * ceil_div(e.cols, e.folding.simd);
+    e.luts = double(e.folding.pe) * (double(e.folding.simd) * cfg.lut_per_lane + cfg.lut_per_pe);
+}
+
+} // namespace detail
+
+/**
+ * estimate II, bottleneck and frames per second for the given per-layer folding
+ **/
+template <typename L, typename O>
+dataflow_estimate simulate_dataflow(network<L, O>& net, const std::vector<layer_folding>& folding,
+                                    const dataflow_config& cfg = dataflow_config()) {
+    if (folding.size() != net.depth())
+        throw nn_error(format_str("dataflow model: %u folding factors given, network has %u layers",
+                                  static_cast<unsigned int>(folding.size()),
+                                  static_cast<unsigned int>(net.depth())));
+
+    dataflow_estimate est;
+    est.ii_cycles = 0;
+    est.bottleneck = 0;
+    est.latency_cycles = 0;
+    est.luts = 0;
+
+    for (size_t i = 0; i < net.depth(); i++) {
+        dataflow_layer_estimate e = detail::dataflow_shape(*net[i]);
+        e.folding = folding[i];
+        detail::dataflow_cost(e, cfg);
+
+        if (e.cycles > est.ii_cycles) {
+            est.ii_cycles = e.cycles;
+            est.bottleneck = i;
+        }
+        est.latency_cycles += e.cycles;
+        est.luts += e.luts;
+        est.layers.push_back(e);
+    }
+    est.fps = est.ii_cycles ? cfg.clock_mhz * 1e6 / double(est.ii_cycles) : 0.0;
+    return est;
+}
+
+/**
+ * search the folding that minimizes the II within lut_budget.
+ *
+ * starts fully folded (PE=SIMD=1) and keeps unfolding the bottleneck layer by
+ * the next PE or SIMD value that divides its matrix, whichever brings it down
+ * further, until the bottleneck cannot be unfolded within the budget.
+ **/
+template <typename L, typename O>
+std::vector<layer_folding> balance_folding(network<L, O>& net, double lut_budget,
+                                           const dataflow_config& cfg = dataflow_config()) {
+    std::vector<layer_folding> folding(net.depth());
+    dataflow_estimate est = simulate_dataflow(net, folding, cfg);
+
+    if (est.luts > lut_budget)
+        throw nn_error("dataflow model: budget too small even for fully folded network");
+
+    for (;;) {
+        const size_t b = est.bottleneck;
+        dataflow_layer_estimate cur = est.layers[b];
+        dataflow_layer_estimate best = cur;
+        bool found = false;
+
+        layer_folding options[2] = {
+            layer_folding(detail::next_divisor(cur.rows, cur.folding.pe), cur.folding.simd),
+            layer_folding(cur.folding.pe, detail::next_divisor(cur.cols, cur.folding.simd))
+        };
+
+        for (const auto& f : options) {
+            if (f.pe == 0 || f.simd == 0) continue;
+            dataflow_layer_estimate e = cur;
+            e.folding = f;
+            detail::dataflow_cost(e, cfg);
+            if (est.luts - cur.luts + e.luts > lut_budget) continue;
+            if (!found || e.cycles < best.cycles || (e.cycles == best.cycles && e.luts < best.luts)) {
+                best = e;
+                found = true;
+            }
+        }
+        if (!found) break;
+
+        folding[b] = best.folding;
+        est = simulate_dataflow(net, folding, cfg);
+    }
+    return folding;
+}
+
+} // namespace tiny_cnn
@@ -0,0 +1,266 @@
+/******************************************************************************
+ *  Copyright (c) 2016, Xilinx, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  1.  Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *  2.  Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *  3.  Neither the name of the copyright holder nor the names of its
+ *      contributors may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ *  OR BUSINESS INTERRUPTION). HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ *  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ *  ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *****************************************************************************/
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <numeric>
+#include <thread>
+#include <vector>
+#include "tiny_cnn/util/util.h"
+
+namespace tiny_cnn {
+
+struct loader_config {
+    size_t   batch_size    = 1;
+    int      epochs        = 1;
+    bool     shuffle       = true;  // new sample order every epoch
+    uint32_t stream        = 0;     // loaders on different streams draw different numbers
+    int      num_producers = 1;     // threads preparing batches
+    size_t   prefetch      = 4;     // batches prepared ahead of the consumer
+};
+
+/**
+ * one prepared minibatch. in / t hold batch_size vectors, of which the
+ * first size are valid (the last batch of an epoch may be short)
+ **/
+struct minibatch {
+    std::vector<vec_t> in;
+    std::vector<vec_t> t;
+    size_t size;
+    int    epoch;
+    size_t index; // position of the batch in its epoch
+};
+
+/**
+ * background producer of ready-to-train minibatches.
+ *
+ * producer threads copy the samples of each batch (through an optional
+ * per-sample transform) and encode the targets as vectors into a fixed ring
+ * of prefetch batch buffers, so after start() nothing is allocated per batch
+ * and the training thread only waits when the producers fall behind.
+ *
+ * the order of epoch e and the transforms of batch k of the run draw from
+ * random_streams keyed by (stream, e) and (stream, k), and batches are
+ * delivered in order, so the result follows set_random_seed and does not
+ * depend on the number of producers. the samples are referenced, not
+ * copied: in and t must outlive the loader.
+ **/
+template <typename T>
+class data_loader {
+public:
+    // writes the prepared copy of src into dst. dst is sized like the input
+    // at first and keeps the size the transform leaves between batches
+    typedef std::function<void(const vec_t& src, vec_t& dst, random_stream& rng)> transform_func;
+    // writes the target vector of a training signal into dst
+    typedef std::function<void(const T& t, vec_t& dst)> encode_func;
+
+    data_loader(const std::vector<vec_t>& in, const std::vector<T>& t, const loader_config& cfg = loader_config())
+        : in_(in), t_(t), cfg_(cfg), stop_(false), started_(false), next_seq_(0), consumed_(0), delivered_(0) {
+        if (in.size() != t.size())
+            throw nn_error("number of training data must be equal to label data");
+        if (in.empty() || cfg_.batch_size == 0 || cfg_.epochs < 0)
+            throw nn_error("data_loader needs data, a batch size and a number of epochs");
+        cfg_.num_producers = std::max(1, cfg_.num_producers);
+        cfg_.prefetch = std::max<size_t>(1, cfg_.prefetch);
+        batches_per_epoch_ = (in.size() + cfg_.batch_size - 1) / cfg_.batch_size;
+        total_ = batches_per_epoch_ * static_cast<size_t>(cfg_.epochs);
+    }
+
+    data_loader(const data_loader&) = delete;
+    data_loader& operator = (const data_loader&) = delete;
+
+    ~data_loader() { stop(); }
+
+    ///< per-sample preparation (normalization, augmentation ...), run on the producers
+    void set_transform(transform_func f) {
+        if (started_) throw nn_error("data_loader already started");
+        transform_ = f;
+    }
+
+    /**
+     * allocate the batch buffers and start the producers. target_dim is the
+     * size of the vectors written by encode
+     **/
+    void start(encode_func encode, size_t target_dim) {
+        if (started_) throw nn_error("data_loader already started");
+        encode_ = encode;
+        slots_.resize(cfg_.prefetch);
+        for (auto& s : slots_) {
+            s.ready = false;
+            s.batch.in.assign(cfg_.batch_size, vec_t(in_[0].size()));
+            s.batch.t.assign(cfg_.batch_size, vec_t(target_dim));
+        }
+        started_ = true;
+        for (int i = 0; i < cfg_.num_producers; i++)
+            producers_.emplace_back([this] { produce(); });
+    }
+
+    /**
+     * the next batch in order, nullptr after the last one. the batch stays
+     * valid until the following call, which hands its buffer back
+     **/
+    const minibatch* next() {
+        if (!started_) throw nn_error("data_loader not started");
+        std::unique_lock<std::mutex> lock(mtx_);
+        if (delivered_ > consumed_) {
+            slots_[consumed_ % slots_.size()].ready = false;
+            consumed_++;
+            free_.notify_all();
+        }
+        if (consumed_ == total_) return nullptr;
+
+        slot& s = slots_[consumed_ % slots_.size()];
+        ready_.wait(lock, [&] { return s.ready || error_; });
+        if (error_) std::rethrow_exception(error_);
+        delivered_++;
+        return &s.batch;
+    }
+
+    size_t batches_per_epoch() const { return batches_per_epoch_; }
+    size_t num_batches() const { return total_; }
+    const std::vector<vec_t>& inputs() const { return in_; }
+    const std::vector<T>& targets() const { return t_; }
+    const loader_config& config() const { return cfg_; }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            stop_ = true;
+        }
+        free_.notify_all();
+        for (auto& p : producers_) p.join();
+        producers_.clear();
+    }
+
+private:
+    struct slot {
+        minibatch batch;
+        bool ready;
+    };
+
+    void produce() {
+        std::vector<size_t> order;
+        int order_epoch = -1;
+
+        try {
+            for (;;) {
+                const size_t seq = next_seq_++;
+                if (seq >= total_) return;
+
+                // the slot is free once batch seq - prefetch has been handed back
+                slot& s = slots_[seq % slots_.size()];
+                {
+                    std::unique_lock<std::mutex> lock(mtx_);
+                    free_.wait(lock, [&] { return stop_ || seq < consumed_ + slots_.size(); });
+                    if (stop_) return;
+                }
+
+                const int epoch = static_cast<int>(seq / batches_per_epoch_);
+                if (epoch != order_epoch) {
+                    shuffled_order(epoch, order);
+                    order_epoch = epoch;
+                }
+                fill(s.batch, seq, order);
+
+                {
+                    std::lock_guard<std::mutex> lock(mtx_);
+                    s.ready = true;
+                }
+                ready_.notify_all();
+            }
+        } catch (...) {
+            {
+                std::lock_guard<std::mutex> lock(mtx_);
+                if (!error_) error_ = std::current_exception();
+            }
+            ready_.notify_all();
+        }
+    }
+
+    // sample order of an epoch, the same on every producer
+    void shuffled_order(int epoch, std::vector<size_t>& order) const {
+        order.resize(in_.size());
+        std::iota(order.begin(), order.end(), size_t(0));
+        if (!cfg_.shuffle) return;
+        random_stream rng(detail::keyed_stream_id(cfg_.stream, 0), static_cast<uint32_t>(epoch));
+        for (size_t i = order.size() - 1; i > 0; i--)
+            std::swap(order[i], order[rng.uniform_int<size_t>(0, i)]);
+    }
+
+    void fill(minibatch& b, size_t seq, const std::vector<size_t>& order) const {
+        const size_t index = seq % batches_per_epoch_;
+        const size_t begin = index * cfg_.batch_size;
+        const size_t n = std::min(cfg_.batch_size, in_.size() - begin);
+
+        random_stream rng(detail::keyed_stream_id(cfg_.stream, 1), static_cast<uint32_t>(seq));
+
+        for (size_t k = 0; k < n; k++) {
+            const size_t i = order[begin + k];
+            if (transform_) {
+                transform_(in_[i], b.in[k], rng);
+            } else {
+                b.in[k].assign(in_[i].begin(), in_[i].end());
+            }
+            encode_(t_[i], b.t[k]);
+        }
+        b.size = n;
+        b.epoch = static_cast<int>(seq / batches_per_epoch_);
+        b.index = index;
+    }
+
+    const std::vector<vec_t>& in_;
+    const std::vector<T>& t_;
+    loader_config cfg_;
+    size_t batches_per_epoch_;
+    size_t total_;
+    transform_func transform_;
+    encode_func encode_;
+
+    std::vector<slot> slots_;
+    std::vector<std::thread> producers_;
+    std::mutex mtx_;
+    std::condition_variable ready_;
+    std::condition_variable free_;
+    std::exception_ptr error_;
+    bool stop_;
+    bool started_;
+    std::atomic<size_t> next_seq_;
+    size_t consumed_;  // batches handed back by the consumer
+    size_t delivered_; // batches returned by next()
+};
+
+} // namespace tiny_cnn
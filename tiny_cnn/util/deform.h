@@ -25,7 +25,12 @@
     SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 #pragma once
+#include <cmath>
+#include <algorithm>
+#include <cstdint>
+#include <vector>
 #include "tiny_cnn/util/util.h"
+#include "tiny_cnn/util/scratch_arena.h"
 
 namespace tiny_cnn {
 
@@ -36,5 +41,224 @@ inline vec_t corrupt(vec_t&& in, float_t corruption_level, float_t min_value) {
     return in;
 }
 
+/**
+ * random on-the-fly augmentation of images stored as vec_t
+ * (width x height x channels, channel-major as in the convolutional layers).
+ *
+ * every random choice is drawn from the random_stream passed by the
+ * caller, so the object itself is read-only while augmenting: it can be
+ * used as the transform of a data_loader (one stream per batch) or augment
+ * a whole set in parallel with apply(). the enabled steps run in this order:
+ * crop/shift, horizontal flip, elastic distortion, gaussian noise, corruption
+ **/
+class augmentation {
+public:
+    augmentation(cnn_size_t width, cnn_size_t height, cnn_size_t channels, float_t background = float_t(0))
+        : in_w_(width), in_h_(height), channels_(channels), out_w_(width), out_h_(height), pad_(0),
+          background_(background), flip_(0), alpha_(0), sigma_(0), noise_(0), corruption_(0), corrupt_value_(0) {}
+
+    /**
+     * take a random out_width x out_height window whose origin may lie up to
+     * pad pixels outside the image (uncovered pixels are background).
+     * with the input size and pad > 0 this is a random shift
+     **/
+    augmentation& crop(cnn_size_t out_width, cnn_size_t out_height, cnn_size_t pad = 0) {
+        if (out_width > in_w_ + 2 * pad || out_height > in_h_ + 2 * pad)
+            throw nn_error("crop window larger than the padded image");
+        out_w_ = out_width;
+        out_h_ = out_height;
+        pad_ = pad;
+        return *this;
+    }
+
+    ///< shift by up to max_shift pixels in each direction
+    augmentation& shift(cnn_size_t max_shift) {
+        return crop(in_w_, in_h_, max_shift);
+    }
+
+    ///< mirror left-right with probability p
+    augmentation& flip(float_t p = float_t(0.5)) {
+        flip_ = p;
+        return *this;
+    }
+
+    /**
+     * elastic distortion (Simard et al., 2003): a random displacement field,
+     * smoothed by a gaussian of width sigma and scaled by alpha pixels
+     **/
+    augmentation& elastic(float_t alpha, float_t sigma) {
+        alpha_ = alpha;
+        sigma_ = sigma;
+        return *this;
+    }
+
+    ///< additive gaussian noise
+    augmentation& noise(float_t sigma) {
+        noise_ = sigma;
+        return *this;
+    }
+
+    ///< set each value to min_value with probability level (see corrupt)
+    augmentation& corruption(float_t level, float_t min_value) {
+        corruption_ = level;
+        corrupt_value_ = min_value;
+        return *this;
+    }
+
+    cnn_size_t out_width() const { return out_w_; }
+    cnn_size_t out_height() const { return out_h_; }
+    size_t out_size() const { return size_t(out_w_) * out_h_ * channels_; }
+
+    ///< augmented copy of src in dst (resized to out_size())
+    void operator () (const vec_t& src, vec_t& dst, random_stream& rng) const {
+        if (src.size() != size_t(in_w_) * in_h_ * channels_)
+            throw nn_error("augmentation: input size mismatch");
+        dst.resize(out_size());
+
+        random_crop(src, dst, rng);
+        if (flip_ > float_t(0) && draw(rng) < flip_)
+            mirror(dst);
+        if (alpha_ > float_t(0))
+            distort(dst, rng);
+        if (noise_ > float_t(0)) {
+            const double sigma = to_double(noise_);
+            for (auto& v : dst) v += float_t(rng.gaussian(0.0, sigma));
+        }
+        if (corruption_ > float_t(0)) {
+            for (auto& v : dst)
+                if (draw(rng) < corruption_) v = corrupt_value_;
+        }
+    }
+
+    /**
+     * augment every sample of src into dst (resized to src.size()) in
+     * parallel. sample i draws from the random_stream keyed by (stream, i),
+     * so the result follows set_random_seed and does not depend on the
+     * number of threads
+     **/
+    void apply(const std::vector<vec_t>& src, std::vector<vec_t>& dst, uint32_t stream = 0) const {
+        dst.resize(src.size());
+        for_i(src.size(), [&](int i) {
+            random_stream rng(detail::keyed_stream_id(stream, 2), static_cast<uint32_t>(i));
+            (*this)(src[i], dst[i], rng);
+        }, 1);
+    }
+
+private:
+    template <typename T>
+    static double to_double(T v) { return static_cast<double>(v); }
+
+    static float_t draw(random_stream& rng) {
+        return float_t(rng.next_double());
+    }
+
+    void random_crop(const vec_t& src, vec_t& dst, random_stream& rng) const {
+        // the origin ranges over [-pad, in + pad - out], so the window can
+        // leave the image on either side (crop() guarantees a non-empty range)
+        const int pad = int(pad_);
+        const int x0 = rng.uniform_int(-pad, int(in_w_) + pad - int(out_w_));
+        const int y0 = rng.uniform_int(-pad, int(in_h_) + pad - int(out_h_));
+
+        for (cnn_size_t c = 0; c < channels_; c++) {
+            const float_t* in = &src[size_t(c) * in_w_ * in_h_];
+            float_t* out = &dst[size_t(c) * out_w_ * out_h_];
+            for (cnn_size_t y = 0; y < out_h_; y++) {
+                const int sy = y0 + int(y);
+                for (cnn_size_t x = 0; x < out_w_; x++) {
+                    const int sx = x0 + int(x);
+                    const bool inside = sx >= 0 && sy >= 0 && sx < int(in_w_) && sy < int(in_h_);
+                    out[y * out_w_ + x] = inside ? in[sy * in_w_ + sx] : background_;
+                }
+            }
+        }
+    }
+
+    void mirror(vec_t& img) const {
+        for (cnn_size_t c = 0; c < channels_; c++)
+            for (cnn_size_t y = 0; y < out_h_; y++) {
+                float_t* row = &img[(size_t(c) * out_h_ + y) * out_w_];
+                std::reverse(row, row + out_w_);
+            }
+    }
+
+    void distort(vec_t& img, random_stream& rng) const {
+        const size_t area = size_t(out_w_) * out_h_;
+        scratch_scope scratch;
+        double* dx = scratch.allocate<double>(area);
+        double* dy = scratch.allocate<double>(area);
+        double* tmp = scratch.allocate<double>(area);
+        float_t* orig = scratch.allocate<float_t>(img.size());
+
+        for (size_t i = 0; i < area; i++) {
+            dx[i] = 2 * rng.next_double() - 1;
+            dy[i] = 2 * rng.next_double() - 1;
+        }
+        smooth(dx, tmp);
+        smooth(dy, tmp);
+
+        std::copy(img.begin(), img.end(), orig);
+        const double alpha = to_double(alpha_);
+
+        for (cnn_size_t y = 0; y < out_h_; y++) {
+            for (cnn_size_t x = 0; x < out_w_; x++) {
+                const size_t i = size_t(y) * out_w_ + x;
+                const double sx = x + alpha * dx[i];
+                const double sy = y + alpha * dy[i];
+                for (cnn_size_t c = 0; c < channels_; c++)
+                    img[c * area + i] = bilinear(&orig[c * area], sx, sy);
+            }
+        }
+    }
+
+    // separable gaussian blur of a width x height field
+    void smooth(double* f, double* tmp) const {
+        const double sigma = to_double(sigma_);
+        if (sigma <= 0) return;
+        const int radius = std::min(static_cast<int>(std::ceil(3 * sigma)), 31);
+        double k[63];
+        double sum = 0;
+        for (int i = -radius; i <= radius; i++)
+            sum += (k[i + radius] = std::exp(-i * i / (2 * sigma * sigma)));
+        for (int i = 0; i <= 2 * radius; i++) k[i] /= sum;
+
+        const int w = int(out_w_), h = int(out_h_);
+        for (int y = 0; y < h; y++)
+            for (int x = 0; x < w; x++) {
+                double v = 0;
+                for (int i = -radius; i <= radius; i++)
+                    v += k[i + radius] * f[y * w + std::min(std::max(x + i, 0), w - 1)];
+                tmp[y * w + x] = v;
+            }
+        for (int y = 0; y < h; y++)
+            for (int x = 0; x < w; x++) {
+                double v = 0;
+                for (int i = -radius; i <= radius; i++)
+                    v += k[i + radius] * tmp[std::min(std::max(y + i, 0), h - 1) * w + x];
+                f[y * w + x] = v;
+            }
+    }
+
+    float_t bilinear(const float_t* plane, double sx, double sy) const {
+        const int x = static_cast<int>(std::floor(sx));
+        const int y = static_cast<int>(std::floor(sy));
+        const double fx = sx - x, fy = sy - y;
+
+        auto at = [&](int px, int py) {
+            return (px < 0 || py < 0 || px >= int(out_w_) || py >= int(out_h_))
+                ? to_double(background_) : to_double(plane[py * int(out_w_) + px]);
+        };
+        return float_t((1 - fy) * ((1 - fx) * at(x, y)     + fx * at(x + 1, y))
+                     +      fy  * ((1 - fx) * at(x, y + 1) + fx * at(x + 1, y + 1)));
+    }
+
+    cnn_size_t in_w_, in_h_, channels_;
+    cnn_size_t out_w_, out_h_, pad_;
+    float_t background_;
+    float_t flip_;
+    float_t alpha_, sigma_;
+    float_t noise_;
+    float_t corruption_, corrupt_value_;
+};
+
 
 } // namespace tiny_cnn
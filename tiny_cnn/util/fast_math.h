@@ -0,0 +1,314 @@
+/******************************************************************************
+ *  Copyright (c) 2016, Xilinx, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  1.  Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *  2.  Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *  3.  Neither the name of the copyright holder nor the names of its
+ *      contributors may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ *  OR BUSINESS INTERRUPTION). HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ *  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ *  ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *****************************************************************************/
+#pragma once
+#if defined(CNN_USE_SSE) || defined(CNN_USE_AVX)
+#include <immintrin.h>
+#endif
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include "tiny_cnn/util/util.h"
+
+namespace tiny_cnn {
+
+/**
+ * accuracy of the transcendental functions used by the activations
+ **/
+enum class math_accuracy {
+    exact, ///< std::exp and friends
+    high,  ///< vectorized approximations, error around 1e-6
+    low    ///< shorter polynomials, error around 1e-3
+};
+
+namespace fast_math {
+namespace detail {
+
+// register traits for the kernels below, in the style of vectorize::detail
+
+struct float_scalar {
+    typedef float register_type;
+    enum {
+        unroll_size = 1
+    };
+    static register_type set1(float x) { return x; }
+    static register_type loadu(const float* px) { return *px; }
+    static void storeu(float* px, register_type v) { *px = v; }
+    static register_type add(register_type a, register_type b) { return a + b; }
+    static register_type sub(register_type a, register_type b) { return a - b; }
+    static register_type mul(register_type a, register_type b) { return a * b; }
+    static register_type div(register_type a, register_type b) { return a / b; }
+    static register_type min(register_type a, register_type b) { return a < b ? a : b; }
+    static register_type max(register_type a, register_type b) { return a > b ? a : b; }
+    static register_type round(register_type a) { return std::floor(a + 0.5f); }
+    static register_type abs(register_type a) { return std::fabs(a); }
+    static register_type copysign(register_type mag, register_type sgn) { return std::copysign(mag, sgn); }
+    static register_type select_less(register_type a, register_type b, register_type t, register_type f) { return a < b ? t : f; }
+
+    // 2^n for integral n in [-126, 127]
+    static register_type pow2i(register_type n) {
+        uint32_t bits = static_cast<uint32_t>(static_cast<int32_t>(n) + 127) << 23;
+        float r;
+        std::memcpy(&r, &bits, sizeof(r));
+        return r;
+    }
+};
+
+#if defined(CNN_USE_SSE) || defined(CNN_USE_AVX)
+
+struct float_sse {
+    typedef __m128 register_type;
+    enum {
+        unroll_size = 4
+    };
+    static register_type set1(float x) { return _mm_set1_ps(x); }
+    static register_type loadu(const float* px) { return _mm_loadu_ps(px); }
+    static void storeu(float* px, register_type v) { _mm_storeu_ps(px, v); }
+    static register_type add(register_type a, register_type b) { return _mm_add_ps(a, b); }
+    static register_type sub(register_type a, register_type b) { return _mm_sub_ps(a, b); }
+    static register_type mul(register_type a, register_type b) { return _mm_mul_ps(a, b); }
+    static register_type div(register_type a, register_type b) { return _mm_div_ps(a, b); }
+    static register_type min(register_type a, register_type b) { return _mm_min_ps(a, b); }
+    static register_type max(register_type a, register_type b) { return _mm_max_ps(a, b); }
+    static register_type round(register_type a) { return _mm_cvtepi32_ps(_mm_cvtps_epi32(a)); }
+    static register_type abs(register_type a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+    static register_type copysign(register_type mag, register_type sgn) {
+        const __m128 sign = _mm_set1_ps(-0.0f);
+        return _mm_or_ps(_mm_andnot_ps(sign, mag), _mm_and_ps(sign, sgn));
+    }
+    static register_type select_less(register_type a, register_type b, register_type t, register_type f) {
+        const __m128 m = _mm_cmplt_ps(a, b);
+        return _mm_or_ps(_mm_and_ps(m, t), _mm_andnot_ps(m, f));
+    }
+    static register_type pow2i(register_type n) {
+        __m128i e = _mm_add_epi32(_mm_cvtps_epi32(n), _mm_set1_epi32(127));
+        return _mm_castsi128_ps(_mm_slli_epi32(e, 23));
+    }
+};
+
+#endif // CNN_USE_SSE || CNN_USE_AVX
+
+#ifdef CNN_USE_AVX
+
+struct float_avx {
+    typedef __m256 register_type;
+    enum {
+        unroll_size = 8
+    };
+    static register_type set1(float x) { return _mm256_set1_ps(x); }
+    static register_type loadu(const float* px) { return _mm256_loadu_ps(px); }
+    static void storeu(float* px, register_type v) { _mm256_storeu_ps(px, v); }
+    static register_type add(register_type a, register_type b) { return _mm256_add_ps(a, b); }
+    static register_type sub(register_type a, register_type b) { return _mm256_sub_ps(a, b); }
+    static register_type mul(register_type a, register_type b) { return _mm256_mul_ps(a, b); }
+    static register_type div(register_type a, register_type b) { return _mm256_div_ps(a, b); }
+    static register_type min(register_type a, register_type b) { return _mm256_min_ps(a, b); }
+    static register_type max(register_type a, register_type b) { return _mm256_max_ps(a, b); }
+    static register_type round(register_type a) { return _mm256_round_ps(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+    static register_type abs(register_type a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+    static register_type copysign(register_type mag, register_type sgn) {
+        const __m256 sign = _mm256_set1_ps(-0.0f);
+        return _mm256_or_ps(_mm256_andnot_ps(sign, mag), _mm256_and_ps(sign, sgn));
+    }
+    static register_type select_less(register_type a, register_type b, register_type t, register_type f) {
+        return _mm256_blendv_ps(f, t, _mm256_cmp_ps(a, b, _CMP_LT_OQ));
+    }
+    static register_type pow2i(register_type n) {
+        __m256i i = _mm256_cvtps_epi32(n);
+#ifdef __AVX2__
+        i = _mm256_slli_epi32(_mm256_add_epi32(i, _mm256_set1_epi32(127)), 23);
+#else
+        // AVX1 has no 256-bit integer arithmetic, shift the two halves separately
+        const __m128i bias = _mm_set1_epi32(127);
+        __m128i lo = _mm_slli_epi32(_mm_add_epi32(_mm256_castsi256_si128(i), bias), 23);
+        __m128i hi = _mm_slli_epi32(_mm_add_epi32(_mm256_extractf128_si256(i, 1), bias), 23);
+        i = _mm256_insertf128_si256(_mm256_castsi128_si256(lo), hi, 1);
+#endif
+        return _mm256_castsi256_ps(i);
+    }
+};
+
+typedef float_avx float_best;
+#elif defined(CNN_USE_SSE)
+typedef float_sse float_best;
+#endif // CNN_USE_AVX
+
+/**
+ * e^x by range reduction x = n*ln2 + r, |r| <= ln2/2, and a polynomial for e^r.
+ * the high accuracy polynomial is the one of cephes expf (relative error ~1e-7),
+ * the low accuracy one is the cubic taylor polynomial (relative error ~6e-4).
+ * inputs are clamped to [-87, 88], so the result never overflows to inf
+ **/
+template <typename V>
+inline typename V::register_type exp(typename V::register_type x, bool high) {
+    typedef typename V::register_type reg;
+    x = V::max(V::min(x, V::set1(88.0f)), V::set1(-87.0f));
+
+    const reg n = V::round(V::mul(x, V::set1(1.44269504088896341f)));
+    reg r = V::sub(x, V::mul(n, V::set1(0.693359375f)));
+    r = V::sub(r, V::mul(n, V::set1(-2.12194440e-4f)));
+
+    reg p;
+    if (high) {
+        p = V::set1(1.9875691500e-4f);
+        p = V::add(V::mul(p, r), V::set1(1.3981999507e-3f));
+        p = V::add(V::mul(p, r), V::set1(8.3334519073e-3f));
+        p = V::add(V::mul(p, r), V::set1(4.1665795894e-2f));
+        p = V::add(V::mul(p, r), V::set1(1.6666665459e-1f));
+        p = V::add(V::mul(p, r), V::set1(5.0000001201e-1f));
+        p = V::add(V::add(V::mul(p, V::mul(r, r)), r), V::set1(1.0f));
+    } else {
+        p = V::set1(1.0f / 6.0f);
+        p = V::add(V::mul(p, r), V::set1(0.5f));
+        p = V::add(V::mul(p, r), V::set1(1.0f));
+        p = V::add(V::mul(p, r), V::set1(1.0f));
+    }
+    return V::mul(p, V::pow2i(n));
+}
+
+/**
+ * tanh(x) = sign(x) * (1 - e) / (1 + e), e = e^(-2|x|). in high accuracy mode
+ * small |x| use the odd polynomial of cephes tanhf, which keeps the relative
+ * error small near zero where (1 - e) cancels
+ **/
+template <typename V>
+inline typename V::register_type tanh(typename V::register_type x, bool high) {
+    typedef typename V::register_type reg;
+    const reg one = V::set1(1.0f);
+    const reg ax = V::abs(x);
+    const reg e = exp<V>(V::mul(ax, V::set1(-2.0f)), high);
+    reg t = V::div(V::sub(one, e), V::add(one, e));
+
+    if (high) {
+        const reg s = V::mul(ax, ax);
+        reg p = V::set1(-5.70498872745e-3f);
+        p = V::add(V::mul(p, s), V::set1(2.06390887954e-2f));
+        p = V::add(V::mul(p, s), V::set1(-5.37397155531e-2f));
+        p = V::add(V::mul(p, s), V::set1(1.33314422036e-1f));
+        p = V::add(V::mul(p, s), V::set1(-3.33332819422e-1f));
+        p = V::add(V::mul(V::mul(p, s), ax), ax);
+        t = V::select_less(ax, V::set1(0.625f), p, t);
+    }
+    return V::copysign(t, x);
+}
+
+// 1 / (1 + e^-x)
+template <typename V>
+inline typename V::register_type sigmoid(typename V::register_type x, bool high) {
+    const typename V::register_type one = V::set1(1.0f);
+    return V::div(one, V::add(one, exp<V>(V::sub(V::set1(0.0f), x), high)));
+}
+
+struct exp_op {
+    template <typename V>
+    static typename V::register_type apply(typename V::register_type x, bool high) { return exp<V>(x, high); }
+};
+
+struct tanh_op {
+    template <typename V>
+    static typename V::register_type apply(typename V::register_type x, bool high) { return tanh<V>(x, high); }
+};
+
+struct sigmoid_op {
+    template <typename V>
+    static typename V::register_type apply(typename V::register_type x, bool high) { return sigmoid<V>(x, high); }
+};
+
+// y[i] = Op(x[i]) with the widest registers available, scalar tail. x == y is allowed.
+// without SSE/AVX the scalar kernels are not faster than libm, so nothing is approximated
+template <typename Op>
+inline bool transform(const float* x, float* y, size_t n, math_accuracy accuracy) {
+#if defined(CNN_USE_SSE) || defined(CNN_USE_AVX)
+    if (accuracy == math_accuracy::exact) return false;
+
+    const bool high = accuracy == math_accuracy::high;
+    const size_t step = float_best::unroll_size;
+    size_t i = 0;
+
+    for (; i + step <= n; i += step)
+        float_best::storeu(&y[i], Op::template apply<float_best>(float_best::loadu(&x[i]), high));
+    for (; i < n; i++)
+        y[i] = Op::template apply<float_scalar>(x[i], high);
+    return true;
+#else
+    CNN_UNREFERENCED_PARAMETER(x);
+    CNN_UNREFERENCED_PARAMETER(y);
+    CNN_UNREFERENCED_PARAMETER(n);
+    CNN_UNREFERENCED_PARAMETER(accuracy);
+    return false;
+#endif
+}
+
+} // namespace detail
+
+/**
+ * approximate y[i] = f(x[i]) for i in [0, n). x and y may be the same array.
+ * these return false without touching y when accuracy is exact, when T has
+ * no approximation (e.g. fixed_point) or when neither CNN_USE_SSE nor
+ * CNN_USE_AVX is enabled; the caller then uses the exact function
+ **/
+///< whether exp, tanh and sigmoid approximate for T at this accuracy
+template <typename T>
+inline bool available(math_accuracy) { return false; }
+
+template <>
+inline bool available<float>(math_accuracy accuracy) {
+#if defined(CNN_USE_SSE) || defined(CNN_USE_AVX)
+    return accuracy != math_accuracy::exact;
+#else
+    CNN_UNREFERENCED_PARAMETER(accuracy);
+    return false;
+#endif
+}
+
+template <typename T>
+inline bool exp(const T*, T*, size_t, math_accuracy) { return false; }
+
+template <typename T>
+inline bool tanh(const T*, T*, size_t, math_accuracy) { return false; }
+
+template <typename T>
+inline bool sigmoid(const T*, T*, size_t, math_accuracy) { return false; }
+
+inline bool exp(const float* x, float* y, size_t n, math_accuracy accuracy) {
+    return detail::transform<detail::exp_op>(x, y, n, accuracy);
+}
+
+inline bool tanh(const float* x, float* y, size_t n, math_accuracy accuracy) {
+    return detail::transform<detail::tanh_op>(x, y, n, accuracy);
+}
+
+inline bool sigmoid(const float* x, float* y, size_t n, math_accuracy accuracy) {
+    return detail::transform<detail::sigmoid_op>(x, y, n, accuracy);
+}
+
+} // namespace fast_math
+} // namespace tiny_cnn
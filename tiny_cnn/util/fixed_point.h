@@ -0,0 +1,293 @@
+/******************************************************************************
+ *  Copyright (c) 2016, Xilinx, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  1.  Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *  2.  Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *  3.  Neither the name of the copyright holder nor the names of its
+ *      contributors may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ *  OR BUSINESS INTERRUPTION). HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ *  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ *  ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *****************************************************************************/
+#pragma once
+
+// fixed_point -- signed fixed-point number with the same quantization and
+// overflow behavior as the arithmetic of the hardware datapath
+// (equivalent to ap_fixed<IntBits + FracBits, IntBits, Rounding, Overflow>).
+//
+// every operation is carried out exactly on the integer representation, then
+// rounded to FracBits fractional bits and fitted into IntBits + FracBits bits,
+// so a network using fixed_point as float_t (see CNN_USE_FIXED_POINT in
+// config.h) computes bit-exactly what the accelerator computes. sums of
+// products (vectorize::dot, muladd and accumulator in product.h) are kept
+// exact in a wide accumulator and rounded once, as in the MAC units.
+// transcendental functions (exp, log, sqrt...) are evaluated in double
+// precision and quantized.
+
+#include <cstdint>
+#include <cmath>
+#include <limits>
+#include <istream>
+#include <ostream>
+#include <type_traits>
+
+namespace tiny_cnn {
+
+enum class fixed_rounding {
+    truncate,  // drop bits, i.e. round towards -inf (AP_TRN)
+    round,     // round half up (AP_RND)
+    round_even // round half to even (AP_RND_CONV)
+};
+
+enum class fixed_overflow {
+    wrap,      // keep the low bits (AP_WRAP)
+    saturate   // clamp to the representable range (AP_SAT)
+};
+
+namespace detail {
+
+// rounds v / 2^shift to an integer
+template <fixed_rounding R>
+inline int64_t round_shift(int64_t v, int shift) {
+    // multiplications, as left shifts of negative values are undefined
+    if (shift <= 0) return v * (int64_t(1) << -shift);
+    const int64_t q = v >> shift;             // floor
+    const int64_t r = v - q * (int64_t(1) << shift); // 0 <= r < 2^shift
+    const int64_t half = int64_t(1) << (shift - 1);
+
+    switch (R) {
+    case fixed_rounding::round:      return q + (r >= half ? 1 : 0);
+    case fixed_rounding::round_even: return q + ((r > half || (r == half && (q & 1))) ? 1 : 0);
+    default:                         return q;
+    }
+}
+
+// rounds num / den to an integer
+template <fixed_rounding R>
+inline int64_t round_div(int64_t num, int64_t den) {
+    if (den < 0) { num = -num; den = -den; }
+    int64_t q = num / den;
+    int64_t r = num % den;
+    if (r < 0) { q--; r += den; }             // floor, 0 <= r < den
+
+    switch (R) {
+    case fixed_rounding::round:      return q + (2 * r >= den ? 1 : 0);
+    case fixed_rounding::round_even: return q + ((2 * r > den || (2 * r == den && (q & 1))) ? 1 : 0);
+    default:                         return q;
+    }
+}
+
+} // namespace detail
+
+template <int IntBits, int FracBits,
+          fixed_rounding Rounding = fixed_rounding::round,
+          fixed_overflow Overflow = fixed_overflow::saturate>
+class fixed_point {
+public:
+    static_assert(IntBits >= 1, "IntBits includes the sign bit and must be at least 1");
+    static_assert(FracBits >= 0, "FracBits must not be negative");
+    static_assert(IntBits + FracBits <= 32, "fixed_point is limited to 32 bits");
+
+    typedef int32_t raw_type;
+
+    enum {
+        int_bits = IntBits,
+        frac_bits = FracBits,
+        width = IntBits + FracBits
+    };
+
+    static const int64_t raw_max = (int64_t(1) << (width - 1)) - 1;
+    static const int64_t raw_min = -(int64_t(1) << (width - 1));
+
+    fixed_point() : raw_(0) {}
+
+    template <typename T, typename = typename std::enable_if<std::is_integral<T>::value>::type, typename = void>
+    fixed_point(T v) : raw_(fit(static_cast<int64_t>(v) * (int64_t(1) << FracBits))) {}
+
+    template <typename T, typename = typename std::enable_if<std::is_floating_point<T>::value>::type>
+    fixed_point(T v) : raw_(from_double(static_cast<double>(v))) {}
+
+    static fixed_point from_raw(int64_t raw) {
+        fixed_point f;
+        f.raw_ = fit(raw);
+        return f;
+    }
+
+    raw_type raw() const { return raw_; }
+
+    double to_double() const { return std::ldexp(static_cast<double>(raw_), -FracBits); }
+
+    explicit operator double() const { return to_double(); }
+    explicit operator float() const { return static_cast<float>(to_double()); }
+    explicit operator int() const { return static_cast<int>(detail::round_shift<fixed_rounding::truncate>(raw_, FracBits)); }
+    explicit operator long long() const { return detail::round_shift<fixed_rounding::truncate>(raw_, FracBits); }
+    explicit operator unsigned int() const { return static_cast<unsigned int>(static_cast<int>(*this)); }
+    explicit operator unsigned long() const { return static_cast<unsigned long>(static_cast<long long>(*this)); }
+    explicit operator bool() const { return raw_ != 0; }
+
+    fixed_point operator - () const { return from_raw(-int64_t(raw_)); }
+    fixed_point operator + () const { return *this; }
+
+    fixed_point& operator += (const fixed_point& rhs) { raw_ = fit(int64_t(raw_) + rhs.raw_); return *this; }
+    fixed_point& operator -= (const fixed_point& rhs) { raw_ = fit(int64_t(raw_) - rhs.raw_); return *this; }
+    fixed_point& operator *= (const fixed_point& rhs) { raw_ = mul_raw(raw_, rhs.raw_); return *this; }
+    fixed_point& operator /= (const fixed_point& rhs) { raw_ = div_raw(raw_, rhs.raw_); return *this; }
+
+    // non-template friends, so that mixed expressions like 2 * x or x > 0 convert implicitly
+    friend fixed_point operator + (fixed_point lhs, const fixed_point& rhs) { return lhs += rhs; }
+    friend fixed_point operator - (fixed_point lhs, const fixed_point& rhs) { return lhs -= rhs; }
+    friend fixed_point operator * (fixed_point lhs, const fixed_point& rhs) { return lhs *= rhs; }
+    friend fixed_point operator / (fixed_point lhs, const fixed_point& rhs) { return lhs /= rhs; }
+
+    friend bool operator == (const fixed_point& lhs, const fixed_point& rhs) { return lhs.raw_ == rhs.raw_; }
+    friend bool operator != (const fixed_point& lhs, const fixed_point& rhs) { return lhs.raw_ != rhs.raw_; }
+    friend bool operator <  (const fixed_point& lhs, const fixed_point& rhs) { return lhs.raw_ <  rhs.raw_; }
+    friend bool operator <= (const fixed_point& lhs, const fixed_point& rhs) { return lhs.raw_ <= rhs.raw_; }
+    friend bool operator >  (const fixed_point& lhs, const fixed_point& rhs) { return lhs.raw_ >  rhs.raw_; }
+    friend bool operator >= (const fixed_point& lhs, const fixed_point& rhs) { return lhs.raw_ >= rhs.raw_; }
+
+    /**
+     * fit a raw value with FracBits fractional bits into the word width
+     **/
+    static raw_type fit(int64_t v) {
+        if (Overflow == fixed_overflow::saturate) {
+            if (v > raw_max) return static_cast<raw_type>(raw_max);
+            if (v < raw_min) return static_cast<raw_type>(raw_min);
+            return static_cast<raw_type>(v);
+        }
+        // wrap: keep the low width bits and sign-extend
+        const uint64_t mask = (width == 64) ? ~uint64_t(0) : ((uint64_t(1) << width) - 1);
+        uint64_t u = static_cast<uint64_t>(v) & mask;
+        if (u & (uint64_t(1) << (width - 1))) u |= ~mask;
+        return static_cast<raw_type>(static_cast<int64_t>(u));
+    }
+
+    /**
+     * round a raw value with 'frac' fractional bits (e.g. a product or an
+     * accumulator) to FracBits and fit it into the word width
+     **/
+    static raw_type requantize(int64_t v, int frac) {
+        return fit(detail::round_shift<Rounding>(v, frac - FracBits));
+    }
+
+private:
+    static raw_type from_double(double v) {
+        if (v != v) return 0;
+        const double scaled = std::ldexp(v, FracBits);
+        if (scaled >= 9.2e18) return fit(std::numeric_limits<int64_t>::max());
+        if (scaled <= -9.2e18) return fit(std::numeric_limits<int64_t>::min());
+
+        const double fl = std::floor(scaled);
+        const double r = scaled - fl;
+        int64_t q = static_cast<int64_t>(fl);
+        switch (Rounding) {
+        case fixed_rounding::round:      q += (r >= 0.5) ? 1 : 0; break;
+        case fixed_rounding::round_even: q += (r > 0.5 || (r == 0.5 && (q & 1))) ? 1 : 0; break;
+        default: break;
+        }
+        return fit(q);
+    }
+
+    static raw_type mul_raw(int64_t a, int64_t b) {
+        return requantize(a * b, 2 * FracBits);
+    }
+
+    static raw_type div_raw(int64_t a, int64_t b) {
+        if (b == 0) return fit(a >= 0 ? raw_max : raw_min);
+        return fit(detail::round_div<Rounding>(a * (int64_t(1) << FracBits), b));
+    }
+
+    raw_type raw_;
+};
+
+template <int I, int F, fixed_rounding R, fixed_overflow O>
+const int64_t fixed_point<I, F, R, O>::raw_max;
+
+template <int I, int F, fixed_rounding R, fixed_overflow O>
+const int64_t fixed_point<I, F, R, O>::raw_min;
+
+template <typename T>
+struct is_fixed_point : std::false_type {};
+
+template <int I, int F, fixed_rounding R, fixed_overflow O>
+struct is_fixed_point<fixed_point<I, F, R, O>> : std::true_type {};
+
+// math functions, found by unqualified calls inside tiny_cnn
+
+#define CNN_FIXED_POINT_UNARY_FUNC(name) \
+template <int I, int F, fixed_rounding R, fixed_overflow O> \
+inline fixed_point<I, F, R, O> name(const fixed_point<I, F, R, O>& x) { \
+    return fixed_point<I, F, R, O>(std::name(x.to_double())); \
+}
+
+CNN_FIXED_POINT_UNARY_FUNC(exp)
+CNN_FIXED_POINT_UNARY_FUNC(log)
+CNN_FIXED_POINT_UNARY_FUNC(sqrt)
+CNN_FIXED_POINT_UNARY_FUNC(tanh)
+
+#undef CNN_FIXED_POINT_UNARY_FUNC
+
+template <int I, int F, fixed_rounding R, fixed_overflow O>
+inline fixed_point<I, F, R, O> abs(const fixed_point<I, F, R, O>& x) {
+    return x.raw() < 0 ? -x : x;
+}
+
+template <int I, int F, fixed_rounding R, fixed_overflow O>
+inline fixed_point<I, F, R, O> pow(const fixed_point<I, F, R, O>& x, const fixed_point<I, F, R, O>& y) {
+    return fixed_point<I, F, R, O>(std::pow(x.to_double(), y.to_double()));
+}
+
+template <int I, int F, fixed_rounding R, fixed_overflow O>
+inline std::ostream& operator << (std::ostream& os, const fixed_point<I, F, R, O>& x) {
+    return os << x.to_double();
+}
+
+template <int I, int F, fixed_rounding R, fixed_overflow O>
+inline std::istream& operator >> (std::istream& is, fixed_point<I, F, R, O>& x) {
+    double v;
+    if (is >> v) x = fixed_point<I, F, R, O>(v);
+    return is;
+}
+
+} // namespace tiny_cnn
+
+namespace std {
+
+template <int I, int F, tiny_cnn::fixed_rounding R, tiny_cnn::fixed_overflow O>
+class numeric_limits<tiny_cnn::fixed_point<I, F, R, O>> {
+    typedef tiny_cnn::fixed_point<I, F, R, O> T;
+public:
+    static const bool is_specialized = true;
+    static const bool is_signed = true;
+    static const bool is_integer = false;
+    static const bool is_exact = true;
+    static const int digits = I + F - 1;
+    static const int digits10 = (I + F - 1) * 301 / 1000 + 1;
+    static const int max_digits10 = digits10 + 2;
+    static T min() { return T::from_raw(1); }
+    static T lowest() { return T::from_raw(T::raw_min); }
+    static T max() { return T::from_raw(T::raw_max); }
+    static T epsilon() { return T::from_raw(1); }
+};
+
+} // namespace std
@@ -0,0 +1,344 @@
+/******************************************************************************
+ *  Copyright (c) 2016, Xilinx, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  1.  Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *  2.  Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *  3.  Neither the name of the copyright holder nor the names of its
+ *      contributors may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ *  OR BUSINESS INTERRUPTION). HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ *  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ *  ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *****************************************************************************/
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include "nn_error.h"
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace tiny_cnn {
+
+/**
+ * placement of the large buffers behind vec_t (weights, per-worker outputs,
+ * deltas and gradients). buffers of at least min_bytes are mapped directly
+ * with mmap when the policy asks for anything beyond the default:
+ *   transparent_huge  2MB aligned and madvise(MADV_HUGEPAGE)
+ *   explicit_huge     MAP_HUGETLB from the reserved pool, transparent_huge
+ *                     if the pool is empty
+ *   prefault          touch every page when the buffer is allocated
+ *   lock              mlock the buffer (best effort, see RLIMIT_MEMLOCK)
+ *
+ * set from code with set_memory_policy(), or from the environment (read
+ * once, at the first large allocation):
+ *   CNN_HUGE_PAGES   "transparent" or "explicit"
+ *   CNN_PREFAULT     1 to pre-fault
+ *   CNN_MLOCK        1 to lock
+ *
+ * only buffers allocated afterwards follow a new policy; network::reallocate_buffers()
+ * moves the buffers of an existing network. only linux is supported, other
+ * systems always use the default allocation
+ **/
+struct memory_policy {
+    enum class pages {
+        normal,
+        transparent_huge,
+        explicit_huge
+    };
+
+    memory_policy()
+        : page_mode(pages::normal), prefault(false), lock(false), min_bytes(2 * 1024 * 1024) {}
+
+    pages page_mode;
+    bool prefault;
+    bool lock;
+    size_t min_bytes; ///< smaller buffers always use the default allocation
+
+    bool is_default() const {
+        return page_mode == pages::normal && !prefault && !lock;
+    }
+
+    static pages parse_pages(const std::string& s) {
+        if (s.empty() || s == "0" || s == "normal") return pages::normal;
+        if (s == "1" || s == "transparent") return pages::transparent_huge;
+        if (s == "explicit") return pages::explicit_huge;
+        throw nn_error("invalid huge page mode: " + s);
+    }
+
+    static memory_policy from_env() {
+        memory_policy p;
+
+        if (const char* pages = std::getenv("CNN_HUGE_PAGES"))
+            p.page_mode = parse_pages(pages);
+        if (const char* prefault = std::getenv("CNN_PREFAULT"))
+            p.prefault = std::atoi(prefault) != 0;
+        if (const char* lock = std::getenv("CNN_MLOCK"))
+            p.lock = std::atoi(lock) != 0;
+
+        return p;
+    }
+};
+
+namespace detail {
+
+/**
+ * a buffer handed out by aligned_allocator that did not come from the default
+ * allocator: either mapped for the policy (length > 0, unmapped when freed)
+ * or carved from a region of an owner such as a NUMA-bound mapping (length 0)
+ **/
+struct foreign_buffer {
+    size_t bytes;  ///< as requested by the allocator
+    size_t length;
+    std::shared_ptr<void> owner;
+};
+
+// size class of a borrowed buffer, see memory_policy_state::borrowed_classes
+inline int size_class(size_t bytes) {
+    return static_cast<int>((bytes / sizeof(float)) % 64);
+}
+
+struct memory_policy_state {
+    memory_policy_state()
+        : count(0), smallest_mapped(std::numeric_limits<size_t>::max()), borrowed_classes(0) {
+        std::fill(borrowed_count, borrowed_count + 64, size_t(0));
+        set(memory_policy::from_env());
+    }
+
+    void set(const memory_policy& p) {
+        policy = p;
+        min_bytes.store(p.is_default() ? std::numeric_limits<size_t>::max() : std::max<size_t>(p.min_bytes, 1));
+    }
+
+    memory_policy policy;
+    std::atomic<size_t> min_bytes;              ///< fast check without the lock, max if default
+    std::mutex mutex;
+    std::unordered_map<void*, foreign_buffer> buffers;
+
+    // summary of the buffers, so that frees of the default allocator are
+    // told apart without the lock: only frees of the size of a mapped buffer
+    // or of the size class of a borrowed one look into the map
+    std::atomic<size_t>   count;            ///< live foreign buffers
+    std::atomic<size_t>   smallest_mapped;  ///< bytes of the smallest mapped one, max if none
+    std::atomic<uint64_t> borrowed_classes; ///< bit size_class(bytes) of the borrowed ones
+
+    void add(void* p, const foreign_buffer& b) {
+        std::lock_guard<std::mutex> lock(mutex);
+        buffers[p] = b;
+        if (b.length) mapped_sizes.insert(b.bytes);
+        else borrowed_count[size_class(b.bytes)]++;
+        update_summary();
+    }
+
+    ///< false if a buffer of this size is certainly from the default allocator
+    bool may_hold(size_t bytes) const {
+        if (count.load(std::memory_order_relaxed) == 0) return false;
+        if (bytes >= smallest_mapped.load(std::memory_order_relaxed)) return true;
+        return (borrowed_classes.load(std::memory_order_relaxed) >> size_class(bytes)) & 1;
+    }
+
+    // with the lock held
+    bool remove(void* p, foreign_buffer& b) {
+        auto it = buffers.find(p);
+        if (it == buffers.end()) return false;
+        b = it->second;
+        buffers.erase(it);
+        if (b.length) mapped_sizes.erase(mapped_sizes.find(b.bytes));
+        else borrowed_count[size_class(b.bytes)]--;
+        update_summary();
+        return true;
+    }
+
+private:
+    void update_summary() {
+        uint64_t classes = 0;
+        for (int i = 0; i < 64; i++)
+            if (borrowed_count[i]) classes |= uint64_t(1) << i;
+        count.store(buffers.size(), std::memory_order_relaxed);
+        smallest_mapped.store(mapped_sizes.empty() ? std::numeric_limits<size_t>::max() : *mapped_sizes.begin(),
+                              std::memory_order_relaxed);
+        borrowed_classes.store(classes, std::memory_order_relaxed);
+    }
+
+    std::multiset<size_t> mapped_sizes;
+    size_t borrowed_count[64];
+};
+
+inline memory_policy_state& policy_state() {
+    static memory_policy_state state;
+    return state;
+}
+
+#if defined(__linux__)
+
+const size_t huge_page_size = 2 * 1024 * 1024;
+
+inline void* map_aligned(size_t length, int extra_flags) {
+    // over-allocate and trim, so the buffer starts on a huge page boundary
+    const size_t total = length + huge_page_size;
+    void* p = mmap(nullptr, total, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | extra_flags, -1, 0);
+    if (p == MAP_FAILED) return nullptr;
+
+    const uintptr_t base = reinterpret_cast<uintptr_t>(p);
+    const uintptr_t start = (base + huge_page_size - 1) & ~(huge_page_size - 1);
+    if (start > base) munmap(p, start - base);
+    if (base + total > start + length) munmap(reinterpret_cast<void*>(start + length), base + total - start - length);
+    return reinterpret_cast<void*>(start);
+}
+
+/**
+ * allocate a buffer of the given size as the current policy says,
+ * nullptr if the default allocator should be used
+ **/
+inline void* policy_allocate(size_t bytes) {
+    memory_policy_state& st = policy_state();
+    if (bytes < st.min_bytes.load(std::memory_order_relaxed)) return nullptr;
+
+    memory_policy policy;
+    {
+        std::lock_guard<std::mutex> lock(st.mutex);
+        policy = st.policy;
+    }
+    if (policy.is_default() || bytes < policy.min_bytes) return nullptr;
+
+    const size_t length = (bytes + huge_page_size - 1) & ~(huge_page_size - 1);
+    void* p = nullptr;
+
+#ifdef MAP_HUGETLB
+    if (policy.page_mode == memory_policy::pages::explicit_huge) {
+        p = mmap(nullptr, length, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | (policy.prefault ? MAP_POPULATE : 0), -1, 0);
+        if (p == MAP_FAILED) p = nullptr;
+    }
+#endif
+    if (!p) {
+        p = map_aligned(length, 0);
+        if (!p) return nullptr;
+#ifdef MADV_HUGEPAGE
+        if (policy.page_mode != memory_policy::pages::normal)
+            madvise(p, length, MADV_HUGEPAGE);
+#endif
+        if (policy.prefault) {
+            // after madvise, so that the faults bring in huge pages
+            const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+            volatile char* c = static_cast<char*>(p);
+            for (size_t i = 0; i < length; i += page) c[i] = 0;
+        }
+    }
+    if (policy.lock) mlock(p, length);
+
+    st.add(p, foreign_buffer{ bytes, length, nullptr });
+    return p;
+}
+
+#else
+
+inline void* policy_allocate(size_t) { return nullptr; }
+
+#endif // __linux__
+
+/**
+ * release a buffer allocated by policy_allocate (whatever the policy is now)
+ * or carved from a placement_region. returns false for buffers of the
+ * default allocator
+ **/
+inline bool policy_deallocate(void* p, size_t bytes) {
+    memory_policy_state& st = policy_state();
+    if (!st.may_hold(bytes)) return false;
+
+    foreign_buffer b;
+    {
+        std::lock_guard<std::mutex> lock(st.mutex);
+        if (!st.remove(p, b)) return false;
+    }
+#if defined(__linux__)
+    if (b.length) munmap(p, b.length);
+#endif
+    return true;
+}
+
+/**
+ * memory that the allocations of this thread are carved from while it is
+ * active (see placement_scope). the buffers are borrowed: owner keeps the
+ * region alive until the last of them is freed
+ **/
+struct placement_region {
+    char* cur;
+    char* end;
+    std::shared_ptr<void> owner;
+};
+
+inline placement_region*& active_region() {
+    static thread_local placement_region* r = nullptr;
+    return r;
+}
+
+// nullptr if no region is active or it has no room left
+inline void* place_in_region(size_t bytes, size_t alignment) {
+    placement_region* r = active_region();
+    if (!r || bytes == 0) return nullptr;
+
+    const uintptr_t cur = reinterpret_cast<uintptr_t>(r->cur);
+    char* p = reinterpret_cast<char*>((cur + alignment - 1) / alignment * alignment);
+    if (p > r->end || bytes > static_cast<size_t>(r->end - p)) return nullptr;
+    r->cur = p + bytes;
+    policy_state().add(p, foreign_buffer{ bytes, 0, r->owner });
+    return p;
+}
+
+struct placement_scope {
+    explicit placement_scope(placement_region* r) { active_region() = r; }
+    ~placement_scope() { active_region() = nullptr; }
+    placement_scope(const placement_scope&) = delete;
+    placement_scope& operator = (const placement_scope&) = delete;
+};
+
+} // namespace detail
+
+/**
+ * the policy in effect, initialized from the environment
+ **/
+inline memory_policy global_memory_policy() {
+    detail::memory_policy_state& st = detail::policy_state();
+    std::lock_guard<std::mutex> lock(st.mutex);
+    return st.policy;
+}
+
+inline void set_memory_policy(const memory_policy& policy) {
+    detail::memory_policy_state& st = detail::policy_state();
+    std::lock_guard<std::mutex> lock(st.mutex);
+    st.set(policy);
+}
+
+} // namespace tiny_cnn
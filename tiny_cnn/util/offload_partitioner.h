@@ -0,0 +1,314 @@
+/******************************************************************************
+ *  Copyright (c) 2016, Xilinx, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  1.  Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *  2.  Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *  3.  Neither the name of the copyright holder nor the names of its
+ *      contributors may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ *  OR BUSINESS INTERRUPTION). HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ *  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ *  ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *****************************************************************************/
+#pragma once
+
+// offload partitioner -- decides which layers of a network run on the host and
+// which ones run on the accelerator, and rewrites the network accordingly.
+//
+// host and accelerator work on different samples at the same time, so the
+// achievable frame interval is max(host time, accelerator time). every
+// contiguous run of offloaded layers ("segment") becomes a single
+// offloaded_layer and pays one call latency plus the transfer of its input
+// and output.
+
+#include "tiny_cnn/network.h"
+#include "tiny_cnn/layers/offloaded_layer.h"
+#include "tiny_cnn/io/display.h"
+#include <cmath>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace tiny_cnn {
+
+/**
+ * accelerator cost of one layer type
+ **/
+struct accel_layer_cost {
+    accel_layer_cost() : connections_per_us(1), resource_per_param(0), resource_fixed(0) {}
+    accel_layer_cost(double throughput, double per_param, double fixed = 0)
+        : connections_per_us(throughput), resource_per_param(per_param), resource_fixed(fixed) {}
+
+    double connections_per_us;  // connection_size() processed per microsecond
+    double resource_per_param;  // resources (LUTs, BRAM bits...) per parameter
+    double resource_fixed;      // resources per layer instance
+};
+
+/**
+ * user-supplied model of the accelerator.
+ * layer types (layer_base::layer_type()) without an entry are never offloaded
+ **/
+struct accel_cost_model {
+    accel_cost_model() : call_latency_us(0), bandwidth_mbps(0),
+        resource_budget(std::numeric_limits<double>::max()) {}
+
+    std::map<std::string, accel_layer_cost> layer_costs;
+    double call_latency_us;  // fixed cost of each offload call
+    double bandwidth_mbps;   // host<->accelerator bandwidth in MB/s, 0 for unlimited
+    double resource_budget;  // total resources available on the accelerator
+
+    bool can_offload(const layer_base& l) const {
+        return layer_costs.count(l.layer_type()) != 0;
+    }
+
+    double compute_us(const layer_base& l) const {
+        return double(l.connection_size()) / layer_costs.at(l.layer_type()).connections_per_us;
+    }
+
+    double resources(const layer_base& l) const {
+        const accel_layer_cost& c = layer_costs.at(l.layer_type());
+        return c.resource_fixed + c.resource_per_param * double(l.param_size());
+    }
+
+    double transfer_us(cnn_size_t elements) const {
+        return bandwidth_mbps > 0 ? double(elements) * sizeof(float_t) / bandwidth_mbps : 0.0;
+    }
+};
+
+/**
+ * result of the partitioning
+ **/
+struct offload_partition {
+    offload_partition() : host_us(0), accel_us(0), resources(0) {}
+
+    std::vector<bool> offloaded;                     // per layer (excluding input layer)
+    std::vector<std::pair<size_t, size_t>> segments; // [first, last] layer index of each offloaded run
+    double host_us;                                  // host time per sample
+    double accel_us;                                 // accelerator time per sample, incl. transfers
+    double resources;                                // accelerator resources used
+
+    double interval_us() const { return std::max(host_us, accel_us); }
+    double throughput() const { return interval_us() > 0 ? 1e6 / interval_us() : 0.0; } // samples/s
+};
+
+/**
+ * measure the CPU time of each layer of a network (microseconds per sample).
+ * the cost of layer i is taken as time(i..tail) - time(i+1..tail), because
+ * forward_propagation always runs through to the tail
+ **/
+template <typename L, typename O>
+std::vector<double> measure_layer_costs(network<L, O>& net, const vec_t& in, int iterations = 10) {
+    const size_t n = net.depth();
+    std::vector<double> suffix(n + 1, 0.0), cost(n);
+
+    net.set_netphase(net_phase::test);
+    net.predict(in); // warm-up, also fills the outputs used as inputs below
+
+    for (size_t i = n; i-- > 0;) {
+        const vec_t& x = (i == 0) ? in : net[i - 1]->output(0);
+        timer t;
+        for (int k = 0; k < iterations; k++)
+            net[i]->forward_propagation(x, 0);
+        suffix[i] = t.elapsed() * 1e6 / iterations;
+    }
+    for (size_t i = 0; i < n; i++)
+        cost[i] = std::max(0.0, suffix[i] - suffix[i + 1]);
+    return cost;
+}
+
+namespace detail {
+
+struct partition_candidate {
+    double host_us;
+    double accel_us;
+    double resources;
+    std::vector<bool> offloaded;
+};
+
+inline bool dominates(const partition_candidate& a, const partition_candidate& b) {
+    return a.host_us <= b.host_us && a.accel_us <= b.accel_us && a.resources <= b.resources;
+}
+
+inline void insert_pareto(std::vector<partition_candidate>& set, partition_candidate&& c) {
+    for (const auto& e : set)
+        if (dominates(e, c)) return;
+    set.erase(std::remove_if(set.begin(), set.end(),
+        [&](const partition_candidate& e) { return dominates(c, e); }), set.end());
+    set.push_back(std::move(c));
+}
+
+inline bool is_conv_layer(const layer_base& l) {
+    return l.layer_type() == "conv" || l.layer_type() == "bnn_conv_layer";
+}
+
+// OffloadConvParams of a conv layer, which must be the kind they can describe:
+// square window, stride 1, no padding
+inline OffloadConvParams offload_conv_params(const layer_base& l, size_t index) {
+    const index3d<cnn_size_t> in = l.in_shape(), out = l.out_shape();
+    const size_t area = in.depth_ ? l.fan_in_size() / in.depth_ : 0;
+    const cnn_size_t window = static_cast<cnn_size_t>(std::lround(std::sqrt(double(area))));
+
+    if (window == 0 || size_t(window) * window * in.depth_ != l.fan_in_size() ||
+        in.width_ < window || in.height_ < window ||
+        out.width_ != in.width_ - window + 1 || out.height_ != in.height_ - window + 1)
+        throw nn_error(format_str("apply_offload_partition: conv layer %u cannot be offloaded "
+                                  "(needs a square window, stride 1 and no padding)", static_cast<unsigned int>(index)));
+
+    OffloadConvParams p;
+    p.in_width = in.width_;
+    p.in_height = in.height_;
+    p.window_size = window;
+    p.in_channels = in.depth_;
+    p.out_channels = out.depth_;
+    return p;
+}
+
+} // namespace detail
+
+/**
+ * find the host/accelerator partition with the highest pipeline throughput.
+ *
+ * walks the chain once and keeps, for "previous layer on host" and "previous
+ * layer offloaded", only the pareto-optimal (host time, accelerator time,
+ * resources) candidates, so the search stays cheap even for deep networks.
+ *
+ * @param cpu_us per-layer host cost, e.g. from measure_layer_costs
+ **/
+template <typename L, typename O>
+offload_partition partition_offload(network<L, O>& net, const std::vector<double>& cpu_us,
+                                    const accel_cost_model& model) {
+    const size_t n = net.depth();
+    if (cpu_us.size() != n)
+        throw nn_error(format_str("partition_offload: %u layer costs given, network has %u layers",
+                                  static_cast<unsigned int>(cpu_us.size()), static_cast<unsigned int>(n)));
+
+    using detail::partition_candidate;
+    std::vector<partition_candidate> on_host(1), on_accel;
+    on_host[0].host_us = on_host[0].accel_us = on_host[0].resources = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        const layer_base& l = *net[i];
+        std::vector<partition_candidate> next_host, next_accel;
+
+        // layer i on the host
+        for (int prev = 0; prev < 2; prev++) {
+            for (const auto& c : prev ? on_accel : on_host) {
+                partition_candidate h = c;
+                h.host_us += cpu_us[i];
+                if (prev) h.accel_us += model.transfer_us(l.in_size()); // close segment
+                h.offloaded.push_back(false);
+                detail::insert_pareto(next_host, std::move(h));
+            }
+        }
+
+        // layer i on the accelerator
+        if (model.can_offload(l)) {
+            const double res = model.resources(l);
+            for (int prev = 0; prev < 2; prev++) {
+                for (const auto& c : prev ? on_accel : on_host) {
+                    if (c.resources + res > model.resource_budget) continue;
+                    partition_candidate a = c;
+                    a.accel_us += model.compute_us(l);
+                    if (!prev) a.accel_us += model.call_latency_us + model.transfer_us(l.in_size()); // open segment
+                    a.resources += res;
+                    a.offloaded.push_back(true);
+                    detail::insert_pareto(next_accel, std::move(a));
+                }
+            }
+        }
+
+        on_host.swap(next_host);
+        on_accel.swap(next_accel);
+    }
+
+    // a segment reaching the tail still has to send its result back
+    for (auto& c : on_accel)
+        c.accel_us += model.transfer_us(net.out_dim());
+
+    const partition_candidate* best = nullptr;
+    for (int last = 0; last < 2; last++) {
+        for (const auto& c : last ? on_accel : on_host) {
+            if (!best || std::max(c.host_us, c.accel_us) < std::max(best->host_us, best->accel_us))
+                best = &c;
+        }
+    }
+
+    offload_partition p;
+    p.host_us = best->host_us;
+    p.accel_us = best->accel_us;
+    p.resources = best->resources;
+    p.offloaded = best->offloaded;
+
+    for (size_t i = 0; i < n; i++) {
+        if (!p.offloaded[i]) continue;
+        if (i > 0 && p.offloaded[i - 1]) p.segments.back().second = i;
+        else p.segments.emplace_back(i, i);
+    }
+    return p;
+}
+
+/**
+ * build a network in which each offloaded segment of p is replaced by one
+ * offloaded_layer. segment k gets offloadID first_offload_id + k.
+ *
+ * a segment starting with a conv layer passes that layer's OffloadConvParams
+ * to the handler. conv layers anywhere else in a segment cannot be described
+ * to the handler, so such partitions are refused with nn_error.
+ *
+ * @attention host layers are shared with (and re-linked away from) src,
+ *            so src must not be used afterwards
+ **/
+template <typename L, typename O>
+network<L, O> apply_offload_partition(network<L, O>& src, const offload_partition& p,
+                                      OffloadHandler handler, unsigned int first_offload_id = 0) {
+    if (p.offloaded.size() != src.depth())
+        throw nn_error("apply_offload_partition: partition does not match network");
+
+    std::vector<std::shared_ptr<layer_base>> chain;
+    size_t seg = 0;
+    for (size_t i = 0; i < src.depth(); i++) {
+        if (!p.offloaded[i]) {
+            chain.push_back(src.shared_at(i));
+            continue;
+        }
+        const std::pair<size_t, size_t>& s = p.segments[seg];
+        for (size_t k = s.first + 1; k <= s.second; k++)
+            if (detail::is_conv_layer(*src[k]))
+                throw nn_error(format_str("apply_offload_partition: conv layer %u is not the first layer "
+                                          "of its offloaded segment", static_cast<unsigned int>(k)));
+
+        auto off = std::make_shared<offloaded_layer>(src[s.first]->in_size(), src[s.second]->out_size(),
+                                                     handler, first_offload_id + static_cast<unsigned int>(seg));
+        if (detail::is_conv_layer(*src[s.first]))
+            off->set_conv_params(detail::offload_conv_params(*src[s.first], s.first));
+        chain.push_back(off);
+        i = s.second;
+        seg++;
+    }
+
+    network<L, O> dst(src.name());
+    for (auto& l : chain)
+        dst.add(l);
+    return dst;
+}
+
+} // namespace tiny_cnn
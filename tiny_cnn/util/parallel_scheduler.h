@@ -0,0 +1,152 @@
+/******************************************************************************
+ *  Copyright (c) 2016, Xilinx, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  1.  Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *  2.  Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *  3.  Neither the name of the copyright holder nor the names of its
+ *      contributors may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ *  OR BUSINESS INTERRUPTION). HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ *  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ *  ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *****************************************************************************/
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "tiny_cnn/util/util.h"
+#include "tiny_cnn/layers/layers.h"
+
+namespace tiny_cnn {
+
+/**
+ * how the work of a layer is spread over the threads
+ **/
+enum class layer_parallelism {
+    none,        // serial
+    samples,     // serial inside the layer, samples of the batch run concurrently
+    intra_layer  // the layer's loops (over channels or outputs) are split
+};
+
+struct layer_schedule {
+    layer_parallelism mode;
+    int grainsize;        // minimum number of loop iterations per chunk
+    double cost_us;       // estimated serial time per sample
+};
+
+/**
+ * machine parameters of the cost model, per thread
+ **/
+struct parallel_cost_model {
+    parallel_cost_model()
+        : flops_per_us(2000.0), bytes_per_us(4000.0), dispatch_us(2.0), min_chunk_us(4.0) {}
+
+    double flops_per_us;  // arithmetic throughput
+    double bytes_per_us;  // memory bandwidth
+    double dispatch_us;   // overhead of one parallel loop
+    double min_chunk_us;  // work below which a chunk is not worth handing out
+};
+
+/**
+ * chooses, per layer and batch size, between parallelizing across the samples
+ * of a batch, inside the layer, or not at all.
+ *
+ * the cost of a layer is estimated from its connections (FLOPs) and the
+ * bytes it touches; measured timings (e.g. from measure_layer_costs) replace
+ * the estimate once given to calibrate(). the samples of a batch keep
+ * min(batch, threads) threads busy; a layer is split internally only if the
+ * threads left per sample can shorten it by more than the dispatch overhead,
+ * with chunks large enough to amortize it.
+ **/
+class parallel_scheduler {
+public:
+    explicit parallel_scheduler(const parallel_cost_model& model = parallel_cost_model())
+        : model_(model) {}
+
+    parallel_cost_model& model() { return model_; }
+
+    /**
+     * use measured forward times (microseconds per sample, one per layer)
+     * instead of the estimate
+     **/
+    void calibrate(const std::vector<double>& forward_us) {
+        measured_us_ = forward_us;
+    }
+
+    ///< estimated serial time of one sample through layer i, forward and backward if training
+    double layer_cost_us(const layers& ls, size_t i, bool training) const {
+        // backward pass costs about twice the forward pass
+        const double passes = training ? 3.0 : 1.0;
+
+        if (i < measured_us_.size() && measured_us_[i] > 0)
+            return measured_us_[i] * passes;
+
+        const layer_base& l = *ls[i];
+        const double flops = 2.0 * l.connection_size() * passes;
+        const double bytes = sizeof(float_t) * (passes * l.param_size() + 2.0 * (l.in_size() + l.out_size()));
+        return flops / model_.flops_per_us + bytes / model_.bytes_per_us;
+    }
+
+    std::vector<layer_schedule> plan(const layers& ls, size_t batch_size, size_t n_threads, bool training = true) const {
+        const size_t threads = std::max<size_t>(1, n_threads);
+        const size_t sample_workers = std::max<size_t>(1, std::min(batch_size, threads));
+        const size_t threads_per_sample = threads / sample_workers;
+
+        std::vector<layer_schedule> s(ls.depth());
+
+        for (size_t i = 0; i < s.size(); i++) {
+            const double cost = layer_cost_us(ls, i, training);
+            const double gain = cost - cost / threads_per_sample;
+
+            s[i].cost_us = cost;
+            s[i].grainsize = 1;
+
+            if (threads_per_sample >= 2 && gain > model_.dispatch_us * threads_per_sample) {
+                s[i].mode = layer_parallelism::intra_layer;
+                s[i].grainsize = std::max(1, static_cast<int>(std::ceil(
+                    parallel_items(*ls[i]) * model_.min_chunk_us / cost)));
+            } else {
+                s[i].mode = sample_workers > 1 ? layer_parallelism::samples : layer_parallelism::none;
+            }
+        }
+        return s;
+    }
+
+    static void apply(layers& ls, const std::vector<layer_schedule>& s) {
+        for (size_t i = 0; i < s.size() && i < ls.depth(); i++) {
+            ls[i]->set_parallelize(s[i].mode == layer_parallelism::intra_layer);
+            ls[i]->set_grainsize(s[i].grainsize);
+        }
+    }
+
+private:
+    // size of the layers' outer parallel loops: channels if there are several, else outputs
+    static double parallel_items(const layer_base& l) {
+        const index3d<cnn_size_t> shape = l.out_shape();
+        return shape.depth_ > 1 ? double(shape.depth_) : double(l.out_size());
+    }
+
+    parallel_cost_model model_;
+    std::vector<double> measured_us_;
+};
+
+} // namespace tiny_cnn
@@ -0,0 +1,120 @@
+/******************************************************************************
+ *  Copyright (c) 2016, Xilinx, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  1.  Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *  2.  Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *  3.  Neither the name of the copyright holder nor the names of its
+ *      contributors may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ *  OR BUSINESS INTERRUPTION). HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ *  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ *  ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *****************************************************************************/
+#pragma once
+#include <algorithm>
+#include <vector>
+#include "tiny_cnn/util/util.h"
+#include "tiny_cnn/util/product.h"
+
+namespace tiny_cnn {
+
+/**
+ * flat view of all trainable parameters of a network.
+ *
+ * every weight / bias vector is registered as a segment at a fixed offset of
+ * one virtual parameter vector, so an optimizer can keep its moments in a
+ * single aligned buffer indexed by that offset (no lookup per vector) and
+ * update the whole network in one parallel pass instead of one for_i per
+ * layer. the parameters and gradients themselves stay owned by the layers.
+ **/
+class parameter_arena {
+public:
+    struct segment {
+        vec_t*       W;      // parameters
+        vec_t*       diff;   // gradients, one vector per worker (CNN_TASK_SIZE)
+        const vec_t* H;      // diagonal of the hessian
+        size_t       offset; // position in the flat parameter vector
+    };
+
+    // number of elements processed by one task of the fused pass
+    static const size_t chunk_size = 4096;
+
+    void clear() {
+        segments_.clear();
+        size_ = 0;
+    }
+
+    void add(vec_t& W, vec_t* diff, const vec_t& H) {
+        if (W.empty()) return;
+        segment s = { &W, diff, &H, size_ };
+        segments_.push_back(s);
+        size_ += W.size();
+    }
+
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    const std::vector<segment>& segments() const { return segments_; }
+
+    /**
+     * merge the gradients of all workers and call
+     * f(W, dW, H, offset, n) once per contiguous run of at most chunk_size
+     * parameters, with the runs processed in parallel. dW is the gradient
+     * summed over worker_size workers and divided by batch_size; it is cleared
+     * (in every worker slot) after f returns.
+     **/
+    template <typename Func>
+    void for_each_run(cnn_size_t worker_size, cnn_size_t batch_size, Func f) const {
+        const int chunks = static_cast<int>((size_ + chunk_size - 1) / chunk_size);
+
+        for_i(chunks > 1, chunks, [&](int c) {
+            size_t pos = static_cast<size_t>(c) * chunk_size;
+            const size_t end = std::min(pos + chunk_size, size_);
+            auto s = std::upper_bound(segments_.begin(), segments_.end(), pos,
+                [](size_t p, const segment& seg) { return p < seg.offset; }) - 1;
+
+            for (; pos < end; ++s) {
+                const size_t local = pos - s->offset;
+                const size_t n = std::min(end, s->offset + s->W->size()) - pos;
+                float_t* dW = &s->diff[0][local];
+
+                for (cnn_size_t i = 1; i < worker_size; i++) {
+                    float_t* src = &s->diff[i][local];
+                    vectorize::reduce<float_t>(src, n, dW);
+                    std::fill(src, src + n, float_t(0));
+                }
+                for (size_t k = 0; k < n; k++)
+                    dW[k] /= batch_size;
+
+                f(&(*s->W)[local], static_cast<const float_t*>(dW), &(*s->H)[local], pos, n);
+
+                std::fill(dW, dW + n, float_t(0));
+                pos += n;
+            }
+        }, 1);
+    }
+
+private:
+    std::vector<segment> segments_;
+    size_t size_ = 0;
+};
+
+} // namespace tiny_cnn
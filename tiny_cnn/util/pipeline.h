@@ -0,0 +1,310 @@
+/******************************************************************************
+ *  Copyright (c) 2016, Xilinx, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  1.  Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *  2.  Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *  3.  Neither the name of the copyright holder nor the names of its
+ *      contributors may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ *  OR BUSINESS INTERRUPTION). HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ *  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ *  ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *****************************************************************************/
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "tiny_cnn/network.h"
+#include "tiny_cnn/util/thread_config.h"
+
+namespace tiny_cnn {
+
+/**
+ * bounded lock-free queue between exactly one producer and one consumer thread.
+ * the elements are kept allocated, so pushing and popping vec_t of a constant
+ * size does not allocate after the first round
+ **/
+template <typename T>
+class spsc_queue {
+public:
+    explicit spsc_queue(size_t capacity)
+        : buf_(capacity + 1), head_(0), tail_(0) {}
+
+    ///< copy v in, returns false if full
+    bool try_push(const T& v) {
+        const size_t t = tail_.load(std::memory_order_relaxed);
+        const size_t next = (t + 1) % buf_.size();
+        if (next == head_.load(std::memory_order_acquire)) return false;
+        buf_[t] = v;
+        tail_.store(next, std::memory_order_release);
+        return true;
+    }
+
+    ///< copy the oldest element into v, returns false if empty
+    bool try_pop(T& v) {
+        const size_t h = head_.load(std::memory_order_relaxed);
+        if (h == tail_.load(std::memory_order_acquire)) return false;
+        v = buf_[h];
+        head_.store((h + 1) % buf_.size(), std::memory_order_release);
+        return true;
+    }
+
+    bool empty() const {
+        return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+    }
+
+private:
+    std::vector<T> buf_;
+    alignas(64) std::atomic<size_t> head_;  // next element to pop, written by the consumer
+    alignas(64) std::atomic<size_t> tail_;  // next free element, written by the producer
+};
+
+/**
+ * split a chain of layers with the given costs into n_stages contiguous
+ * groups with the smallest maximum group cost.
+ * returns the index of the first layer of each stage
+ **/
+inline std::vector<size_t> balance_pipeline(const std::vector<double>& cost, size_t n_stages) {
+    const size_t n = cost.size();
+    n_stages = std::max<size_t>(1, std::min(n_stages, n));
+
+    std::vector<double> prefix(n + 1, 0.0);
+    for (size_t i = 0; i < n; i++) prefix[i + 1] = prefix[i] + cost[i];
+
+    // best[k][i]: smallest max stage cost of the first i layers in k stages
+    const double inf = std::numeric_limits<double>::infinity();
+    std::vector<std::vector<double>> best(n_stages + 1, std::vector<double>(n + 1, inf));
+    std::vector<std::vector<size_t>> cut(n_stages + 1, std::vector<size_t>(n + 1, 0));
+    best[0][0] = 0.0;
+
+    for (size_t k = 1; k <= n_stages; k++) {
+        for (size_t i = k; i <= n; i++) {
+            for (size_t j = k - 1; j < i; j++) {
+                const double c = std::max(best[k - 1][j], prefix[i] - prefix[j]);
+                if (c < best[k][i]) {
+                    best[k][i] = c;
+                    cut[k][i] = j;
+                }
+            }
+        }
+    }
+
+    std::vector<size_t> begin(n_stages);
+    for (size_t k = n_stages, i = n; k > 0; k--) {
+        i = cut[k][i];
+        begin[k - 1] = i;
+    }
+    return begin;
+}
+
+/**
+ * layer-pipelined streaming inference.
+ *
+ * the layers of a network are split into contiguous stages, each run by its
+ * own (optionally pinned) thread on its own worker slot; stages are connected
+ * by spsc_queues. samples pushed in come out in the same order, and once the
+ * pipeline is full the throughput is that of the slowest stage.
+ *
+ * a thread with nothing to do (an idle stage, or push/pop waiting for room or
+ * for a result) spins for a short while and then sleeps until a queue it
+ * waits on changes. an exception thrown by a layer stops the pipeline and is
+ * rethrown by the next push, pop or try_pop.
+ *
+ * while the pipeline exists it owns the network: the chain is cut at the
+ * stage boundaries and intra-layer parallelism is disabled, both are
+ * restored by the destructor.
+ **/
+template <typename L, typename O>
+class pipeline {
+public:
+    /**
+     * @param stage_begin index of the first layer of each stage, starting with 0
+     *                    (e.g. from balance_pipeline)
+     * @param cpus        cpu of each stage's thread, empty to not pin
+     * @param capacity    number of samples each queue can hold
+     **/
+    pipeline(network<L, O>& net, const std::vector<size_t>& stage_begin,
+             const std::vector<int>& cpus = std::vector<int>(), size_t capacity = 16)
+        : net_(net), stop_(false), failed_(false), sleepers_(0)
+    {
+        const size_t n_stages = stage_begin.size();
+        if (n_stages == 0 || stage_begin[0] != 0)
+            throw nn_error("pipeline: the first stage must start at layer 0");
+        if (n_stages > CNN_TASK_SIZE)
+            throw nn_error("pipeline: more stages than worker slots");
+        for (size_t s = 1; s < n_stages; s++)
+            if (stage_begin[s] <= stage_begin[s - 1] || stage_begin[s] >= net.depth())
+                throw nn_error("pipeline: invalid stage boundaries");
+
+        for (size_t i = 0; i < net.depth(); i++) {
+            parallelize_.push_back(net[i]->parallelize());
+            net[i]->set_parallelize(false);
+        }
+
+        for (size_t s = 0; s < n_stages; s++) {
+            stage st;
+            st.first = net[stage_begin[s]];
+            st.last = net[(s + 1 < n_stages ? stage_begin[s + 1] : net.depth()) - 1];
+            st.saved_next = st.last->exchange_next(nullptr);
+            st.out = std::make_shared<spsc_queue<vec_t>>(capacity);
+            stages_.push_back(st);
+        }
+        in_ = std::make_shared<spsc_queue<vec_t>>(capacity);
+
+        for (size_t s = 0; s < n_stages; s++) {
+            threads_.emplace_back([this, s] { run_stage(s); });
+            if (!cpus.empty()) pin_thread(threads_.back(), cpus[s % cpus.size()]);
+        }
+    }
+
+    ~pipeline() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        cond_.notify_all();
+        for (auto& t : threads_) t.join();
+
+        for (auto& st : stages_)
+            st.last->exchange_next(st.saved_next);
+        for (size_t i = 0; i < parallelize_.size(); i++)
+            net_[i]->set_parallelize(parallelize_[i]);
+    }
+
+    pipeline(const pipeline&) = delete;
+    pipeline& operator = (const pipeline&) = delete;
+
+    size_t stages() const { return stages_.size(); }
+
+    ///< feed a sample, waits while the first stage is full
+    void push(const vec_t& in) {
+        if (in.size() != net_.in_dim())
+            data_mismatch(*net_[0], in);
+        wait([&] { return in_->try_push(in); });
+        rethrow_if_failed();
+    }
+
+    ///< get the output of the oldest sample, waits until it is available
+    void pop(vec_t& out) {
+        wait([&] { return stages_.back().out->try_pop(out); });
+        rethrow_if_failed();
+    }
+
+    bool try_pop(vec_t& out) {
+        rethrow_if_failed();
+        if (!stages_.back().out->try_pop(out)) return false;
+        notify();
+        return true;
+    }
+
+private:
+    struct stage {
+        layer_base* first;
+        layer_base* last;
+        layer_base* saved_next;
+        std::shared_ptr<spsc_queue<vec_t>> out;
+    };
+
+    static const int spin_count = 4000;
+
+    void run_stage(size_t s) {
+        spsc_queue<vec_t>& in = (s == 0) ? *in_ : *stages_[s - 1].out;
+        spsc_queue<vec_t>& out = *stages_[s].out;
+        vec_t x;
+
+        try {
+            for (;;) {
+                if (!wait([&] { return in.try_pop(x); })) return;
+                const vec_t& y = stages_[s].first->forward_propagation(x, s);
+                if (!wait([&] { return out.try_push(y); })) return;
+            }
+        } catch (...) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (!error_) error_ = std::current_exception();
+                failed_ = true;
+            }
+            cond_.notify_all();
+        }
+    }
+
+    /**
+     * retry op (a queue operation) until it succeeds, spinning first and
+     * then sleeping until another thread notifies a change. returns false
+     * if the pipeline stopped or failed first
+     **/
+    template <typename Op>
+    bool wait(const Op& op) {
+        for (int spin = 0; spin < spin_count; spin++) {
+            if (op()) {
+                notify();
+                return true;
+            }
+            if (stop_ || failed_) return false;
+            std::this_thread::yield();
+        }
+
+        bool done = false;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            sleepers_.fetch_add(1);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            cond_.wait(lock, [&] { return (done = op()) || stop_ || failed_; });
+            sleepers_.fetch_sub(1);
+        }
+        if (done) notify();
+        return done;
+    }
+
+    // wakes the sleeping threads after a queue operation
+    void notify() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleepers_.load() == 0) return;
+        std::lock_guard<std::mutex> lock(mutex_);
+        cond_.notify_all();
+    }
+
+    void rethrow_if_failed() {
+        if (!failed_) return;
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::rethrow_exception(error_);
+    }
+
+    network<L, O>& net_;
+    std::vector<stage> stages_;
+    std::shared_ptr<spsc_queue<vec_t>> in_;
+    std::vector<bool> parallelize_;
+    std::vector<std::thread> threads_;
+    std::atomic<bool> stop_;
+    std::atomic<bool> failed_;
+    std::atomic<int> sleepers_;   // threads blocked in wait()
+    std::exception_ptr error_;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+};
+
+} // namespace tiny_cnn
@@ -31,6 +31,8 @@
 #include <cstdint>
 #include <cassert>
 #include <numeric>
+#include <type_traits>
+#include "fixed_point.h"
 
 #if defined(_MSC_VER)
 #define VECTORIZE_ALIGN(x) __declspec(align(x))
@@ -278,15 +280,27 @@ inline void reduce_aligned(const typename T::value_type* src, std::size_t  size,
         dst[i] += src[i];
 }
 
-} // namespace detail
-
+// SIMD traits exist only for float/double; other types use the generic one
+// (fixed_point has its own integer kernels below)
+template<typename T, bool = std::is_same<T, float>::value || std::is_same<T, double>::value>
+struct simd_vec_type {
 #if defined(CNN_USE_AVX)
-#define VECTORIZE_TYPE(T) detail::avx<T>
+    typedef avx<T> type;
 #elif defined(CNN_USE_SSE)
-#define VECTORIZE_TYPE(T) detail::sse<T>
+    typedef sse<T> type;
 #else
-#define VECTORIZE_TYPE(T) detail::generic_vec_type<T>
+    typedef generic_vec_type<T> type;
 #endif
+};
+
+template<typename T>
+struct simd_vec_type<T, false> {
+    typedef generic_vec_type<T> type;
+};
+
+} // namespace detail
+
+#define VECTORIZE_TYPE(T) typename detail::simd_vec_type<T>::type
 
 // dst[i] += c * src[i]
 template<typename T>
@@ -306,6 +320,62 @@ T dot(const T* s1, const T* s2, std::size_t  size) {
         return detail::dot_product_nonaligned<VECTORIZE_TYPE(T)>(s1, s2, size);
 }
 
+/**
+ * sum of products in the precision of the hardware datapath: the value type
+ * itself for floating point. fixed_point (specialization below) keeps the
+ * exact sum of the raw products and rounds once in result()
+ **/
+template<typename T>
+struct accumulator {
+    accumulator() : v_(0) {}
+    void mac(const T& a, const T& b) { v_ += a * b; }
+    void add(const T& x) { v_ += x; }
+    void add(const accumulator& rhs) { v_ += rhs.v_; }
+    T result() const { return v_; }
+private:
+    T v_;
+};
+
+template<int I, int F, tiny_cnn::fixed_rounding R, tiny_cnn::fixed_overflow O>
+struct accumulator<tiny_cnn::fixed_point<I, F, R, O>> {
+    typedef tiny_cnn::fixed_point<I, F, R, O> value_type;
+
+    accumulator() : v_(0) {}
+    void mac(const value_type& a, const value_type& b) { v_ += int64_t(a.raw()) * b.raw(); }
+    void add(const value_type& x) { v_ += int64_t(x.raw()) * (int64_t(1) << F); }
+    void add(const accumulator& rhs) { v_ += rhs.v_; }
+    value_type result() const { return value_type::from_raw(value_type::requantize(v_, 2 * F)); }
+private:
+    int64_t v_; // 2F fractional bits
+};
+
+// fixed_point kernels work on the raw integers and accumulate in 64 bits like
+// the MAC units of the accelerator (HLS/FINN): a product or sum is rounded and
+// fitted into the word only once, when it is written back
+
+// dst[i] += c * src[i]
+template<int I, int F, tiny_cnn::fixed_rounding R, tiny_cnn::fixed_overflow O>
+void muladd(const tiny_cnn::fixed_point<I, F, R, O>* src, tiny_cnn::fixed_point<I, F, R, O> c,
+            std::size_t size, tiny_cnn::fixed_point<I, F, R, O>* dst) {
+    typedef tiny_cnn::fixed_point<I, F, R, O> T;
+    const int64_t factor = c.raw();
+    for (std::size_t i = 0; i < size; i++) {
+        const int64_t v = int64_t(dst[i].raw()) * (int64_t(1) << F) + src[i].raw() * factor;
+        dst[i] = T::from_raw(T::requantize(v, 2 * F));
+    }
+}
+
+// sum(s1[i] * s2[i])
+template<int I, int F, tiny_cnn::fixed_rounding R, tiny_cnn::fixed_overflow O>
+tiny_cnn::fixed_point<I, F, R, O> dot(const tiny_cnn::fixed_point<I, F, R, O>* s1,
+                                      const tiny_cnn::fixed_point<I, F, R, O>* s2, std::size_t size) {
+    typedef tiny_cnn::fixed_point<I, F, R, O> T;
+    int64_t sum = 0;
+    for (std::size_t i = 0; i < size; i++)
+        sum += int64_t(s1[i].raw()) * s2[i].raw();
+    return T::from_raw(T::requantize(sum, 2 * F));
+}
+
 /// dst[i] += src[i]
 template<typename T>
 void reduce(const T* src, std::size_t  size, T* dst) {
@@ -315,4 +385,83 @@ void reduce(const T* src, std::size_t  size, T* dst) {
         return detail::reduce_nonaligned<VECTORIZE_TYPE(T)>(src, size, dst);
 }
 
+namespace detail {
+
+// dst[pos..pos+n) |= bits
+inline void or_bits(uint64_t* dst, std::size_t pos, uint64_t bits, std::size_t n) {
+    const std::size_t w = pos / 64, b = pos % 64;
+    dst[w] |= bits << b;
+    if (b + n > 64)
+        dst[w + 1] |= bits >> (64 - b);
+}
+
+} // namespace detail
+
+/// dst[i] = src[i] > threshold ? sign : -sign
+template<typename T>
+void threshold_sign(const T* src, T threshold, T sign, std::size_t size, T* dst) {
+    const T neg = -sign;
+    for (std::size_t i = 0; i < size; i++)
+        dst[i] = src[i] > threshold ? sign : neg;
+}
+
+/// bit (first + i) of dst |= (src[i] > threshold) ^ invert
+template<typename T>
+void threshold_bits(const T* src, T threshold, bool invert, std::size_t size, uint64_t* dst, std::size_t first) {
+    for (std::size_t i = 0; i < size; i++) {
+        if ((src[i] > threshold) != invert)
+            dst[(first + i) / 64] |= uint64_t(1) << ((first + i) % 64);
+    }
+}
+
+#if defined(CNN_USE_AVX)
+
+inline void threshold_sign(const float* src, float threshold, float sign, std::size_t size, float* dst) {
+    const __m256 t = _mm256_set1_ps(threshold), p = _mm256_set1_ps(sign), n = _mm256_set1_ps(-sign);
+    std::size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        __m256 gt = _mm256_cmp_ps(_mm256_loadu_ps(src + i), t, _CMP_GT_OQ);
+        _mm256_storeu_ps(dst + i, _mm256_blendv_ps(n, p, gt));
+    }
+    for (; i < size; i++)
+        dst[i] = src[i] > threshold ? sign : -sign;
+}
+
+inline void threshold_bits(const float* src, float threshold, bool invert, std::size_t size, uint64_t* dst, std::size_t first) {
+    const __m256 t = _mm256_set1_ps(threshold);
+    const uint64_t flip = invert ? 0xff : 0;
+    std::size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t m = uint64_t(_mm256_movemask_ps(_mm256_cmp_ps(_mm256_loadu_ps(src + i), t, _CMP_GT_OQ)));
+        detail::or_bits(dst, first + i, m ^ flip, 8);
+    }
+    threshold_bits<float>(src + i, threshold, invert, size - i, dst, first + i);
+}
+
+#elif defined(CNN_USE_SSE)
+
+inline void threshold_sign(const float* src, float threshold, float sign, std::size_t size, float* dst) {
+    const __m128 t = _mm_set1_ps(threshold), p = _mm_set1_ps(sign), n = _mm_set1_ps(-sign);
+    std::size_t i = 0;
+    for (; i + 4 <= size; i += 4) {
+        __m128 gt = _mm_cmpgt_ps(_mm_loadu_ps(src + i), t);
+        _mm_storeu_ps(dst + i, _mm_or_ps(_mm_and_ps(gt, p), _mm_andnot_ps(gt, n)));
+    }
+    for (; i < size; i++)
+        dst[i] = src[i] > threshold ? sign : -sign;
+}
+
+inline void threshold_bits(const float* src, float threshold, bool invert, std::size_t size, uint64_t* dst, std::size_t first) {
+    const __m128 t = _mm_set1_ps(threshold);
+    const uint64_t flip = invert ? 0xf : 0;
+    std::size_t i = 0;
+    for (; i + 4 <= size; i += 4) {
+        uint64_t m = uint64_t(_mm_movemask_ps(_mm_cmpgt_ps(_mm_loadu_ps(src + i), t)));
+        detail::or_bits(dst, first + i, m ^ flip, 4);
+    }
+    threshold_bits<float>(src + i, threshold, invert, size - i, dst, first + i);
+}
+
+#endif
+
 } // namespace vectorize
@@ -0,0 +1,333 @@
+/******************************************************************************
+ *  Copyright (c) 2016, Xilinx, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  1.  Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *  2.  Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *  3.  Neither the name of the copyright holder nor the names of its
+ *      contributors may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ *  OR BUSINESS INTERRUPTION). HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ *  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ *  ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *****************************************************************************/
+#pragma once
+#if defined(CNN_USE_SSE) || defined(CNN_USE_AVX)
+#include <immintrin.h>
+#endif
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+namespace tiny_cnn {
+
+namespace detail {
+
+/**
+ * Philox4x32-10 counter-based generator
+ *
+ * J K Salmon, M A Moraes, R O Dror and D E Shaw,
+ * Parallel random numbers: as easy as 1, 2, 3, SC 2011.
+ *
+ * maps a 128-bit counter and a 64-bit key to 128 random bits, without
+ * state: any block of any stream can be computed independently
+ **/
+inline void philox4x32(const uint32_t ctr[4], const uint32_t key[2], uint32_t out[4]) {
+    uint32_t c0 = ctr[0], c1 = ctr[1], c2 = ctr[2], c3 = ctr[3];
+    uint32_t k0 = key[0], k1 = key[1];
+
+    for (int r = 0; r < 10; r++) {
+        const uint64_t p0 = uint64_t(0xD2511F53) * c0;
+        const uint64_t p1 = uint64_t(0xCD9E8D57) * c2;
+        const uint32_t n0 = uint32_t(p1 >> 32) ^ c1 ^ k0;
+        const uint32_t n2 = uint32_t(p0 >> 32) ^ c3 ^ k1;
+        c1 = uint32_t(p1);
+        c3 = uint32_t(p0);
+        c0 = n0;
+        c2 = n2;
+        k0 += 0x9E3779B9;
+        k1 += 0xBB67AE85;
+    }
+    out[0] = c0; out[1] = c1; out[2] = c2; out[3] = c3;
+}
+
+inline std::atomic<uint64_t>& random_seed_state() {
+    static std::atomic<uint64_t> seed(1);
+    return seed;
+}
+
+// incremented by set_random_seed, streams restart when it changes
+inline std::atomic<uint32_t>& random_seed_generation() {
+    static std::atomic<uint32_t> generation(0);
+    return generation;
+}
+
+inline uint32_t next_stream_id(bool thread_stream) {
+    static std::atomic<uint32_t> objects(0), threads(0);
+    return thread_stream ? threads++ : objects++;
+}
+
+/**
+ * id of a stream keyed by a position in the data (an epoch, a batch, a
+ * sample) rather than by creation order. the top bit keeps these ids apart
+ * from the counted ones, purpose (< 8) separates the users of one stream
+ **/
+inline uint32_t keyed_stream_id(uint32_t stream, uint32_t purpose) {
+    return 0x80000000u | (purpose << 28) | (stream & 0x0FFFFFFFu);
+}
+
+} // namespace detail
+
+/**
+ * restart every random_stream (including the per-thread ones behind
+ * uniform_rand / gaussian_rand / bernoulli) from the given seed
+ **/
+inline void set_random_seed(uint64_t seed) {
+    detail::random_seed_state() = seed;
+    detail::random_seed_generation()++;
+}
+
+inline uint64_t get_random_seed() {
+    return detail::random_seed_state();
+}
+
+/**
+ * independent stream of random numbers: block n of the stream is
+ * philox(counter = (n, id, substream), key = global seed).
+ *
+ * streams are cheap to create and not shared between threads: give each
+ * worker (or each layer / worker pair) its own, then the numbers drawn do
+ * not depend on the thread scheduling. a default-constructed stream gets a
+ * new id, so streams created in the same order get the same numbers
+ **/
+class random_stream {
+public:
+    random_stream()
+        : random_stream(detail::next_stream_id(false), 0) {}
+
+    random_stream(uint32_t id, uint32_t substream)
+        : id_(id), substream_(substream), generation_(detail::random_seed_generation()),
+          block_(0), avail_(0), has_spare_(false), spare_(0) {}
+
+    uint32_t next_u32() {
+        sync();
+        if (avail_ == 0) {
+            generate(block_++, buf_);
+            avail_ = 4;
+        }
+        return buf_[4 - avail_--];
+    }
+
+    uint64_t next_u64() {
+        const uint64_t hi = next_u32();
+        return (hi << 32) | next_u32();
+    }
+
+    ///< uniform in [0, 1) with 53 bits of precision
+    double next_double() {
+        return double(next_u64() >> 11) * (1.0 / 9007199254740992.0);
+    }
+
+    ///< uniform integer in [min, max]
+    template <typename T>
+    T uniform_int(T min, T max) {
+        const uint64_t span = static_cast<uint64_t>(max) - static_cast<uint64_t>(min);
+        uint64_t offset;
+        if (span < 0xFFFFFFFFull)
+            offset = (uint64_t(next_u32()) * (span + 1)) >> 32;
+        else if (span == ~uint64_t(0))
+            offset = next_u64();
+        else
+            offset = next_u64() % (span + 1);
+        return static_cast<T>(static_cast<uint64_t>(min) + offset);
+    }
+
+    ///< normal distribution (Box-Muller, the second value is kept for the next call)
+    double gaussian(double mean, double sigma) {
+        if (has_spare_) {
+            has_spare_ = false;
+            return mean + sigma * spare_;
+        }
+        double u;
+        do { u = next_double(); } while (u <= 0.0);
+        const double r = std::sqrt(-2.0 * std::log(u));
+        const double theta = 6.283185307179586 * next_double();
+        spare_ = r * std::sin(theta);
+        has_spare_ = true;
+        return mean + sigma * r * std::cos(theta);
+    }
+
+    /**
+     * the next n values of the stream, the same as n calls of next_u32.
+     * whole blocks are generated in groups of independent counters that the
+     * compiler can keep in vector registers
+     **/
+    void fill_u32(uint32_t* dst, size_t n) {
+        sync();
+        while (n > 0 && avail_ > 0) { *dst++ = buf_[4 - avail_--]; n--; }
+
+        const int lanes = 8;
+        while (n >= 4 * lanes) {
+            generate_lanes<lanes>(block_, dst);
+            block_ += lanes;
+            dst += 4 * lanes;
+            n -= 4 * lanes;
+        }
+        for (; n >= 4; n -= 4, dst += 4)
+            generate(block_++, dst);
+        while (n-- > 0) *dst++ = next_u32();
+    }
+
+    ///< dst[i] = true with probability p
+    void bernoulli(bool* dst, size_t n, double p) {
+        uint32_t u[64];
+        const uint64_t threshold = p <= 0.0 ? 0 : p >= 1.0 ? (uint64_t(1) << 32)
+                                 : static_cast<uint64_t>(p * 4294967296.0);
+        while (n > 0) {
+            const size_t len = n < 64 ? n : 64;
+            fill_u32(u, len);
+            for (size_t i = 0; i < len; i++)
+                dst[i] = u[i] < threshold;
+            dst += len;
+            n -= len;
+        }
+    }
+
+    /**
+     * set bit i of the words at dst with probability p, for i < n. the words
+     * are written whole, bits from n up to the end of the last word are 0
+     **/
+    void bernoulli_bits(uint64_t* dst, size_t n, double p) {
+        uint32_t u[64];
+        const size_t words = (n + 63) / 64;
+        const double scaled = p * 4294967296.0;
+        const uint32_t threshold = p <= 0.0 ? 0u : scaled >= 4294967295.0 ? 0xFFFFFFFFu : static_cast<uint32_t>(scaled);
+
+        for (size_t w = 0; w < words; w++) {
+            const size_t len = n - w * 64 < 64 ? n - w * 64 : 64;
+            if (p >= 1.0) {
+                dst[w] = len == 64 ? ~uint64_t(0) : (uint64_t(1) << len) - 1;
+                continue;
+            }
+            fill_u32(u, len);
+            dst[w] = pack_less(u, len, threshold);
+        }
+    }
+
+private:
+    // bit i set if u[i] < threshold
+    static uint64_t pack_less(const uint32_t* u, size_t len, uint32_t threshold) {
+        uint64_t bits = 0;
+        size_t i = 0;
+#if defined(CNN_USE_SSE) || defined(CNN_USE_AVX)
+        // unsigned compare as signed compare of the values with the top bit flipped
+        const __m128i flip = _mm_set1_epi32(static_cast<int>(0x80000000u));
+        const __m128i thr = _mm_xor_si128(_mm_set1_epi32(static_cast<int>(threshold)), flip);
+        for (; i + 4 <= len; i += 4) {
+            const __m128i v = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(u + i)), flip);
+            const int m = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmplt_epi32(v, thr)));
+            bits |= uint64_t(m) << i;
+        }
+#endif
+        for (; i < len; i++)
+            bits |= uint64_t(u[i] < threshold) << i;
+        return bits;
+    }
+
+    void sync() {
+        const uint32_t g = detail::random_seed_generation().load(std::memory_order_relaxed);
+        if (g != generation_) {
+            generation_ = g;
+            block_ = 0;
+            avail_ = 0;
+            has_spare_ = false;
+        }
+    }
+
+    void key(uint32_t k[2]) const {
+        const uint64_t seed = detail::random_seed_state().load(std::memory_order_relaxed);
+        k[0] = uint32_t(seed);
+        k[1] = uint32_t(seed >> 32);
+    }
+
+    void generate(uint64_t block, uint32_t out[4]) const {
+        uint32_t k[2];
+        const uint32_t c[4] = { uint32_t(block), uint32_t(block >> 32), id_, substream_ };
+        key(k);
+        detail::philox4x32(c, k, out);
+    }
+
+    // N consecutive blocks, computed lane by lane in lockstep
+    template <int N>
+    void generate_lanes(uint64_t block, uint32_t* out) const {
+        uint32_t k[2];
+        uint32_t c0[N], c1[N], c2[N], c3[N];
+        key(k);
+        for (int l = 0; l < N; l++) {
+            c0[l] = uint32_t(block + l);
+            c1[l] = uint32_t((block + l) >> 32);
+            c2[l] = id_;
+            c3[l] = substream_;
+        }
+        uint32_t k0 = k[0], k1 = k[1];
+        for (int r = 0; r < 10; r++) {
+            for (int l = 0; l < N; l++) {
+                const uint64_t p0 = uint64_t(0xD2511F53) * c0[l];
+                const uint64_t p1 = uint64_t(0xCD9E8D57) * c2[l];
+                const uint32_t n0 = uint32_t(p1 >> 32) ^ c1[l] ^ k0;
+                const uint32_t n2 = uint32_t(p0 >> 32) ^ c3[l] ^ k1;
+                c1[l] = uint32_t(p1);
+                c3[l] = uint32_t(p0);
+                c0[l] = n0;
+                c2[l] = n2;
+            }
+            k0 += 0x9E3779B9;
+            k1 += 0xBB67AE85;
+        }
+        for (int l = 0; l < N; l++) {
+            out[4 * l + 0] = c0[l];
+            out[4 * l + 1] = c1[l];
+            out[4 * l + 2] = c2[l];
+            out[4 * l + 3] = c3[l];
+        }
+    }
+
+    uint32_t id_;
+    uint32_t substream_;
+    uint32_t generation_;
+    uint64_t block_;    // next block to generate
+    uint32_t buf_[4];   // current block
+    int      avail_;    // values of buf_ not returned yet
+    bool     has_spare_;
+    double   spare_;
+};
+
+/**
+ * the calling thread's own stream, used by uniform_rand, gaussian_rand and
+ * bernoulli. numbers drawn on one thread repeat after set_random_seed
+ **/
+inline random_stream& thread_rng() {
+    static thread_local random_stream rng(detail::next_stream_id(true), 0xFFFFFFFFu);
+    return rng;
+}
+
+} // namespace tiny_cnn
@@ -0,0 +1,193 @@
+/******************************************************************************
+ *  Copyright (c) 2016, Xilinx, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  1.  Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *  2.  Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *  3.  Neither the name of the copyright holder nor the names of its
+ *      contributors may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ *  OR BUSINESS INTERRUPTION). HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ *  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ *  ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *****************************************************************************/
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+#include "tiny_cnn/util/aligned_allocator.h"
+#include "tiny_cnn/util/nn_error.h"
+
+namespace tiny_cnn {
+
+/**
+ * bump allocator for short-lived buffers inside layers and utilities.
+ * each thread has its own arena (scratch_arena::local()), so taking scratch
+ * needs no lock, and memory is handed out in 64-byte aligned pieces like vec_t.
+ *
+ * allocations are released in LIFO order through scratch_scope. when the
+ * arena becomes empty and had to grow into several blocks, they are merged
+ * into one block of the peak size, so a steady workload stops allocating
+ * after the first round
+ **/
+class scratch_arena {
+public:
+    static const size_t alignment = 64;
+
+    struct marker {
+        size_t block;
+        size_t offset;
+        size_t used;
+    };
+
+    explicit scratch_arena(size_t initial_bytes = 0)
+        : current_(0), offset_(0), used_(0), peak_(0) {
+        if (initial_bytes) add_block(initial_bytes);
+    }
+
+    scratch_arena(const scratch_arena&) = delete;
+    scratch_arena& operator = (const scratch_arena&) = delete;
+
+    ~scratch_arena() {
+        for (auto& b : blocks_) free_block(b);
+    }
+
+    /**
+     * uninitialized, 64-byte aligned storage for n elements of T,
+     * valid until the enclosing scratch_scope ends
+     **/
+    template <typename T>
+    T* allocate(size_t n) {
+        static_assert(std::is_trivially_destructible<T>::value, "scratch is never destroyed");
+        return static_cast<T*>(allocate_bytes(n * sizeof(T)));
+    }
+
+    marker mark() const { return marker{ current_, offset_, used_ }; }
+
+    // frees everything allocated after m was taken
+    void release(const marker& m) {
+        current_ = m.block;
+        offset_ = m.offset;
+        used_ = m.used;
+        if (current_ == 0 && offset_ == 0) reset();
+    }
+
+    // frees everything, merging the blocks if the arena had to grow
+    void reset() {
+        current_ = 0;
+        offset_ = 0;
+        used_ = 0;
+        if (blocks_.size() > 1) {
+            for (auto& b : blocks_) free_block(b);
+            blocks_.clear();
+            add_block(peak_);
+        }
+    }
+
+    // total bytes reserved by the arena
+    size_t capacity() const {
+        size_t n = 0;
+        for (const auto& b : blocks_) n += b.size;
+        return n;
+    }
+
+    // largest number of bytes live at once
+    size_t peak() const { return peak_; }
+
+    // the arena of the calling thread
+    static scratch_arena& local() {
+        static thread_local scratch_arena arena;
+        return arena;
+    }
+
+private:
+    struct block {
+        char* data;
+        size_t size;
+    };
+
+    static size_t round_up(size_t n) {
+        return (n + alignment - 1) / alignment * alignment;
+    }
+
+    void* allocate_bytes(size_t bytes) {
+        bytes = round_up(std::max<size_t>(bytes, 1));
+
+        while (current_ < blocks_.size() && offset_ + bytes > blocks_[current_].size) {
+            // the rest of this block is wasted until the arena is reset
+            used_ += blocks_[current_].size - offset_;
+            current_++;
+            offset_ = 0;
+        }
+        if (current_ == blocks_.size()) {
+            const size_t last = blocks_.empty() ? 0 : blocks_.back().size;
+            add_block(std::max(bytes, std::max<size_t>(2 * last, 64 * 1024)));
+        }
+
+        char* p = blocks_[current_].data + offset_;
+        offset_ += bytes;
+        used_ += bytes;
+        peak_ = std::max(peak_, used_);
+        return p;
+    }
+
+    void add_block(size_t bytes) {
+        block b;
+        b.size = round_up(bytes);
+        b.data = aligned_allocator<char, alignment>().allocate(b.size);
+        blocks_.push_back(b);
+    }
+
+    static void free_block(block& b) {
+        aligned_allocator<char, alignment>().deallocate(b.data, b.size);
+    }
+
+    std::vector<block> blocks_;
+    size_t current_;
+    size_t offset_;
+    size_t used_;
+    size_t peak_;
+};
+
+/**
+ * scratch taken through a scope is released when the scope ends.
+ * the network opens one around each worker's share of a minibatch
+ **/
+class scratch_scope {
+public:
+    explicit scratch_scope(scratch_arena& arena = scratch_arena::local())
+        : arena_(arena), mark_(arena.mark()) {}
+
+    scratch_scope(const scratch_scope&) = delete;
+    scratch_scope& operator = (const scratch_scope&) = delete;
+
+    ~scratch_scope() { arena_.release(mark_); }
+
+    template <typename T>
+    T* allocate(size_t n) { return arena_.allocate<T>(n); }
+
+private:
+    scratch_arena& arena_;
+    scratch_arena::marker mark_;
+};
+
+} // namespace tiny_cnn
@@ -0,0 +1,246 @@
+/******************************************************************************
+ *  Copyright (c) 2016, Xilinx, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  1.  Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *  2.  Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *  3.  Neither the name of the copyright holder nor the names of its
+ *      contributors may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ *  OR BUSINESS INTERRUPTION). HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ *  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ *  ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *****************************************************************************/
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+#include "nn_error.h"
+#include "aligned_allocator.h"
+
+#if defined(__linux__)
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace tiny_cnn {
+
+/**
+ * runtime control of the threads used by parallel_for.
+ *
+ * set from code with set_thread_config(), or from the environment
+ * (read once, when the first parallel loop starts):
+ *   CNN_NUM_THREADS  number of threads, including the calling thread
+ *   CNN_CPUS         cpus to pin the threads to, e.g. "0-3,8-11"
+ *   CNN_NUMA_LOCAL   1 to place the per-worker buffers of each layer on
+ *                    the NUMA node of the cpu of the thread they are meant for
+ *
+ * thread k (0 is the thread that starts a loop) runs on cpus[k % cpus.size()],
+ * with the built-in pool as well as with OpenMP. several processes on one host
+ * can thus be given disjoint cpu sets. TBB only takes the number of threads.
+ *
+ * @attention worker slot i (the buffers of sample chunk i of a minibatch) is
+ * placed for thread i % num_threads. the built-in pool lets idle threads
+ * steal chunks, so the placement is a hint: it holds while every thread is
+ * busy with its own chunk, not for stolen ones. OpenMP's static schedule
+ * keeps chunk i on thread i.
+ **/
+struct thread_config {
+    thread_config()
+        : num_threads(std::max(1u, std::thread::hardware_concurrency())), numa_local(false) {}
+
+    size_t num_threads;
+    std::vector<int> cpus;  // empty: do not pin
+    bool numa_local;
+
+    ///< cpu of the k-th thread, -1 if not pinned
+    int cpu_of_thread(size_t k) const {
+        return cpus.empty() ? -1 : cpus[k % cpus.size()];
+    }
+
+    /**
+     * parse a cpu list in the format of /sys and taskset, e.g. "0-3,8,10-11"
+     **/
+    static std::vector<int> parse_cpu_list(const std::string& list) {
+        std::vector<int> cpus;
+        size_t pos = 0;
+
+        while (pos < list.size()) {
+            size_t comma = list.find(',', pos);
+            if (comma == std::string::npos) comma = list.size();
+            const std::string item = list.substr(pos, comma - pos);
+            pos = comma + 1;
+            if (item.empty()) continue;
+
+            int first, last;
+            if (std::sscanf(item.c_str(), "%d-%d", &first, &last) == 2) {
+                for (int c = first; c <= last; c++) cpus.push_back(c);
+            } else if (std::sscanf(item.c_str(), "%d", &first) == 1) {
+                cpus.push_back(first);
+            } else {
+                throw nn_error("invalid cpu list: " + list);
+            }
+        }
+        return cpus;
+    }
+
+    static thread_config from_env() {
+        thread_config cfg;
+
+        if (const char* cpus = std::getenv("CNN_CPUS")) {
+            cfg.cpus = parse_cpu_list(cpus);
+            if (!cfg.cpus.empty()) cfg.num_threads = cfg.cpus.size();
+        }
+        if (const char* n = std::getenv("CNN_NUM_THREADS")) {
+            const int v = std::atoi(n);
+            if (v > 0) cfg.num_threads = static_cast<size_t>(v);
+        }
+        if (const char* numa = std::getenv("CNN_NUMA_LOCAL"))
+            cfg.numa_local = std::atoi(numa) != 0;
+
+        return cfg;
+    }
+};
+
+/**
+ * the configuration in effect, initialized from the environment
+ **/
+inline thread_config& global_thread_config() {
+    static thread_config cfg = thread_config::from_env();
+    return cfg;
+}
+
+#if defined(__linux__)
+
+inline bool pin_thread(pthread_t thread, int cpu) {
+    if (cpu < 0 || cpu >= CPU_SETSIZE) return false;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(thread, sizeof(set), &set) == 0;
+}
+
+inline bool pin_thread(std::thread& t, int cpu) {
+    return pin_thread(t.native_handle(), cpu);
+}
+
+inline bool pin_current_thread(int cpu) {
+    return pin_thread(pthread_self(), cpu);
+}
+
+///< NUMA node the cpu belongs to, -1 if unknown
+inline int numa_node_of_cpu(int cpu) {
+    if (cpu < 0) return -1;
+
+    const std::string dir = "/sys/devices/system/cpu/cpu" + std::to_string(cpu);
+    DIR* d = opendir(dir.c_str());
+    if (!d) return -1;
+
+    int node = -1;
+    while (dirent* e = readdir(d)) {
+        if (std::sscanf(e->d_name, "node%d", &node) == 1) break;
+        node = -1;
+    }
+    closedir(d);
+    return node;
+}
+
+/**
+ * move the whole pages within [p, p + bytes) to the given NUMA node and keep
+ * them there. returns false if the memory was left where it is
+ **/
+inline bool numa_bind(void* p, size_t bytes, int node) {
+#ifdef SYS_mbind
+    if (node < 0 || node >= 64) return false;
+
+    const uintptr_t page = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+    const uintptr_t begin = (reinterpret_cast<uintptr_t>(p) + page - 1) & ~(page - 1);
+    const uintptr_t end = (reinterpret_cast<uintptr_t>(p) + bytes) & ~(page - 1);
+    if (end <= begin) return false;
+
+    const int mpol_bind = 2;
+    const unsigned mpol_mf_move = 1 << 1;
+    unsigned long mask = 1UL << node;
+
+    return syscall(SYS_mbind, begin, end - begin, mpol_bind, &mask,
+                   sizeof(mask) * 8 + 1, mpol_mf_move) == 0;
+#else
+    return false;
+#endif
+}
+
+/**
+ * copy the given vectors into one page-aligned mapping bound to a NUMA
+ * node, so that every page they use is on that node (mbind only moves whole
+ * pages, which small 64-byte aligned vectors rarely span). the copies are
+ * allocated from the mapping through a placement_region, and the mapping is
+ * released with the last of them. returns false and leaves the vectors
+ * alone if the memory could not be bound
+ **/
+template <typename T, std::size_t A>
+bool numa_place(const std::vector<std::vector<T, aligned_allocator<T, A>>*>& vs, int node) {
+    if (node < 0) return false;
+
+    size_t bytes = 0;
+    for (auto v : vs)
+        bytes = (bytes + A - 1) / A * A + v->size() * sizeof(T);
+    if (bytes == 0) return false;
+
+    const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    const size_t len = (bytes + page - 1) / page * page;
+    void* p = ::mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) return false;
+    std::shared_ptr<void> mapping(p, [len](void* q) { ::munmap(q, len); });
+
+    // bound before the first touch, so the pages are faulted in on the node
+    if (!numa_bind(p, len, node)) return false;
+
+    detail::placement_region region = { static_cast<char*>(p), static_cast<char*>(p) + len, mapping };
+    detail::placement_scope scope(&region);
+    for (auto v : vs) {
+        if (v->empty()) continue;
+        std::vector<T, aligned_allocator<T, A>> placed(v->begin(), v->end());
+        v->swap(placed);
+    }
+    return true;
+}
+
+#else
+
+inline bool pin_thread(std::thread&, int) { return false; }
+inline bool pin_current_thread(int) { return false; }
+inline int numa_node_of_cpu(int) { return -1; }
+inline bool numa_bind(void*, size_t, int) { return false; }
+
+template <typename T, std::size_t A>
+bool numa_place(const std::vector<std::vector<T, aligned_allocator<T, A>>*>&, int) { return false; }
+
+#endif
+
+} // namespace tiny_cnn
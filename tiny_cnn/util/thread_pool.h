@@ -0,0 +1,330 @@
+/******************************************************************************
+ *  Copyright (c) 2016, Xilinx, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *  1.  Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *  2.  Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in the
+ *      documentation and/or other materials provided with the distribution.
+ *
+ *  3.  Neither the name of the copyright holder nor the names of its
+ *      contributors may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ *  OR BUSINESS INTERRUPTION). HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ *  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ *  ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *****************************************************************************/
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "thread_config.h"
+
+namespace tiny_cnn {
+
+/**
+ * persistent work-stealing scheduler behind the default (non-TBB, non-OpenMP)
+ * parallel_for.
+ *
+ * the workers are started once, on first use, and wait for work by spinning
+ * for a short while before parking on a condition variable, so back-to-back
+ * for_i calls (as issued per layer and per sample) are dispatched without
+ * creating threads and usually without a syscall.
+ *
+ * every loop is published in a slot and split lazily: the calling thread and
+ * any idle worker take chunks from it through an atomic counter. a for_i
+ * nested inside a loop body (e.g. a layer's for_i inside the per-sample loop
+ * of train_onebatch) is published the same way, so it becomes stealable work
+ * for the other threads instead of new threads; the total number of threads
+ * is fixed when the pool is created. a thread waiting for the chunks of its
+ * loop to finish only helps with loops nested deeper than its own, which
+ * keeps the waits bounded.
+ **/
+class thread_pool {
+public:
+    explicit thread_pool(size_t n_threads = std::thread::hardware_concurrency())
+        : open_(0), epoch_(0), parked_(0), stop_(false)
+    {
+        for (auto& sl : slots_) {
+            sl.ptr.store(nullptr);
+            sl.users.store(0);
+            sl.taken.store(false);
+        }
+        if (n_threads < 1) n_threads = 1;
+        for (size_t i = 1; i < n_threads; i++)
+            workers_.emplace_back([this] { worker_loop(); });
+    }
+
+    /**
+     * pool with cfg.num_threads threads, pinned to cfg.cpus if given.
+     * the calling thread counts as thread 0
+     **/
+    explicit thread_pool(const thread_config& cfg)
+        : thread_pool(cfg.num_threads)
+    {
+        if (cfg.cpus.empty()) return;
+        pin_current_thread(cfg.cpu_of_thread(0));
+        for (size_t i = 0; i < workers_.size(); i++)
+            pin_thread(workers_[i], cfg.cpu_of_thread(i + 1));
+    }
+
+    ~thread_pool() {
+        {
+            std::lock_guard<std::mutex> lock(park_mutex_);
+            stop_ = true;
+        }
+        park_cond_.notify_all();
+        for (auto& t : workers_) t.join();
+    }
+
+    thread_pool(const thread_pool&) = delete;
+    thread_pool& operator = (const thread_pool&) = delete;
+
+    /**
+     * the pool shared by all parallel_for calls, started lazily
+     **/
+    static thread_pool& instance() {
+        return *holder();
+    }
+
+    /**
+     * replace the shared pool by one built from cfg.
+     * must not be called while a parallel loop is running
+     **/
+    static void configure(const thread_config& cfg) {
+        holder().reset(new thread_pool(cfg));
+    }
+
+    ///< number of threads taking part in a loop, including the caller
+    size_t size() const { return workers_.size() + 1; }
+
+    /**
+     * calls f(chunk_begin, chunk_end) for disjoint chunks covering [begin, end),
+     * each at least grainsize long (except the last one), and returns when all
+     * of them are done. may be called from inside f.
+     * exceptions thrown by f are rethrown on the calling thread
+     **/
+    template <typename Func>
+    void run(int begin, int end, const Func& f, int grainsize = 1) {
+        if (end <= begin) return;
+        if (workers_.empty() || (end - begin) < 2 * std::max(1, grainsize)) {
+            f(begin, end);
+            return;
+        }
+
+        loop l;
+        const int n_chunks = static_cast<int>(size()) * chunks_per_thread;
+        l.func = &invoke<Func>;
+        l.arg = &f;
+        l.end = end;
+        l.chunk = std::max(std::max(1, grainsize), (end - begin + n_chunks - 1) / n_chunks);
+        l.depth = current_depth() + 1;
+        l.next.store(begin);
+        l.remaining.store(end - begin);
+        l.waiting.store(false);
+
+        slot* sl = acquire_slot();
+        if (!sl) {
+            // too many loops in flight, nobody would pick this one up soon
+            f(begin, end);
+            return;
+        }
+        sl->ptr.store(&l);
+        open_.fetch_add(1);
+        epoch_.fetch_add(1);
+        if (parked_.load() != 0) {
+            std::lock_guard<std::mutex> lock(park_mutex_);
+            park_cond_.notify_all();
+        }
+
+        execute(l);
+
+        // help with nested loops until the chunks taken by others are done,
+        // block once there is nothing to help with for a while
+        int spin = 0;
+        while (l.remaining.load() != 0) {
+            const uint64_t seen = epoch_.load();
+            if (steal(l.depth + 1)) {
+                spin = 0;
+            } else if (spin++ < spin_count) {
+                std::this_thread::yield();
+            } else {
+                std::unique_lock<std::mutex> lock(park_mutex_);
+                l.waiting.store(true);
+                parked_.fetch_add(1);
+                park_cond_.wait(lock, [&] { return l.remaining.load() == 0 || epoch_.load() != seen; });
+                parked_.fetch_sub(1);
+                l.waiting.store(false);
+                spin = 0;
+            }
+        }
+
+        open_.fetch_sub(1);
+        sl->ptr.store(nullptr);
+        while (sl->users.load() != 0) std::this_thread::yield();
+        sl->taken.store(false);
+
+        if (l.error) std::rethrow_exception(l.error);
+    }
+
+private:
+    static std::unique_ptr<thread_pool>& holder() {
+        static std::unique_ptr<thread_pool> pool(new thread_pool(global_thread_config()));
+        return pool;
+    }
+
+    static const int max_loops = 64;
+    static const int chunks_per_thread = 4;
+    static const int spin_count = 4000;
+
+    typedef void (*invoke_type)(const void* arg, int begin, int end);
+
+    template <typename Func>
+    static void invoke(const void* arg, int begin, int end) {
+        (*static_cast<const Func*>(arg))(begin, end);
+    }
+
+    struct loop {
+        invoke_type func;
+        const void* arg;
+        int end;
+        int chunk;
+        int depth;      // nesting level, 1 for a loop issued outside of any loop
+        std::atomic<int> next;
+        std::atomic<int> remaining;
+        std::atomic<bool> waiting;  // the owner is blocked until remaining drops to 0
+        std::exception_ptr error;
+        std::mutex error_mutex;
+    };
+
+    // a published loop. a thief registers in users before reading ptr,
+    // the owner clears ptr and waits for users to drop to 0 before returning
+    struct slot {
+        std::atomic<loop*> ptr;
+        std::atomic<int> users;
+        std::atomic<bool> taken;
+        char padding[64 - sizeof(std::atomic<loop*>) - sizeof(std::atomic<int>) - sizeof(std::atomic<bool>)];
+    };
+
+    // nesting level of the loop the current thread is working on
+    static int& current_depth() {
+        static thread_local int depth = 0;
+        return depth;
+    }
+
+    struct depth_scope {
+        explicit depth_scope(int depth) : saved_(current_depth()) { current_depth() = depth; }
+        ~depth_scope() { current_depth() = saved_; }
+        int saved_;
+    };
+
+    slot* acquire_slot() {
+        for (auto& sl : slots_) {
+            bool expected = false;
+            if (!sl.taken.load(std::memory_order_relaxed) && sl.taken.compare_exchange_strong(expected, true))
+                return &sl;
+        }
+        return nullptr;
+    }
+
+    // takes chunks of l until there is none left, returns false if there was none
+    bool execute(loop& l) {
+        depth_scope scope(l.depth);
+        bool executed = false;
+
+        for (;;) {
+            const int b = l.next.fetch_add(l.chunk);
+            if (b >= l.end) return executed;
+            const int e = std::min(b + l.chunk, l.end);
+            try {
+                l.func(l.arg, b, e);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(l.error_mutex);
+                if (!l.error) l.error = std::current_exception();
+            }
+            if (l.remaining.fetch_sub(e - b) == e - b && l.waiting.load()) {
+                std::lock_guard<std::mutex> lock(park_mutex_);
+                park_cond_.notify_all();
+            }
+            executed = true;
+        }
+    }
+
+    // works on some other thread's loop nested at least min_depth deep
+    bool steal(int min_depth) {
+        if (open_.load() == 0) return false;
+
+        static thread_local unsigned victim = 0;
+        const unsigned start = victim++;
+
+        for (unsigned k = 0; k < max_loops; k++) {
+            slot& sl = slots_[(start + k) % max_loops];
+            if (!sl.ptr.load(std::memory_order_relaxed)) continue;
+
+            sl.users.fetch_add(1);
+            loop* l = sl.ptr.load();
+            const bool executed = l && l->depth >= min_depth && execute(*l);
+            sl.users.fetch_sub(1);
+            if (executed) return true;
+        }
+        return false;
+    }
+
+    void worker_loop() {
+        for (;;) {
+            const uint64_t seen = epoch_.load();
+            if (steal(0)) continue;
+
+            // nothing to take: either no loop is open or the open ones have
+            // handed out all their chunks, and only a newly published loop
+            // brings new work. spin first, it usually follows within
+            // microseconds, then park
+            int spin = 0;
+            while (epoch_.load() == seen && spin++ < spin_count) {
+                if (stop_.load()) return;
+                std::this_thread::yield();
+            }
+            if (epoch_.load() != seen) continue;
+
+            std::unique_lock<std::mutex> lock(park_mutex_);
+            parked_.fetch_add(1);
+            park_cond_.wait(lock, [&] { return stop_ || epoch_.load() != seen; });
+            parked_.fetch_sub(1);
+            if (stop_) return;
+        }
+    }
+
+    std::vector<std::thread> workers_;
+    slot slots_[max_loops];
+
+    std::atomic<int> open_;         // number of published loops
+    std::atomic<uint64_t> epoch_;   // bumped whenever a loop is published
+    std::atomic<int> parked_;
+
+    std::mutex park_mutex_;
+    std::condition_variable park_cond_;
+    std::atomic<bool> stop_;
+};
+
+} // namespace tiny_cnn
@@ -34,8 +34,12 @@
 #include <cstdio>
 #include <cstdarg>
 #include <string>
+#include <cmath>
 #include "aligned_allocator.h"
 #include "nn_error.h"
+#include "fixed_point.h"
+#include "thread_config.h"
+#include "random.h"
 #include "tiny_cnn/config.h"
 
 #ifdef CNN_USE_TBB
@@ -46,9 +50,12 @@
 #include <tbb/task_group.h>
 #endif
 
-#ifndef CNN_USE_OMP
-#include <thread>
-#include <future>
+#if !defined(CNN_USE_TBB) && !defined(CNN_USE_OMP)
+#include "thread_pool.h"
+#endif
+
+#if defined(CNN_USE_OMP) && defined(_OPENMP)
+#include <omp.h>
 #endif
 
 #define CNN_UNREFERENCED_PARAMETER(x) (void)(x)
@@ -68,30 +75,45 @@ enum class net_phase {
     test
 };
 
+// math functions are called unqualified inside tiny_cnn, so that
+// the overloads for a user-defined float_t (e.g. fixed_point) are found too
+using std::exp;
+using std::log;
+using std::sqrt;
+using std::abs;
+using std::pow;
+using std::tanh;
+
+// the random functions below draw from the calling thread's stream (see random.h)
+
 template<typename T> inline
 typename std::enable_if<std::is_integral<T>::value, T>::type
 uniform_rand(T min, T max) {
-    // avoid gen(0) for MSVC known issue
-    // https://connect.microsoft.com/VisualStudio/feedback/details/776456
-    static std::mt19937 gen(1);
-    std::uniform_int_distribution<T> dst(min, max);
-    return dst(gen);
+    return thread_rng().uniform_int(min, max);
 }
 
 template<typename T> inline
 typename std::enable_if<std::is_floating_point<T>::value, T>::type
 uniform_rand(T min, T max) {
-    static std::mt19937 gen(1);
-    std::uniform_real_distribution<T> dst(min, max);
-    return dst(gen);
+    return min + (max - min) * static_cast<T>(thread_rng().next_double());
 }
 
 template<typename T> inline
 typename std::enable_if<std::is_floating_point<T>::value, T>::type
 gaussian_rand(T mean, T sigma) {
-    static std::mt19937 gen(1);
-    std::normal_distribution<T> dst(mean, sigma);
-    return dst(gen);
+    return static_cast<T>(thread_rng().gaussian(mean, sigma));
+}
+
+template<typename T> inline
+typename std::enable_if<is_fixed_point<T>::value, T>::type
+uniform_rand(T min, T max) {
+    return T(uniform_rand(min.to_double(), max.to_double()));
+}
+
+template<typename T> inline
+typename std::enable_if<is_fixed_point<T>::value, T>::type
+gaussian_rand(T mean, T sigma) {
+    return T(gaussian_rand(mean.to_double(), sigma.to_double()));
 }
 
 template<typename Container>
@@ -147,12 +169,17 @@ inline void nop()
 
 #ifdef CNN_USE_TBB
 
-static tbb::task_scheduler_init tbbScheduler(tbb::task_scheduler_init::automatic);//tbb::task_scheduler_init::deferred);
+// started with the number of threads of global_thread_config() on first use
+inline tbb::task_scheduler_init& tbb_scheduler() {
+    static tbb::task_scheduler_init init(static_cast<int>(global_thread_config().num_threads));
+    return init;
+}
 
 typedef tbb::blocked_range<int> blocked_range;
 
 template<typename Func>
 void parallel_for(int begin, int end, const Func& f, int grainsize) {
+    tbb_scheduler();
     tbb::parallel_for(blocked_range(begin, end, end - begin > grainsize ? grainsize : 1), f);
 }
 template<typename Func>
@@ -183,8 +210,27 @@ void xparallel_for(size_t begin, size_t end, const Func& f) {
 
 #ifdef CNN_USE_OMP
 
+// thread count and pinning of the OpenMP threads
+inline void apply_omp_thread_config(const thread_config& cfg) {
+#if defined(_OPENMP)
+    omp_set_num_threads(static_cast<int>(cfg.num_threads));
+    if (cfg.cpus.empty()) return;
+    #pragma omp parallel
+    pin_current_thread(cfg.cpu_of_thread(static_cast<size_t>(omp_get_thread_num())));
+#else
+    CNN_UNREFERENCED_PARAMETER(cfg);
+#endif
+}
+
+// applies the configuration read from the environment before the first loop
+inline void configure_omp_once() {
+    static const bool configured = (apply_omp_thread_config(global_thread_config()), true);
+    CNN_UNREFERENCED_PARAMETER(configured);
+}
+
 template<typename Func>
 void parallel_for(int begin, int end, const Func& f, int /*grainsize*/) {
+    configure_omp_once();
     #pragma omp parallel for
     for (int i=begin; i<end; ++i)
         f(blocked_range(i,i+1));
@@ -193,37 +239,33 @@ void parallel_for(int begin, int end, const Func& f, int /*grainsize*/) {
 #else
 
 template<typename Func>
-void parallel_for(int start, int end, const Func &f, int /*grainsize*/) {
-    int nthreads = std::thread::hardware_concurrency();
-    int blockSize = (end - start) / nthreads;
-    if (blockSize*nthreads < end - start)
-        blockSize++;
-
-    std::vector<std::future<void>> futures;
-
-    int blockStart = start;
-    int blockEnd = blockStart + blockSize;
-    if (blockEnd > end) blockEnd = end;
-
-    for (int i = 0; i < nthreads; i++) {
-        futures.push_back(std::move(std::async(std::launch::async, [blockStart, blockEnd, &f] {
-            f(blocked_range(blockStart, blockEnd));
-        })));
-
-        blockStart += blockSize;
-        blockEnd = blockStart + blockSize;
-        if (blockStart >= end) break;
-        if (blockEnd > end) blockEnd = end;
-    }
-
-    for (auto &future : futures)
-        future.wait();
+void parallel_for(int start, int end, const Func &f, int grainsize) {
+    thread_pool::instance().run(start, end, [&](int b, int e) {
+        f(blocked_range(b, e));
+    }, grainsize);
 }
 
 #endif
 
 #endif // CNN_USE_TBB
 
+/**
+ * change the threads used by parallel_for (see thread_config).
+ * must not be called while a parallel loop is running.
+ * TBB does not pin its threads
+ **/
+inline void set_thread_config(const thread_config& cfg) {
+    global_thread_config() = cfg;
+#if defined(CNN_USE_TBB)
+    tbb_scheduler().terminate();
+    tbb_scheduler().initialize(static_cast<int>(cfg.num_threads));
+#elif defined(CNN_USE_OMP)
+    apply_omp_thread_config(cfg);
+#else
+    thread_pool::configure(cfg);
+#endif
+}
+
 template<typename T, typename U>
 bool value_representation(U const &value) {
     return static_cast<U>(static_cast<T>(value)) == value;
@@ -231,7 +273,7 @@ bool value_representation(U const &value) {
 
 template<typename T, typename Func>
 inline
-void for_(std::true_type, bool parallelize, int begin, T end, Func f, int grainsize = 100){
+void for_(std::true_type, bool parallelize, int begin, T end, Func f, int grainsize = 1){
     parallelize = parallelize && value_representation<int>(end);
     parallelize ? parallel_for(begin, static_cast<int>(end), f, grainsize) :
                   xparallel_for(begin, static_cast<int>(end), f);
@@ -239,19 +281,19 @@ void for_(std::true_type, bool parallelize, int begin, T end, Func f, int grains
 
 template<typename T, typename Func>
 inline
-void for_(std::false_type, bool parallelize, int begin, T end, Func f, int grainsize = 100){
+void for_(std::false_type, bool parallelize, int begin, T end, Func f, int grainsize = 1){
     parallelize ? parallel_for(begin, static_cast<int>(end), f, grainsize) : xparallel_for(begin, end, f);
 }
 
 template<typename T, typename Func>
 inline
-void for_(bool parallelize, int begin, T end, Func f, int grainsize = 100) {
+void for_(bool parallelize, int begin, T end, Func f, int grainsize = 1) {
     static_assert(std::is_integral<T>::value, "end must be integral type");
     for_(typename std::is_unsigned<T>::type(), parallelize, begin, end, f, grainsize);
 }
 
 template <typename T, typename Func>
-void for_i(bool parallelize, T size, Func f, int grainsize = 100)
+void for_i(bool parallelize, T size, Func f, int grainsize = 1)
 {
     for_(parallelize, 0, size, [&](const blocked_range& r) {
 #ifdef CNN_USE_OMP
@@ -263,7 +305,7 @@ void for_i(bool parallelize, T size, Func f, int grainsize = 100)
 }
 
 template <typename T, typename Func>
-void for_i(T size, Func f, int grainsize = 100) {
+void for_i(T size, Func f, int grainsize = 1) {
     for_i(true, size, f, grainsize);
 }
 
@@ -364,6 +406,7 @@ Stream& operator << (Stream& s, const index3d<T>& d) {
 #define CNN_USE_LAYER_MEMBERS using layer_base::in_size_;\
     using layer_base::out_size_; \
     using layer_base::parallelize_; \
+    using layer_base::grainsize_; \
     using layer_base::next_; \
     using layer_base::prev_; \
     using layer_base::a_; \
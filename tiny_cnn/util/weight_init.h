@@ -59,7 +59,7 @@ public:
     explicit xavier(float_t value) : scalable(value) {}
 
     void fill(vec_t *weight, cnn_size_t fan_in, cnn_size_t fan_out) override {
-        const float_t weight_base = std::sqrt(scale_ / (fan_in + fan_out));
+        const float_t weight_base = sqrt(scale_ / (fan_in + fan_out));
 
         uniform_rand(weight->begin(), weight->end(), -weight_base, weight_base);     
     }
@@ -80,7 +80,7 @@ public:
     void fill(vec_t *weight, cnn_size_t fan_in, cnn_size_t fan_out) override {
         CNN_UNREFERENCED_PARAMETER(fan_out);
 
-        const float_t weight_base = scale_ / std::sqrt(float_t(fan_in));
+        const float_t weight_base = scale_ / sqrt(float_t(fan_in));
 
         uniform_rand(weight->begin(), weight->end(), -weight_base, weight_base);
     }
@@ -120,7 +120,7 @@ public:
     void fill(vec_t *weight, cnn_size_t fan_in, cnn_size_t fan_out) override {
         CNN_UNREFERENCED_PARAMETER(fan_out);
 
-        const float_t sigma = std::sqrt(scale_ /fan_in);
+        const float_t sigma = sqrt(scale_ /fan_in);
 
         gaussian_rand(weight->begin(), weight->end(), float_t(0), sigma);
     }